@@ -0,0 +1,491 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#include <cstring>
+#include "aes.h"
+#include "errors.h"
+#include "utilities.h"
+
+// the AES instructions path is built with GCC/clang on x86, and selected at runtime
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AES_X86_EXTENSIONS
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
+
+const UINT32 AES_MAX_ROUNDS = 14;
+
+// blocks handled by a single call to the block function, the counters/tweaks are kept on the stack
+const UINT32 AES_BATCH_BLOCKS = 32;
+
+// data smaller than this is not worth another thread
+const UINT32 AES_MIN_BYTES_PER_THREAD = 0x40000;
+
+typedef struct AES_Key
+{
+	UINT8	roundKeys[AES_MAX_ROUNDS + 1][AES_BLOCK_SIZE];
+	UINT32	rounds;
+}AES_Key;
+
+static const UINT8 AES_SBox[256] =
+{
+	0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+	0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+	0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+	0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+	0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+	0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+	0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+	0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+	0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+	0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+	0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+	0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+	0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+	0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+	0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+	0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+static UINT8 AES_xtime(UINT8 x)
+{
+	return (UINT8) ((x << 1) ^ ((x & 0x80) ? 0x1b : 0x00));
+}
+
+static void AES_ExpandKey(const UINT8 *key, UINT32 keySize, AES_Key &aesKey)
+{
+	UINT32 keyWords = keySize / 4;
+	UINT8 *w = &aesKey.roundKeys[0][0];
+	UINT8 rcon = 0x01;
+
+	aesKey.rounds = keyWords + 6;
+	memcpy(w, key, keySize);
+
+	for (UINT32 i = keyWords; i < 4 * (aesKey.rounds + 1); ++i)
+	{
+		UINT8 temp[4];
+		memcpy(temp, &w[4 * (i - 1)], 4);
+		if (i % keyWords == 0)
+		{
+			// RotWord, SubWord and Rcon
+			UINT8 first = temp[0];
+			temp[0] = AES_SBox[temp[1]] ^ rcon;
+			temp[1] = AES_SBox[temp[2]];
+			temp[2] = AES_SBox[temp[3]];
+			temp[3] = AES_SBox[first];
+			rcon = AES_xtime(rcon);
+		}
+		else if (keyWords > 6 && i % keyWords == 4)
+		{
+			for (int j = 0; j < 4; ++j)
+			{
+				temp[j] = AES_SBox[temp[j]];
+			}
+		}
+		for (int j = 0; j < 4; ++j)
+		{
+			w[4 * i + j] = w[4 * (i - keyWords) + j] ^ temp[j];
+		}
+	}
+}
+
+
+/*
+	Block encryption, the blocks are encrypted independently (ECB)
+*/
+
+static void AES_EncryptBlocksPortable(const AES_Key &key, UINT8 *data, UINT32 numBlocks)
+{
+	while (numBlocks--)
+	{
+		UINT8 *s = data;
+		UINT8 t[AES_BLOCK_SIZE];
+
+		for (int i = 0; i < 16; ++i)
+		{
+			s[i] ^= key.roundKeys[0][i];
+		}
+		for (UINT32 round = 1; round <= key.rounds; ++round)
+		{
+			// SubBytes and ShiftRows, the state is kept column by column
+			for (int c = 0; c < 4; ++c)
+			{
+				for (int r = 0; r < 4; ++r)
+				{
+					t[4 * c + r] = AES_SBox[s[4 * ((c + r) % 4) + r]];
+				}
+			}
+			// MixColumns
+			if (round < key.rounds)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					UINT8 *a = &t[4 * c];
+					UINT8 all = a[0] ^ a[1] ^ a[2] ^ a[3];
+					UINT8 first = a[0];
+					a[0] ^= all ^ AES_xtime(a[0] ^ a[1]);
+					a[1] ^= all ^ AES_xtime(a[1] ^ a[2]);
+					a[2] ^= all ^ AES_xtime(a[2] ^ a[3]);
+					a[3] ^= all ^ AES_xtime(a[3] ^ first);
+				}
+			}
+			for (int i = 0; i < 16; ++i)
+			{
+				s[i] = t[i] ^ key.roundKeys[round][i];
+			}
+		}
+		data += AES_BLOCK_SIZE;
+	}
+}
+
+#ifdef AES_X86_EXTENSIONS
+__attribute__((target("aes,sse2")))
+static void AES_EncryptBlocksAesNi(const AES_Key &key, UINT8 *data, UINT32 numBlocks)
+{
+	__m128i rk[AES_MAX_ROUNDS + 1];
+	UINT32 rounds = key.rounds;
+
+	for (UINT32 i = 0; i <= rounds; ++i)
+	{
+		rk[i] = _mm_loadu_si128((const __m128i *)key.roundKeys[i]);
+	}
+
+	// eight blocks at a time, to hide the latency of the instructions
+	for (; numBlocks >= 8; numBlocks -= 8, data += 8 * AES_BLOCK_SIZE)
+	{
+		__m128i b[8];
+		for (int j = 0; j < 8; ++j)
+		{
+			b[j] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(data + j * AES_BLOCK_SIZE)), rk[0]);
+		}
+		for (UINT32 round = 1; round < rounds; ++round)
+		{
+			for (int j = 0; j < 8; ++j)
+			{
+				b[j] = _mm_aesenc_si128(b[j], rk[round]);
+			}
+		}
+		for (int j = 0; j < 8; ++j)
+		{
+			_mm_storeu_si128((__m128i *)(data + j * AES_BLOCK_SIZE), _mm_aesenclast_si128(b[j], rk[rounds]));
+		}
+	}
+
+	for (; numBlocks > 0; --numBlocks, data += AES_BLOCK_SIZE)
+	{
+		__m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i *)data), rk[0]);
+		for (UINT32 round = 1; round < rounds; ++round)
+		{
+			b = _mm_aesenc_si128(b, rk[round]);
+		}
+		_mm_storeu_si128((__m128i *)data, _mm_aesenclast_si128(b, rk[rounds]));
+	}
+}
+
+static bool AES_CpuHasAesNi(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	// AES and SSE2
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+	{
+		return false;
+	}
+	return (ecx & (1 << 25)) && (edx & (1 << 26));
+}
+#endif
+
+typedef void (*AES_BlocksFunction)(const AES_Key &key, UINT8 *data, UINT32 numBlocks);
+
+static AES_BlocksFunction AES_SelectBlocksFunction(void)
+{
+#ifdef AES_X86_EXTENSIONS
+	if (AES_CpuHasAesNi())
+	{
+		return AES_EncryptBlocksAesNi;
+	}
+#endif
+	return AES_EncryptBlocksPortable;
+}
+
+static const AES_BlocksFunction AES_EncryptBlocks = AES_SelectBlocksFunction();
+
+
+/*
+	128 bit counters and tweaks
+*/
+
+// adds a value to a 128 bit big endian number (ctr counter block)
+static void AES_AddBigEndian(UINT8 block[AES_BLOCK_SIZE], UINT64 value)
+{
+	for (int i = AES_BLOCK_SIZE - 1; i >= 0 && value; --i)
+	{
+		value += block[i];
+		block[i] = (UINT8) value;
+		value >>= 8;
+	}
+}
+
+// adds a value to a 128 bit little endian number (xts data unit sequence number)
+static void AES_AddLittleEndian(UINT8 block[AES_BLOCK_SIZE], UINT64 value)
+{
+	for (UINT32 i = 0; i < AES_BLOCK_SIZE && value; ++i)
+	{
+		value += block[i];
+		block[i] = (UINT8) value;
+		value >>= 8;
+	}
+}
+
+// multiplies a tweak by the primitive element (alpha) of GF(2^128), in the xts byte order
+static void AES_XtsDouble(UINT8 tweak[AES_BLOCK_SIZE])
+{
+	UINT8 carry = 0;
+	for (UINT32 i = 0; i < AES_BLOCK_SIZE; ++i)
+	{
+		UINT8 next = tweak[i] >> 7;
+		tweak[i] = (UINT8) ((tweak[i] << 1) | carry);
+		carry = next;
+	}
+	if (carry)
+	{
+		tweak[0] ^= 0x87;
+	}
+}
+
+static void AES_XtsMultiply(UINT8 a[AES_BLOCK_SIZE], const UINT8 b[AES_BLOCK_SIZE])
+{
+	UINT8 result[AES_BLOCK_SIZE] = {0};
+	UINT8 power[AES_BLOCK_SIZE];
+
+	memcpy(power, a, AES_BLOCK_SIZE);
+	for (UINT32 bit = 0; bit < 8 * AES_BLOCK_SIZE; ++bit)
+	{
+		if (b[bit / 8] & (1 << (bit % 8)))
+		{
+			for (UINT32 i = 0; i < AES_BLOCK_SIZE; ++i)
+			{
+				result[i] ^= power[i];
+			}
+		}
+		AES_XtsDouble(power);
+	}
+	memcpy(a, result, AES_BLOCK_SIZE);
+}
+
+// advances a tweak by a number of blocks: tweak * alpha^numBlocks
+static void AES_XtsAdvance(UINT8 tweak[AES_BLOCK_SIZE], UINT64 numBlocks)
+{
+	UINT8 alphaPower[AES_BLOCK_SIZE] = {2};
+
+	for (; numBlocks; numBlocks >>= 1)
+	{
+		if (numBlocks & 1)
+		{
+			AES_XtsMultiply(tweak, alphaPower);
+		}
+		UINT8 square[AES_BLOCK_SIZE];
+		memcpy(square, alphaPower, AES_BLOCK_SIZE);
+		AES_XtsMultiply(alphaPower, square);
+	}
+}
+
+
+/*
+	Modes
+*/
+
+//************************************
+// Function:  AES_CtrSegment - encrypts consecutive bytes, starting at a block boundary
+// Parameter: UINT8 counter[AES_BLOCK_SIZE] - the counter of the first block
+//************************************
+static void AES_CtrSegment(const AES_Key &key, UINT8 counter[AES_BLOCK_SIZE], UINT8 *data, UINT32 size)
+{
+	UINT8 keyStream[AES_BATCH_BLOCKS * AES_BLOCK_SIZE];
+
+	while (size > 0)
+	{
+		UINT32 chunkSize = size < sizeof(keyStream) ? size : sizeof(keyStream);
+		UINT32 numBlocks = (chunkSize + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+
+		for (UINT32 i = 0; i < numBlocks; ++i)
+		{
+			memcpy(&keyStream[i * AES_BLOCK_SIZE], counter, AES_BLOCK_SIZE);
+			AES_AddBigEndian(counter, 1);
+		}
+		AES_EncryptBlocks(key, keyStream, numBlocks);
+		for (UINT32 i = 0; i < chunkSize; ++i)
+		{
+			data[i] ^= keyStream[i];
+		}
+		data += chunkSize;
+		size -= chunkSize;
+	}
+}
+
+// encrypts whole blocks of a data unit, the (encrypted) tweak is advanced past them
+static void AES_XtsBlocks(const AES_Key &key, UINT8 tweak[AES_BLOCK_SIZE], UINT8 *data, UINT32 numBlocks)
+{
+	UINT8 tweaks[AES_BATCH_BLOCKS * AES_BLOCK_SIZE];
+	UINT8 buffer[AES_BATCH_BLOCKS * AES_BLOCK_SIZE];
+
+	while (numBlocks > 0)
+	{
+		UINT32 batchBlocks = numBlocks < AES_BATCH_BLOCKS ? numBlocks : AES_BATCH_BLOCKS;
+		UINT32 batchSize = batchBlocks * AES_BLOCK_SIZE;
+
+		for (UINT32 i = 0; i < batchBlocks; ++i)
+		{
+			memcpy(&tweaks[i * AES_BLOCK_SIZE], tweak, AES_BLOCK_SIZE);
+			AES_XtsDouble(tweak);
+		}
+		for (UINT32 i = 0; i < batchSize; ++i)
+		{
+			buffer[i] = data[i] ^ tweaks[i];
+		}
+		AES_EncryptBlocks(key, buffer, batchBlocks);
+		for (UINT32 i = 0; i < batchSize; ++i)
+		{
+			data[i] = buffer[i] ^ tweaks[i];
+		}
+		data += batchSize;
+		numBlocks -= batchBlocks;
+	}
+}
+
+//************************************
+// Function:  AES_XtsSegment - encrypts the rest of a data unit, starting at a block boundary.
+//								A partial last block is handled with ciphertext stealing.
+// Parameter: UINT8 tweak[AES_BLOCK_SIZE] - the encrypted tweak of the first block
+// Parameter: UINT32 size - at least one block
+//************************************
+static void AES_XtsSegment(const AES_Key &key, UINT8 tweak[AES_BLOCK_SIZE], UINT8 *data, UINT32 size)
+{
+	UINT32 numBlocks = size / AES_BLOCK_SIZE;
+	UINT32 partialSize = size % AES_BLOCK_SIZE;
+
+	if (partialSize == 0)
+	{
+		AES_XtsBlocks(key, tweak, data, numBlocks);
+		return;
+	}
+
+	// the last full block is encrypted first, its tail completes the partial block
+	AES_XtsBlocks(key, tweak, data, numBlocks);
+	UINT8 *lastBlock = data + (numBlocks - 1) * AES_BLOCK_SIZE;
+	UINT8 *partialBlock = data + numBlocks * AES_BLOCK_SIZE;
+	UINT8 stolen[AES_BLOCK_SIZE];
+
+	memcpy(stolen, partialBlock, partialSize);
+	memcpy(stolen + partialSize, lastBlock + partialSize, AES_BLOCK_SIZE - partialSize);
+	memcpy(partialBlock, lastBlock, partialSize);
+	AES_XtsBlocks(key, tweak, stolen, 1);
+	memcpy(lastBlock, stolen, AES_BLOCK_SIZE);
+}
+
+bool AES_isValidKeySize(AES_Mode mode, UINT32 keySize)
+{
+	if (mode == AES_ctr)
+	{
+		return keySize == 16 || keySize == 24 || keySize == 32;
+	}
+	return keySize == 32 || keySize == 64;
+}
+
+UINT32 AES_Encrypt(AES_Mode mode, const UINT8 *key, UINT32 keySize, const UINT8 iv[AES_BLOCK_SIZE],
+				   UINT8 *data, UINT32 size, UINT32 sectorSize)
+{
+	UINT32 err;
+	AES_Key dataKey;
+
+	if (!AES_isValidKeySize(mode, keySize))
+	{
+		err = ERR_ILLEGAL_VAL;
+		ERR_PrintError(err, "AES key size does not suit the encryption mode");
+		return err;
+	}
+
+	if (mode == AES_ctr)
+	{
+		AES_ExpandKey(key, keySize, dataKey);
+
+		// the byte offsets are 64 bit, a size close to 4GB does not fit in whole blocks of 32 bit
+		UINT32 numBlocks = (UINT32) (((UINT64) size + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE);
+		RunParallel(numBlocks, AES_MIN_BYTES_PER_THREAD / AES_BLOCK_SIZE, [&](UINT32 firstBlock, UINT32 count)
+		{
+			UINT8 counter[AES_BLOCK_SIZE];
+			UINT64 start = (UINT64) firstBlock * AES_BLOCK_SIZE;
+			UINT64 end = (UINT64) (firstBlock + count) * AES_BLOCK_SIZE;
+
+			memcpy(counter, iv, AES_BLOCK_SIZE);
+			AES_AddBigEndian(counter, firstBlock);
+			AES_CtrSegment(dataKey, counter, data + start, (UINT32) ((end < size ? end : size) - start));
+		});
+		return STS_OK;
+	}
+
+	// xts: the first half of the key encrypts the data, the second half the tweaks
+	UINT32 unitSize = sectorSize ? sectorSize : size;
+	if (size > 0 && (unitSize < AES_BLOCK_SIZE || (size % unitSize != 0 && size % unitSize < AES_BLOCK_SIZE)))
+	{
+		err = ERR_BAD_FIELD_SIZE;
+		ERR_PrintError(err, "AES-XTS data unit is smaller than a block");
+		return err;
+	}
+
+	AES_Key tweakKey;
+	AES_ExpandKey(key, keySize / 2, dataKey);
+	AES_ExpandKey(key + keySize / 2, keySize / 2, tweakKey);
+
+	if (sectorSize == 0)
+	{
+		// a single data unit, split on block boundaries; the last range takes the partial block
+		UINT8 firstTweak[AES_BLOCK_SIZE];
+		memcpy(firstTweak, iv, AES_BLOCK_SIZE);
+		AES_EncryptBlocks(tweakKey, firstTweak, 1);
+
+		UINT32 numBlocks = size / AES_BLOCK_SIZE;
+		RunParallel(numBlocks, AES_MIN_BYTES_PER_THREAD / AES_BLOCK_SIZE, [&](UINT32 firstBlock, UINT32 count)
+		{
+			UINT8 tweak[AES_BLOCK_SIZE];
+			UINT64 start = (UINT64) firstBlock * AES_BLOCK_SIZE;
+			UINT64 end = (firstBlock + count == numBlocks) ? size : (UINT64) (firstBlock + count) * AES_BLOCK_SIZE;
+
+			memcpy(tweak, firstTweak, AES_BLOCK_SIZE);
+			AES_XtsAdvance(tweak, firstBlock);
+			AES_XtsSegment(dataKey, tweak, data + start, (UINT32) (end - start));
+		});
+	}
+	else
+	{
+		UINT32 numSectors = (UINT32) (((UINT64) size + sectorSize - 1) / sectorSize);
+		RunParallel(numSectors, AES_MIN_BYTES_PER_THREAD / sectorSize, [&](UINT32 firstSector, UINT32 count)
+		{
+			for (UINT32 sector = firstSector; sector < firstSector + count; ++sector)
+			{
+				UINT8 tweak[AES_BLOCK_SIZE];
+				UINT64 start = (UINT64) sector * sectorSize;
+				UINT32 sectorBytes = (UINT32) (size - start < sectorSize ? size - start : sectorSize);
+
+				memcpy(tweak, iv, AES_BLOCK_SIZE);
+				AES_AddLittleEndian(tweak, sector);
+				AES_EncryptBlocks(tweakKey, tweak, 1);
+				AES_XtsSegment(dataKey, tweak, data + start, sectorBytes);
+			}
+		});
+	}
+
+	return STS_OK;
+}
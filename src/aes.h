@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#ifndef AES_H
+#define AES_H
+
+#include "bingo_types.h"
+
+
+// AES=Advanced Encryption Standard (FIPS 197)
+const UINT32 AES_BLOCK_SIZE = 16;
+
+typedef enum AES_Mode
+{
+	AES_ctr,		// counter mode (SP 800-38A), 128/192/256 bit key
+	AES_xts,		// XEX tweaked mode (IEEE 1619), a double 128/256 bit key
+	AES_NUM_OF_MODES
+}AES_Mode;
+
+/*
+	Checks that the key size suits the mode
+*/
+bool AES_isValidKeySize(AES_Mode mode, UINT32 keySize);
+
+/*
+	Encrypts the data in place.
+	ctr: iv is the initial counter block, incremented as a 128 bit big endian number.
+	xts: iv is the tweak of the first data unit. If sectorSize is 0 the data is a single data unit,
+		 otherwise each sector is a data unit and its tweak is iv plus the sector index (128 bit little endian).
+	Uses the x86 AES instructions when the CPU supports them, large data is split between threads.
+*/
+UINT32 AES_Encrypt(AES_Mode mode, const UINT8 *key, UINT32 keySize, const UINT8 iv[AES_BLOCK_SIZE],
+				   UINT8 *data, UINT32 size, UINT32 sectorSize);
+
+#endif // AES_H
@@ -46,6 +46,9 @@ typedef signed   int    INT32;                  /* Signed   32 bit quantity
 
 #endif
 
+typedef unsigned long long UINT64;                  /* Unsigned 64 bit quantity                            */
+typedef signed   long long INT64;                   /* Signed   64 bit quantity                            */
+
 
 /*---------------------------------------------------------------------------------------------------------*/
 /* Auxiliary macros (not part of the interface)                                                            */
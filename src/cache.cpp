@@ -0,0 +1,677 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "cache.h"
+#include "layout.h"
+#include "errors.h"
+#include "utilities.h"
+#include "sha2.h"
+#include "tool_version.h"
+
+#ifdef __LINUX_APP__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+/*
+	Cache file layout, all values in the byte order of the machine which wrote it:
+		header:			magic, format version, tool version, SHA-256 of the XML, image size and pad value
+		dependencies:	count, then for each: file name, size, modification time
+		attributes:		the XML attributes kept for the overrides (see Field_ImageProperties::xmlAttributes)
+		fields:			count, then for each field its values, flags and the optional parts the flags
+						mark (see CACHE_PutField)
+	Strings are kept as a 32 bit size followed by the characters, a content or a mask as the field size bytes.
+	The file is created readable by its owner only, and a layout with encrypted fields is not cached at all.
+*/
+static const char CACHE_MAGIC[8] = {'B', 'I', 'N', 'G', 'O', 'C', 'A', 'C'};
+
+// changed whenever the layout of the cache file changes
+const UINT32 CACHE_FORMAT_VERSION = 6;
+
+// the XML is hashed in blocks of this size
+const UINT32 CACHE_DIGEST_BLOCK_SIZE = 0x10000;
+
+// the cache is written through a buffer of this size
+const UINT32 CACHE_WRITE_BUFFER_SIZE = 0x100000;
+
+// the flags of a cached field, most of them mark an optional part of its record
+enum CACHE_FieldFlags
+{
+	CACHE_fieldData				= 0x0001,
+	CACHE_fieldMask				= 0x0002,
+	CACHE_fieldMaskExists		= 0x0004,
+	CACHE_fieldMaskFound		= 0x0008,
+	CACHE_fieldContentIsZero	= 0x0010,
+	CACHE_fieldReversed			= 0x0020,
+	CACHE_fieldStreamed			= 0x0040,
+	CACHE_fieldComputed			= 0x0080,
+	CACHE_fieldSource			= 0x0100,
+	CACHE_fieldSide				= 0x0200,
+};
+
+/*
+	A file the fields depend on, as it was when the cache was written
+*/
+typedef struct CACHE_Dependency
+{
+	std::string	fileName;
+	UINT64		size;
+	UINT64		modified;	// modification time, in ns where supported
+}CACHE_Dependency;
+
+/*
+	Reads the values of a cache file, any read past its end marks it as failed
+*/
+typedef struct CACHE_Reader
+{
+	const UINT8	*data;
+	UINT64		size;
+	UINT64		position;
+	bool		failed;
+}CACHE_Reader;
+
+/*
+	Writes the values of a cache file through a buffer, a failed write marks it as failed
+*/
+typedef struct CACHE_Writer
+{
+	FILE				*file;
+	std::vector<UINT8>	buffer;
+	UINT32				used;
+	bool				failed;
+}CACHE_Writer;
+
+// the files recorded while parsing, in the order they were first used
+static vector<string> CacheDependencies;
+
+// the digest of the XML computed by CACHE_Load, the XML is hashed once in a run which rewrites the cache
+static string CacheDigestXmlFile;
+static UINT8 CacheXmlDigest[SHA256_DIGEST_SIZE];
+
+
+void CACHE_AddDependency( const std::string &fileName )
+{
+	for (vector<string>::iterator it = CacheDependencies.begin(); it != CacheDependencies.end(); ++it)
+	{
+		if (*it == fileName)
+		{
+			return;
+		}
+	}
+	CacheDependencies.push_back(fileName);
+}
+
+bool CACHE_GetFileState( const string &fileName, UINT64 &size, UINT64 &modified )
+{
+	struct stat fileStat;
+	if (stat(fileName.c_str(), &fileStat) != 0)
+	{
+		return false;
+	}
+	size = (UINT64) fileStat.st_size;
+#ifdef __LINUX_APP__
+	modified = (UINT64) fileStat.st_mtim.tv_sec * 1000000000ULL + (UINT64) fileStat.st_mtim.tv_nsec;
+#else
+	modified = (UINT64) fileStat.st_mtime;
+#endif
+	return true;
+}
+
+static bool CACHE_GetXmlDigest( const string &xmlFile, UINT8 digest[SHA256_DIGEST_SIZE] )
+{
+	// as it was before the XML was parsed, a change while parsing is found by the next run
+	if (!CacheDigestXmlFile.empty() && CacheDigestXmlFile == xmlFile)
+	{
+		memcpy(digest, CacheXmlDigest, SHA256_DIGEST_SIZE);
+		return true;
+	}
+	ifstream xml(xmlFile.c_str(), ios::binary);
+	if (!xml.is_open())
+	{
+		return false;
+	}
+	vector<UINT8> block(CACHE_DIGEST_BLOCK_SIZE);
+
+	SHA256_Context ctx;
+	SHA256_Init(ctx);
+	while (xml.read((char *) &block[0], block.size()) || xml.gcount() > 0)
+	{
+		SHA256_Update(ctx, &block[0], (UINT32) xml.gcount());
+	}
+
+	// the values parsed depend on the layout variables as well
+	const map<string, string> &variables = LAYOUT_GetVariables();
+	for (map<string, string>::const_iterator it = variables.begin(); it != variables.end(); ++it)
+	{
+		string definition = it->first + "=" + it->second;
+		SHA256_Update(ctx, (const UINT8 *) definition.c_str(), (UINT32) definition.size() + 1);
+	}
+	SHA256_Final(ctx, digest);
+	memcpy(CacheXmlDigest, digest, SHA256_DIGEST_SIZE);
+	CacheDigestXmlFile = xmlFile;
+	return true;
+}
+
+
+/*
+	Writing
+*/
+
+static void CACHE_Flush( CACHE_Writer &writer )
+{
+	if (writer.used > 0 && !writer.failed)
+	{
+		writer.failed = (fwrite(&writer.buffer[0], 1, writer.used, writer.file) != writer.used);
+	}
+	writer.used = 0;
+}
+
+static void CACHE_Put( CACHE_Writer &writer, const void *data, UINT64 size )
+{
+	if (size > writer.buffer.size() - writer.used)
+	{
+		CACHE_Flush(writer);
+		if (size >= writer.buffer.size())
+		{
+			// a large buffer (a field content) is written as is
+			writer.failed = writer.failed || (fwrite(data, 1, (size_t) size, writer.file) != size);
+			return;
+		}
+	}
+	memcpy(&writer.buffer[writer.used], data, (size_t) size);
+	writer.used += (UINT32) size;
+}
+
+static void CACHE_PutU8( CACHE_Writer &writer, UINT8 value )
+{
+	CACHE_Put(writer, &value, sizeof(value));
+}
+
+static void CACHE_PutU16( CACHE_Writer &writer, UINT16 value )
+{
+	CACHE_Put(writer, &value, sizeof(value));
+}
+
+static void CACHE_PutU32( CACHE_Writer &writer, UINT32 value )
+{
+	CACHE_Put(writer, &value, sizeof(value));
+}
+
+static void CACHE_PutU64( CACHE_Writer &writer, UINT64 value )
+{
+	CACHE_Put(writer, &value, sizeof(value));
+}
+
+static void CACHE_PutString( CACHE_Writer &writer, const string &str )
+{
+	CACHE_PutU32(writer, (UINT32) str.size());
+	CACHE_Put(writer, str.data(), str.size());
+}
+
+static void CACHE_PutAttributes( CACHE_Writer &writer, const Field_Attributes &attributes )
+{
+	CACHE_PutU32(writer, attributes.format_id);
+	CACHE_PutU32(writer, attributes.alignment);
+	CACHE_PutU64(writer, attributes.fileStartOffset);
+	CACHE_PutU8(writer, attributes.reversed);
+	CACHE_PutU64(writer, attributes.rangeOffset);
+	CACHE_PutU64(writer, attributes.rangeSize);
+	CACHE_PutString(writer, attributes.signer);
+	CACHE_PutString(writer, attributes.signerLibrary);
+	CACHE_PutU32(writer, attributes.digestFormat);
+	CACHE_PutU32(writer, attributes.compression);
+}
+
+static void CACHE_PutField( CACHE_Writer &writer, const Field_BinField *field )
+{
+	const Field_SideSettings *side = field->findSide();
+	UINT16 flags = (field->dataBuffer ? CACHE_fieldData : 0) | (field->maskBuffer ? CACHE_fieldMask : 0) |
+				   (field->maskExists ? CACHE_fieldMaskExists : 0) | (field->maskFound ? CACHE_fieldMaskFound : 0) |
+				   (field->contentIsZero ? CACHE_fieldContentIsZero : 0) | (field->isReversed ? CACHE_fieldReversed : 0) |
+				   (field->isStreamed ? CACHE_fieldStreamed : 0) | (field->isComputed ? CACHE_fieldComputed : 0) |
+				   (field->sourceFile.empty() ? 0 : CACHE_fieldSource) | (side ? CACHE_fieldSide : 0);
+
+	CACHE_PutString(writer, field->name);
+	CACHE_PutU8(writer, (UINT8) field->eccType);
+	CACHE_PutU64(writer, field->offset);
+	CACHE_PutU64(writer, field->size);
+	CACHE_PutU16(writer, flags);
+	if (field->dataBuffer)
+	{
+		CACHE_Put(writer, field->dataBuffer, field->size);
+	}
+	if (field->maskBuffer)
+	{
+		CACHE_Put(writer, field->maskBuffer, field->size);
+	}
+	if (!field->sourceFile.empty())
+	{
+		CACHE_PutString(writer, field->sourceFile);
+		CACHE_PutU64(writer, field->sourceOffset);
+	}
+
+	// the side settings, of the few fields which have them (not an encryption, see CACHE_Save)
+	if (side == nullptr)
+	{
+		return;
+	}
+	CACHE_PutString(writer, side->computedSource);
+	CACHE_PutAttributes(writer, side->computedAttributes);
+	CACHE_PutU32(writer, (UINT32) side->deferredValues.size());
+	for (vector<Field_DeferredValue>::const_iterator it = side->deferredValues.begin(); it != side->deferredValues.end(); ++it)
+	{
+		CACHE_PutString(writer, it->configurationString);
+		CACHE_PutString(writer, it->valueString);
+		CACHE_PutAttributes(writer, it->attributes);
+	}
+}
+
+//************************************
+// Function:  CACHE_CreateFile - creates (or truncates) the cache file, readable and writable by its owner only
+// Returns:   FILE * - NULL if it can not be created
+// Parameter: const std::string & cacheFile
+//************************************
+static FILE *CACHE_CreateFile( const string &cacheFile )
+{
+#ifdef __LINUX_APP__
+	int fd = open(cacheFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd < 0)
+	{
+		return NULL;
+	}
+	// a file which existed keeps its mode, it is set as well
+	FILE *file = (fchmod(fd, S_IRUSR | S_IWUSR) == 0) ? fdopen(fd, "wb") : NULL;
+	if (file == NULL)
+	{
+		close(fd);
+	}
+	return file;
+#else
+	return fopen(cacheFile.c_str(), "wb");
+#endif
+}
+
+UINT32 CACHE_Save( const std::string &cacheFile, const std::string &xmlFile, const std::vector<Field_BinField *> &fields,
+				   const Field_ImageProperties &imageConfig )
+{
+	UINT32 err;
+	UINT8 digest[SHA256_DIGEST_SIZE];
+	CACHE_Writer writer;
+
+	// the keys (and the plain contents) of encrypted fields are not written to disk
+	for (vector<Field_BinField *>::const_iterator it = fields.begin(); it != fields.end(); ++it)
+	{
+		if ((*it)->isEncrypted())
+		{
+			cout << "layout cache: not written, " << (*it)->name << " is encrypted" << endl;
+			remove(cacheFile.c_str());
+			return STS_OK;
+		}
+	}
+
+	if (!CACHE_GetXmlDigest(xmlFile, digest))
+	{
+		err = ERR_FILE_NOT_FOUND;
+		ERR_PrintError(err, "Filename: " + xmlFile);
+		return err;
+	}
+
+	writer.file = CACHE_CreateFile(cacheFile);
+	if (writer.file == NULL)
+	{
+		err = ERR_OUTPUT_FILE;
+		ERR_PrintError(err, "layout cache: " + cacheFile);
+		return err;
+	}
+	writer.buffer.resize(CACHE_WRITE_BUFFER_SIZE);
+	writer.used = 0;
+	writer.failed = false;
+
+	CACHE_Put(writer, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	CACHE_PutU32(writer, CACHE_FORMAT_VERSION);
+	CACHE_PutU32(writer, BingoVersion);
+	CACHE_Put(writer, digest, sizeof(digest));
+	CACHE_PutU64(writer, imageConfig.size);
+	CACHE_PutU8(writer, imageConfig.paddingValue);
+
+	CACHE_PutU32(writer, (UINT32) CacheDependencies.size());
+	for (vector<string>::iterator it = CacheDependencies.begin(); it != CacheDependencies.end() && !writer.failed; ++it)
+	{
+		UINT64 size;
+		UINT64 modified;
+		if (!CACHE_GetFileState(*it, size, modified))
+		{
+			err = ERR_FILE_NOT_FOUND;
+			ERR_PrintError(err, "Filename: " + *it);
+			fclose(writer.file);
+			remove(cacheFile.c_str());
+			return err;
+		}
+		CACHE_PutString(writer, *it);
+		CACHE_PutU64(writer, size);
+		CACHE_PutU64(writer, modified);
+	}
+
+	// for the overrides, which are applied to the cached fields
+	CACHE_PutU8(writer, imageConfig.keepXmlAttributes);
+	CACHE_PutU32(writer, (UINT32) imageConfig.xmlAttributes.size());
+	for (map<string, Field_XmlAttributes>::const_iterator it = imageConfig.xmlAttributes.begin(); it != imageConfig.xmlAttributes.end(); ++it)
+	{
+		CACHE_PutString(writer, it->first);
+		CACHE_PutAttributes(writer, it->second.content);
+		CACHE_PutAttributes(writer, it->second.mask);
+	}
+
+	CACHE_PutU32(writer, (UINT32) fields.size());
+	for (vector<Field_BinField *>::const_iterator it = fields.begin(); it != fields.end() && !writer.failed; ++it)
+	{
+		CACHE_PutField(writer, *it);
+	}
+
+	CACHE_Flush(writer);
+	writer.failed = (fclose(writer.file) != 0) || writer.failed;
+	if (writer.failed)
+	{
+		err = ERR_OUTPUT_FILE;
+		ERR_PrintError(err, "layout cache: " + cacheFile);
+		remove(cacheFile.c_str());
+		return err;
+	}
+	return STS_OK;
+}
+
+
+/*
+	Reading
+*/
+
+static void CACHE_Get( CACHE_Reader &reader, void *data, UINT64 size )
+{
+	if (reader.failed || size > reader.size - reader.position)
+	{
+		reader.failed = true;
+		memset(data, 0, (size_t) size);
+		return;
+	}
+	memcpy(data, reader.data + reader.position, (size_t) size);
+	reader.position += size;
+}
+
+static UINT8 CACHE_GetU8( CACHE_Reader &reader )
+{
+	UINT8 value;
+	CACHE_Get(reader, &value, sizeof(value));
+	return value;
+}
+
+static UINT16 CACHE_GetU16( CACHE_Reader &reader )
+{
+	UINT16 value;
+	CACHE_Get(reader, &value, sizeof(value));
+	return value;
+}
+
+static UINT32 CACHE_GetU32( CACHE_Reader &reader )
+{
+	UINT32 value;
+	CACHE_Get(reader, &value, sizeof(value));
+	return value;
+}
+
+static UINT64 CACHE_GetU64( CACHE_Reader &reader )
+{
+	UINT64 value;
+	CACHE_Get(reader, &value, sizeof(value));
+	return value;
+}
+
+static string CACHE_GetString( CACHE_Reader &reader )
+{
+	UINT32 size = CACHE_GetU32(reader);
+	if (reader.failed || size > reader.size - reader.position)
+	{
+		reader.failed = true;
+		return "";
+	}
+	string str((const char *) reader.data + reader.position, (size_t) size);
+	reader.position += size;
+	return str;
+}
+
+static UINT8 *CACHE_GetBuffer( CACHE_Reader &reader, UINT64 size, FLD_Arena &arena )
+{
+	if (reader.failed || size > reader.size - reader.position)
+	{
+		reader.failed = true;
+		return nullptr;
+	}
+	UINT8 *buffer = arena.allocate(size);
+	CACHE_Get(reader, buffer, size);
+	return buffer;
+}
+
+static void CACHE_GetAttributes( CACHE_Reader &reader, Field_Attributes &attributes )
+{
+	attributes.format_id = CACHE_GetU32(reader);
+	attributes.alignment = CACHE_GetU32(reader);
+	attributes.fileStartOffset = CACHE_GetU64(reader);
+	attributes.reversed = (CACHE_GetU8(reader) != 0);
+	attributes.rangeOffset = CACHE_GetU64(reader);
+	attributes.rangeSize = CACHE_GetU64(reader);
+	attributes.signer = CACHE_GetString(reader);
+	attributes.signerLibrary = CACHE_GetString(reader);
+	attributes.digestFormat = CACHE_GetU32(reader);
+	attributes.compression = (CMP_Type) CACHE_GetU32(reader);
+}
+
+static void CACHE_GetField( CACHE_Reader &reader, Field_BinField *field )
+{
+	field->name = CACHE_GetString(reader);
+	field->eccType = (ECC_Type) CACHE_GetU8(reader);
+	field->offset = CACHE_GetU64(reader);
+	field->size = CACHE_GetU64(reader);
+	UINT16 flags = CACHE_GetU16(reader);
+	if (flags & CACHE_fieldData)
+	{
+		field->dataBuffer = CACHE_GetBuffer(reader, field->size, field->imageConfig->arena);
+	}
+	if (flags & CACHE_fieldMask)
+	{
+		field->maskBuffer = CACHE_GetBuffer(reader, field->size, field->imageConfig->arena);
+	}
+	field->maskExists = ((flags & CACHE_fieldMaskExists) != 0);
+	field->maskFound = ((flags & CACHE_fieldMaskFound) != 0);
+	field->contentIsZero = ((flags & CACHE_fieldContentIsZero) != 0);
+	field->isReversed = ((flags & CACHE_fieldReversed) != 0);
+	field->isStreamed = ((flags & CACHE_fieldStreamed) != 0);
+	field->isComputed = ((flags & CACHE_fieldComputed) != 0);
+	if (flags & CACHE_fieldSource)
+	{
+		field->sourceFile = CACHE_GetString(reader);
+		field->sourceOffset = CACHE_GetU64(reader);
+	}
+
+	if (!(flags & CACHE_fieldSide) || reader.failed)
+	{
+		return;
+	}
+	Field_SideSettings *side = field->getSide();
+	side->computedSource = CACHE_GetString(reader);
+	CACHE_GetAttributes(reader, side->computedAttributes);
+	UINT32 deferred = CACHE_GetU32(reader);
+	for (UINT32 i = 0; i < deferred && !reader.failed; ++i)
+	{
+		Field_DeferredValue value;
+		value.configurationString = CACHE_GetString(reader);
+		value.valueString = CACHE_GetString(reader);
+		CACHE_GetAttributes(reader, value.attributes);
+		side->deferredValues.push_back(value);
+		field->imageConfig->hasDeferredValues = true;
+	}
+}
+
+//************************************
+// Function:  CACHE_ReadFields - reads the fields from the cache file content, if it is valid for the XML
+// Returns:   bool - false if the cache can not be used
+// Parameter: CACHE_Reader & reader
+// Parameter: const UINT8 xmlDigest[SHA256_DIGEST_SIZE]
+// Parameter: std::vector<Field_BinField * > & fields
+// Parameter: Field_ImageProperties & imageConfig
+//************************************
+static bool CACHE_ReadFields( CACHE_Reader &reader, const UINT8 xmlDigest[SHA256_DIGEST_SIZE], vector<Field_BinField *> &fields,
+							  Field_ImageProperties &imageConfig )
+{
+	char magic[sizeof(CACHE_MAGIC)];
+	UINT8 digest[SHA256_DIGEST_SIZE];
+
+	CACHE_Get(reader, magic, sizeof(magic));
+	UINT32 formatVersion = CACHE_GetU32(reader);
+	UINT32 toolVersion = CACHE_GetU32(reader);
+	CACHE_Get(reader, digest, sizeof(digest));
+	if (reader.failed || memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 || formatVersion != CACHE_FORMAT_VERSION ||
+		toolVersion != BingoVersion)
+	{
+		cout << "layout cache: not a cache of this version of bingo, parsing the XML" << endl;
+		return false;
+	}
+	if (memcmp(digest, xmlDigest, sizeof(digest)) != 0)
+	{
+		cout << "layout cache: the XML (or a -D variable) changed, parsing it" << endl;
+		return false;
+	}
+	// kept aside until the whole cache is read, the XML parser rejects an image size set twice
+	UINT64 imageSize = CACHE_GetU64(reader);
+	UINT8 paddingValue = CACHE_GetU8(reader);
+
+	UINT32 dependencies = CACHE_GetU32(reader);
+	for (UINT32 i = 0; i < dependencies && !reader.failed; ++i)
+	{
+		CACHE_Dependency cached;
+		CACHE_Dependency current;
+		cached.fileName = CACHE_GetString(reader);
+		cached.size = CACHE_GetU64(reader);
+		cached.modified = CACHE_GetU64(reader);
+		if (!reader.failed && (!CACHE_GetFileState(cached.fileName, current.size, current.modified) ||
+							   current.size != cached.size || current.modified != cached.modified))
+		{
+			cout << "layout cache: " << cached.fileName << " changed, parsing the XML" << endl;
+			return false;
+		}
+	}
+
+	bool hasXmlAttributes = (CACHE_GetU8(reader) != 0);
+	if (!reader.failed && imageConfig.keepXmlAttributes && !hasXmlAttributes)
+	{
+		cout << "layout cache: the cache was written without overrides, parsing the XML" << endl;
+		return false;
+	}
+	UINT32 attributes = CACHE_GetU32(reader);
+	for (UINT32 i = 0; i < attributes && !reader.failed; ++i)
+	{
+		Field_XmlAttributes &xmlAttributes = imageConfig.xmlAttributes[CACHE_GetString(reader)];
+		CACHE_GetAttributes(reader, xmlAttributes.content);
+		CACHE_GetAttributes(reader, xmlAttributes.mask);
+	}
+
+	UINT32 count = CACHE_GetU32(reader);
+	for (UINT32 i = 0; i < count && !reader.failed; ++i)
+	{
+		Field_BinField *field = new Field_BinField(&imageConfig);
+		fields.push_back(field);
+		CACHE_GetField(reader, field);
+	}
+
+	if (reader.failed || reader.position != reader.size)
+	{
+		cout << "layout cache: the cache file is corrupted, parsing the XML" << endl;
+		LAYOUT_FreeFields(fields);
+		imageConfig.arena.release();
+		imageConfig.sideSettings.clear();
+		imageConfig.hasDeferredValues = false;
+		imageConfig.xmlAttributes.clear();
+		return false;
+	}
+	imageConfig.size = imageSize;
+	imageConfig.paddingValue = paddingValue;
+	return true;
+}
+
+bool CACHE_Load( const std::string &cacheFile, const std::string &xmlFile, std::vector<Field_BinField *> &fields,
+				 Field_ImageProperties &imageConfig )
+{
+	bool loaded = false;
+	UINT8 digest[SHA256_DIGEST_SIZE];
+	CACHE_Reader reader;
+
+	if (!CACHE_GetXmlDigest(xmlFile, digest))
+	{
+		return false; // reported by the XML parser
+	}
+
+	reader.position = 0;
+	reader.failed = false;
+#ifdef __LINUX_APP__
+	// the cache is mapped, and its values are read in place
+	struct stat fileStat;
+	int fd = open(cacheFile.c_str(), O_RDONLY);
+	if (fd < 0 || fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		return false;
+	}
+	void *mapped = mmap(NULL, (size_t) fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED)
+	{
+		return false;
+	}
+	reader.data = (const UINT8 *) mapped;
+	reader.size = (UINT64) fileStat.st_size;
+	loaded = CACHE_ReadFields(reader, digest, fields, imageConfig);
+	munmap(mapped, (size_t) fileStat.st_size);
+#else
+	ifstream file(cacheFile.c_str(), ios::binary | ios::ate);
+	if (!file.is_open() || file.tellg() <= 0)
+	{
+		return false;
+	}
+	vector<UINT8> content((size_t) file.tellg());
+	file.seekg(0, ios::beg);
+	if (!file.read((char *) &content[0], content.size()))
+	{
+		return false;
+	}
+	reader.data = &content[0];
+	reader.size = content.size();
+	loaded = CACHE_ReadFields(reader, digest, fields, imageConfig);
+#endif
+
+	if (loaded && verbosLevel)
+	{
+		cout << "Layout loaded from cache " << cacheFile << endl;
+	}
+	return loaded;
+}
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <string>
+#include <vector>
+#include "fields.h"
+#include "bingo_types.h"
+
+
+// CACHE=Layout cache, the parsed fields of an XML kept in a binary file
+
+/*
+	Records a file the parsed fields depend on (a FileContent, a key file, a Layout XML...).
+	A cache is valid as long as its XML and all of these files are unchanged.
+*/
+void CACHE_AddDependency(const std::string &fileName);
+
+/*
+	Gets the size and the modification time (in ns where supported) of a file, false if it does not exist
+*/
+bool CACHE_GetFileState(const std::string &fileName, UINT64 &size, UINT64 &modified);
+
+/*
+	Loads the fields of the XML from the cache file, if it was written for the same XML (by its hash)
+	and its dependencies did not change. Returns false if the XML needs to be parsed.
+*/
+bool CACHE_Load(const std::string &cacheFile, const std::string &xmlFile, std::vector<Field_BinField *> &fields,
+				Field_ImageProperties &imageConfig);
+
+/*
+	Writes the fields parsed from the XML (references resolved) to the cache file
+*/
+UINT32 CACHE_Save(const std::string &cacheFile, const std::string &xmlFile, const std::vector<Field_BinField *> &fields,
+				  const Field_ImageProperties &imageConfig);
+
+#endif // CACHE_H
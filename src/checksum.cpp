@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#include "checksum.h"
+
+/*
+	CRC parameters, per CRC_Type
+*/
+typedef struct CRC_Model
+{
+	UINT32	width;		// in bits
+	UINT32	poly;		// bit reversed for reflected CRCs
+	UINT32	init;
+	UINT32	xorOut;
+	bool	reflected;
+}CRC_Model;
+
+static const CRC_Model CRC_Models[NUM_OF_CRC_TYPES] =
+{
+	{16, 0xA001,     0x0000,     0x0000,     true},		// CRC_crc16
+	{16, 0x1021,     0xFFFF,     0x0000,     false},	// CRC_ccitt
+	{16, 0xA6BC,     0x0000,     0xFFFF,     true},		// CRC_dnp
+	{32, 0xEDB88320, 0xFFFFFFFF, 0xFFFFFFFF, true},		// CRC_crc32
+};
+
+// Slicing-by-8 tables: CRC_Tables[type][k][b] is the CRC contribution of byte b followed by k zero bytes
+static UINT32 CRC_Tables[NUM_OF_CRC_TYPES][8][256];
+static bool   CRC_TablesReady[NUM_OF_CRC_TYPES] = {false};
+
+
+static void CRC_BuildTables(CRC_Type type)
+{
+	const CRC_Model &model = CRC_Models[type];
+	UINT32 (*tables)[256] = CRC_Tables[type];
+	UINT32 topBit = 1UL << (model.width - 1);
+	UINT32 mask = (model.width == 32) ? 0xFFFFFFFF : ((1UL << model.width) - 1);
+
+	for (UINT32 b = 0; b < 256; ++b)
+	{
+		UINT32 c;
+		if (model.reflected)
+		{
+			c = b;
+			for (int bit = 0; bit < 8; ++bit)
+			{
+				c = (c & 1) ? ((c >> 1) ^ model.poly) : (c >> 1);
+			}
+		}
+		else
+		{
+			c = b << (model.width - 8);
+			for (int bit = 0; bit < 8; ++bit)
+			{
+				c = (c & topBit) ? ((c << 1) ^ model.poly) : (c << 1);
+			}
+			c &= mask;
+		}
+		tables[0][b] = c;
+	}
+
+	for (UINT32 k = 1; k < 8; ++k)
+	{
+		for (UINT32 b = 0; b < 256; ++b)
+		{
+			UINT32 c = tables[k - 1][b];
+			if (model.reflected)
+			{
+				tables[k][b] = (c >> 8) ^ tables[0][c & 0xFF];
+			}
+			else
+			{
+				tables[k][b] = ((c << 8) & mask) ^ tables[0][(c >> (model.width - 8)) & 0xFF];
+			}
+		}
+	}
+
+	CRC_TablesReady[type] = true;
+}
+
+UINT32 CRC_getSize(CRC_Type type)
+{
+	return CRC_Models[type].width / 8;
+}
+
+UINT32 CRC_Init(CRC_Type type)
+{
+	if (!CRC_TablesReady[type])
+	{
+		CRC_BuildTables(type);
+	}
+	return CRC_Models[type].init;
+}
+
+//************************************
+// Function:  CRC_Update - updates the CRC with a data buffer, eight bytes per step (slicing-by-8)
+// Returns:   UINT32 - the updated CRC register
+// Parameter: CRC_Type type
+// Parameter: UINT32 crc - value returned by CRC_Init or by a previous CRC_Update
+// Parameter: const UINT8 * data
+// Parameter: UINT32 size
+//************************************
+UINT32 CRC_Update(CRC_Type type, UINT32 crc, const UINT8 *data, UINT32 size)
+{
+	const CRC_Model &model = CRC_Models[type];
+	const UINT32 (*t)[256] = CRC_Tables[type];
+
+	if (model.reflected)
+	{
+		while (size >= 8)
+		{
+			UINT32 one = (data[0] | (data[1] << 8) | (data[2] << 16) | ((UINT32)data[3] << 24)) ^ crc;
+			UINT32 two = (data[4] | (data[5] << 8) | (data[6] << 16) | ((UINT32)data[7] << 24));
+			crc = t[7][one & 0xFF] ^ t[6][(one >> 8) & 0xFF] ^ t[5][(one >> 16) & 0xFF] ^ t[4][one >> 24] ^
+				  t[3][two & 0xFF] ^ t[2][(two >> 8) & 0xFF] ^ t[1][(two >> 16) & 0xFF] ^ t[0][two >> 24];
+			data += 8;
+			size -= 8;
+		}
+		while (size--)
+		{
+			crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+		}
+	}
+	else
+	{
+		// only 16 bit CRCs are not reflected
+		while (size >= 8)
+		{
+			crc = t[7][data[0] ^ (crc >> 8)] ^ t[6][data[1] ^ (crc & 0xFF)] ^ t[5][data[2]] ^ t[4][data[3]] ^
+				  t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+			data += 8;
+			size -= 8;
+		}
+		while (size--)
+		{
+			crc = ((crc << 8) & 0xFFFF) ^ t[0][((crc >> 8) ^ *data++) & 0xFF];
+		}
+	}
+	return crc;
+}
+
+UINT32 CRC_Final(CRC_Type type, UINT32 crc)
+{
+	return crc ^ CRC_Models[type].xorOut;
+}
+
+UINT32 CRC_Calculate(CRC_Type type, const UINT8 *data, UINT32 size)
+{
+	UINT32 crc = CRC_Init(type);
+	crc = CRC_Update(type, crc, data, size);
+	return CRC_Final(type, crc);
+}
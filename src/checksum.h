@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include "bingo_types.h"
+
+
+// CRC=Cyclic Redundancy Check, same polynomials as src/crc/lib_crc.c
+typedef enum CRC_Type
+{
+	CRC_crc16 = 0,	// CRC-16 (ARC):  poly 0x8005 reflected, init 0x0000
+	CRC_ccitt,		// CRC-CCITT:     poly 0x1021, init 0xFFFF
+	CRC_dnp,		// CRC-DNP:       poly 0x3D65 reflected, init 0x0000, inverted result
+	CRC_crc32,		// CRC-32 (IEEE): poly 0x04C11DB7 reflected, init 0xFFFFFFFF, inverted result
+	NUM_OF_CRC_TYPES
+}CRC_Type;
+
+/*
+	Size of the CRC value in bytes
+*/
+UINT32 CRC_getSize(CRC_Type type);
+
+/*
+	Incremental CRC calculation: CRC_Init, CRC_Update (any number of times), CRC_Final
+*/
+UINT32 CRC_Init(CRC_Type type);
+UINT32 CRC_Update(CRC_Type type, UINT32 crc, const UINT8 *data, UINT32 size);
+UINT32 CRC_Final(CRC_Type type, UINT32 crc);
+
+/*
+	CRC of a single buffer
+*/
+UINT32 CRC_Calculate(CRC_Type type, const UINT8 *data, UINT32 size);
+
+#endif // CHECKSUM_H
@@ -0,0 +1,272 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#include <cstring>
+#include "compress.h"
+#include "errors.h"
+#include "utilities.h"
+
+using namespace std;
+
+
+/*
+	xxHash32, the LZ4 frame checksum
+*/
+
+const UINT32 XXH_PRIME1 = 2654435761U;
+const UINT32 XXH_PRIME2 = 2246822519U;
+const UINT32 XXH_PRIME3 = 3266489917U;
+const UINT32 XXH_PRIME4 = 668265263U;
+const UINT32 XXH_PRIME5 = 374761393U;
+
+#define ROTL32(x, n)	(((x) << (n)) | ((x) >> (32 - (n))))
+
+static UINT32 CMP_Read32(const UINT8 *p)
+{
+	return (UINT32)p[0] | ((UINT32)p[1] << 8) | ((UINT32)p[2] << 16) | ((UINT32)p[3] << 24);
+}
+
+static void CMP_Write32(vector<UINT8> &out, UINT32 value)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		out.push_back((UINT8) (value >> (8 * i)));
+	}
+}
+
+static UINT32 CMP_XXH32(const UINT8 *data, UINT32 size, UINT32 seed)
+{
+	const UINT8 *end = data + size;
+	UINT32 h;
+
+	if (size >= 16)
+	{
+		UINT32 v1 = seed + XXH_PRIME1 + XXH_PRIME2;
+		UINT32 v2 = seed + XXH_PRIME2;
+		UINT32 v3 = seed;
+		UINT32 v4 = seed - XXH_PRIME1;
+		for (; data + 16 <= end; data += 16)
+		{
+			v1 = ROTL32(v1 + CMP_Read32(data) * XXH_PRIME2, 13) * XXH_PRIME1;
+			v2 = ROTL32(v2 + CMP_Read32(data + 4) * XXH_PRIME2, 13) * XXH_PRIME1;
+			v3 = ROTL32(v3 + CMP_Read32(data + 8) * XXH_PRIME2, 13) * XXH_PRIME1;
+			v4 = ROTL32(v4 + CMP_Read32(data + 12) * XXH_PRIME2, 13) * XXH_PRIME1;
+		}
+		h = ROTL32(v1, 1) + ROTL32(v2, 7) + ROTL32(v3, 12) + ROTL32(v4, 18);
+	}
+	else
+	{
+		h = seed + XXH_PRIME5;
+	}
+
+	h += size;
+	for (; data + 4 <= end; data += 4)
+	{
+		h = ROTL32(h + CMP_Read32(data) * XXH_PRIME3, 17) * XXH_PRIME4;
+	}
+	for (; data < end; ++data)
+	{
+		h = ROTL32(h + (*data) * XXH_PRIME5, 11) * XXH_PRIME1;
+	}
+
+	h ^= h >> 15;
+	h *= XXH_PRIME2;
+	h ^= h >> 13;
+	h *= XXH_PRIME3;
+	h ^= h >> 16;
+	return h;
+}
+
+
+/*
+	LZ4 block compression (greedy, single hash probe)
+*/
+
+const UINT32 LZ4_BLOCK_SIZE = 0x10000;		// frame block maximum size id 4
+const UINT32 LZ4_MIN_MATCH = 4;
+const UINT32 LZ4_LAST_LITERALS = 5;			// the last bytes of a block are always literals
+const UINT32 LZ4_MATCH_FIND_LIMIT = 12;		// the last match starts at least this far from the block end
+const UINT32 LZ4_MAX_OFFSET = 0xFFFF;
+const UINT32 LZ4_HASH_LOG = 12;
+const UINT32 LZ4_NO_POSITION = 0xFFFFFFFF;
+
+// blocks compressed by a thread at least
+const UINT32 LZ4_MIN_BLOCKS_PER_THREAD = 4;
+
+static UINT32 LZ4_Hash(UINT32 sequence)
+{
+	return (sequence * XXH_PRIME1) >> (32 - LZ4_HASH_LOG);
+}
+
+static void LZ4_WriteLength(UINT8 *&op, UINT32 length)
+{
+	for (; length >= 255; length -= 255)
+	{
+		*op++ = 255;
+	}
+	*op++ = (UINT8) length;
+}
+
+static void LZ4_WriteLiterals(UINT8 *&op, UINT8 *token, const UINT8 *literals, UINT32 length)
+{
+	if (length >= 15)
+	{
+		*token = 15 << 4;
+		LZ4_WriteLength(op, length - 15);
+	}
+	else
+	{
+		*token = (UINT8) (length << 4);
+	}
+	memcpy(op, literals, length);
+	op += length;
+}
+
+//************************************
+// Function:  LZ4_CompressBlock - compresses a block into dst, which has room for LZ4_BlockBound(size)
+// Returns:   UINT32 - the compressed size
+//************************************
+static UINT32 LZ4_CompressBlock(const UINT8 *src, UINT32 size, UINT8 *dst)
+{
+	UINT8 *op = dst;
+	UINT32 anchor = 0;
+
+	if (size > LZ4_MATCH_FIND_LIMIT)
+	{
+		vector<UINT32> table(1 << LZ4_HASH_LOG, LZ4_NO_POSITION);
+		UINT32 matchLimit = size - LZ4_LAST_LITERALS;
+		UINT32 ipLimit = size - LZ4_MATCH_FIND_LIMIT;
+		UINT32 ip = 0;
+
+		while (ip <= ipLimit)
+		{
+			UINT32 sequence = CMP_Read32(src + ip);
+			UINT32 hash = LZ4_Hash(sequence);
+			UINT32 ref = table[hash];
+			table[hash] = ip;
+
+			if (ref == LZ4_NO_POSITION || ip - ref > LZ4_MAX_OFFSET || CMP_Read32(src + ref) != sequence)
+			{
+				// skip faster over data which does not compress
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+
+			// extend the match backwards over the pending literals, and forwards
+			while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1])
+			{
+				--ip;
+				--ref;
+			}
+			UINT32 length = LZ4_MIN_MATCH;
+			while (ip + length < matchLimit && src[ip + length] == src[ref + length])
+			{
+				++length;
+			}
+
+			UINT8 *token = op++;
+			LZ4_WriteLiterals(op, token, src + anchor, ip - anchor);
+			*op++ = (UINT8) (ip - ref);
+			*op++ = (UINT8) ((ip - ref) >> 8);
+			if (length - LZ4_MIN_MATCH >= 15)
+			{
+				*token |= 15;
+				LZ4_WriteLength(op, length - LZ4_MIN_MATCH - 15);
+			}
+			else
+			{
+				*token |= (UINT8) (length - LZ4_MIN_MATCH);
+			}
+
+			ip += length;
+			anchor = ip;
+			if (ip - 2 <= ipLimit)
+			{
+				table[LZ4_Hash(CMP_Read32(src + ip - 2))] = ip - 2;
+			}
+		}
+	}
+
+	UINT8 *token = op++;
+	LZ4_WriteLiterals(op, token, src + anchor, size - anchor);
+	return (UINT32) (op - dst);
+}
+
+static UINT32 LZ4_BlockBound(UINT32 size)
+{
+	return size + size / 255 + 16;
+}
+
+//************************************
+// Function:  LZ4_CompressFrame - compresses into an LZ4 frame. The blocks are independent,
+//								   so they are compressed in parallel.
+// Returns:   UINT32
+//************************************
+static UINT32 LZ4_CompressFrame(const UINT8 *data, UINT32 size, vector<UINT8> &out)
+{
+	UINT32 numBlocks = DIV_CEILING(size, LZ4_BLOCK_SIZE);
+	vector< vector<UINT8> > blocks(numBlocks);
+
+	RunParallel(numBlocks, LZ4_MIN_BLOCKS_PER_THREAD, [&](UINT32 firstBlock, UINT32 count)
+	{
+		vector<UINT8> compressed(LZ4_BlockBound(LZ4_BLOCK_SIZE));
+		for (UINT32 block = firstBlock; block < firstBlock + count; ++block)
+		{
+			const UINT8 *src = data + block * LZ4_BLOCK_SIZE;
+			UINT32 blockSize = MIN(LZ4_BLOCK_SIZE, size - block * LZ4_BLOCK_SIZE);
+			UINT32 compressedSize = LZ4_CompressBlock(src, blockSize, &compressed[0]);
+
+			// a block which does not compress is stored as is, marked by the high bit
+			if (compressedSize < blockSize)
+			{
+				CMP_Write32(blocks[block], compressedSize);
+				blocks[block].insert(blocks[block].end(), compressed.begin(), compressed.begin() + compressedSize);
+			}
+			else
+			{
+				CMP_Write32(blocks[block], blockSize | 0x80000000);
+				blocks[block].insert(blocks[block].end(), src, src + blockSize);
+			}
+		}
+	});
+
+	// frame descriptor: version 1, independent blocks, content size and content checksum, 64KB blocks
+	out.clear();
+	CMP_Write32(out, 0x184D2204);
+	out.push_back(0x6C);
+	out.push_back(0x40);
+	CMP_Write32(out, size);
+	CMP_Write32(out, 0);
+	out.push_back((UINT8) (CMP_XXH32(&out[4], (UINT32) out.size() - 4, 0) >> 8));
+
+	for (UINT32 block = 0; block < numBlocks; ++block)
+	{
+		out.insert(out.end(), blocks[block].begin(), blocks[block].end());
+	}
+	CMP_Write32(out, 0);
+	CMP_Write32(out, CMP_XXH32(data, size, 0));
+	return STS_OK;
+}
+
+
+UINT32 CMP_Compress( CMP_Type type, const UINT8 *data, UINT32 size, std::vector<UINT8> &out )
+{
+	if (type == CMP_lz4)
+	{
+		return LZ4_CompressFrame(data, size, out);
+	}
+
+	out.assign(data, data + size);
+	return STS_OK;
+}
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <vector>
+#include "bingo_types.h"
+
+
+// CMP=Compression
+typedef enum CMP_Type
+{
+	CMP_none,
+	CMP_lz4,		// LZ4 frame (independent 64KB blocks, content size and checksum)
+	CMP_NUM_OF_TYPES
+}CMP_Type;
+
+/*
+	Compresses the data into out. Large data is compressed by several threads, block by block.
+*/
+UINT32 CMP_Compress(CMP_Type type, const UINT8 *data, UINT32 size, std::vector<UINT8> &out);
+
+#endif // COMPRESS_H
@@ -0,0 +1,351 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include "diff.h"
+#include "errors.h"
+#include "error_correction.h"
+#include "utilities.h"
+
+using namespace std;
+
+// the images are compared in blocks of this size, only differing blocks are compared byte by byte
+const UINT32 DIFF_BLOCK_SIZE = 0x1000;
+
+// differing bytes listed for each field, the rest are only counted
+const UINT32 DIFF_MAX_LISTED = 16;
+
+typedef struct DIFF_Range
+{
+	UINT64	offset;
+	UINT64	size;
+}DIFF_Range;
+
+/*
+	The differences in one field, or in the padding between fields
+*/
+typedef struct DIFF_Report
+{
+	Field_BinField		*field;		// NULL for padding
+	UINT64				offset;		// of the field (encoded) or the padding
+	UINT64				size;
+	UINT64				numBytes;	// differing bytes
+	std::vector<UINT64>	listed;		// image offsets of the first differing bytes
+}DIFF_Report;
+
+
+static UINT32 DIFF_LoadImage( const string &fileName, vector<UINT8> &image )
+{
+	ifstream file(fileName.c_str(), ios::binary | ios::ate);
+	if (!file.is_open())
+	{
+		string errStr = "Filename: " + fileName;
+		ERR_PrintError(ERR_FILE_NOT_FOUND, errStr);
+		return ERR_FILE_NOT_FOUND;
+	}
+
+	streamoff size = file.tellg();
+	image.resize((size_t) size);
+	file.seekg(0);
+	if (size > 0)
+	{
+		file.read((char *)&image[0], size);
+	}
+	if (!file.good())
+	{
+		ERR_PrintError(ERR_FILE_ERROR, "Error reading file " + fileName);
+		return ERR_FILE_ERROR;
+	}
+	return STS_OK;
+}
+
+static string DIFF_Hex( UINT64 value, UINT32 width )
+{
+	stringstream str;
+	str << "0x" << hex << setfill('0') << setw(width) << value;
+	return str.str();
+}
+
+//************************************
+// Function:  DIFF_FindRanges - finds the ranges of differing bytes
+// Returns:   std::vector<DIFF_Range> - sorted by offset
+// Parameter: const UINT8 * a
+// Parameter: const UINT8 * b
+// Parameter: UINT64 size
+//************************************
+static vector<DIFF_Range> DIFF_FindRanges( const UINT8 *a, const UINT8 *b, UINT64 size )
+{
+	vector<DIFF_Range> ranges;
+
+	for (UINT64 block = 0; block < size; block += DIFF_BLOCK_SIZE)
+	{
+		UINT32 blockSize = (UINT32) MIN((UINT64) DIFF_BLOCK_SIZE, size - block);
+		if (memcmp(a + block, b + block, blockSize) == 0)
+		{
+			continue;
+		}
+
+		for (UINT64 i = block; i < block + blockSize; ++i)
+		{
+			if (a[i] == b[i])
+			{
+				continue;
+			}
+			if (!ranges.empty() && ranges.back().offset + ranges.back().size == i)
+			{
+				++ranges.back().size;
+			}
+			else
+			{
+				DIFF_Range range = {i, 1};
+				ranges.push_back(range);
+			}
+		}
+	}
+	return ranges;
+}
+
+static void DIFF_AddBytes( vector<DIFF_Report> &reports, Field_BinField *field, UINT64 regionOffset, UINT64 regionSize,
+						   UINT64 offset, UINT64 size )
+{
+	if (reports.empty() || reports.back().field != field || reports.back().offset != regionOffset)
+	{
+		DIFF_Report report;
+		report.field = field;
+		report.offset = regionOffset;
+		report.size = regionSize;
+		report.numBytes = 0;
+		reports.push_back(report);
+	}
+
+	DIFF_Report &report = reports.back();
+	report.numBytes += size;
+	for (UINT64 i = offset; i < offset + size && report.listed.size() < DIFF_MAX_LISTED; ++i)
+	{
+		report.listed.push_back(i);
+	}
+}
+
+//************************************
+// Function:  DIFF_Attribute - attributes the differing ranges to the fields, and to the padding between them
+// Returns:   std::vector<DIFF_Report> - sorted by offset
+// Parameter: std::vector<Field_BinField * > & fields - sorted by offset
+// Parameter: const std::vector<DIFF_Range> & ranges - sorted by offset
+// Parameter: UINT64 imageSize - of the larger image
+//************************************
+static vector<DIFF_Report> DIFF_Attribute( std::vector<Field_BinField *> &fields, const vector<DIFF_Range> &ranges, UINT64 imageSize )
+{
+	vector<DIFF_Report> reports;
+	size_t index = 0;
+
+	for (vector<DIFF_Range>::const_iterator it = ranges.begin(); it != ranges.end(); ++it)
+	{
+		UINT64 position = it->offset;
+		UINT64 end = it->offset + it->size;
+		while (position < end)
+		{
+			// skip the fields which end before the position
+			while (index < fields.size() &&
+				   fields[index]->offset + ECC_getTotalSize(fields[index]->size, fields[index]->eccType) <= position)
+			{
+				++index;
+			}
+
+			UINT64 stop;
+			if (index < fields.size() && fields[index]->offset <= position)
+			{
+				Field_BinField *field = fields[index];
+				UINT64 eccSize = ECC_getTotalSize(field->size, field->eccType);
+				stop = MIN(end, field->offset + eccSize);
+				DIFF_AddBytes(reports, field, field->offset, eccSize, position, stop - position);
+			}
+			else
+			{
+				UINT64 gapStart = (index == 0) ? 0 : fields[index - 1]->offset + ECC_getTotalSize(fields[index - 1]->size, fields[index - 1]->eccType);
+				UINT64 gapEnd = (index < fields.size()) ? fields[index]->offset : imageSize;
+				stop = MIN(end, gapEnd);
+				DIFF_AddBytes(reports, NULL, gapStart, gapEnd - gapStart, position, stop - position);
+			}
+			position = stop;
+		}
+	}
+	return reports;
+}
+
+//************************************
+// Function:  DIFF_DescribeBits - describes the differing bits of an image byte, by the field data they hold
+// Returns:   std::string
+// Parameter: Field_BinField * field
+// Parameter: UINT64 offset - of the byte in the image
+// Parameter: UINT8 bits - the differing bits
+//************************************
+static string DIFF_DescribeBits( Field_BinField *field, UINT64 offset, UINT8 bits )
+{
+	stringstream str;
+	const char *separator = "";
+
+	for (UINT32 bit = 0; bit < 8; ++bit)
+	{
+		if (!(bits & (1 << bit)))
+		{
+			continue;
+		}
+
+		UINT64 dataBit;
+		ECC_BitRole role = ECC_locateBit(field->eccType, field->size, (offset - field->offset) * 8 + bit, dataBit);
+		str << separator;
+		if (role == ECC_dataBit)
+		{
+			str << "byte " << dataBit / 8 << " bit " << dataBit % 8;
+		}
+		else if (role == ECC_checkBit)
+		{
+			str << "check bit of byte " << dataBit / 8;
+		}
+		else
+		{
+			str << "unused bit";
+		}
+		separator = ", ";
+	}
+	return str.str();
+}
+
+static void DIFF_PrintReport( const DIFF_Report &report, const vector<UINT8> &a, const vector<UINT8> &b )
+{
+	Field_BinField *field = report.field;
+
+	if (field)
+	{
+		cout << field->name << " (" << DIFF_Hex(report.offset, 8) << ", " << ECC_getName(field->eccType) << "): ";
+	}
+	else
+	{
+		cout << "padding " << DIFF_Hex(report.offset, 8) << "-" << DIFF_Hex(report.offset + report.size, 8) << ": ";
+	}
+	cout << report.numBytes << " byte(s) differ" << endl;
+
+	for (vector<UINT64>::const_iterator it = report.listed.begin(); it != report.listed.end(); ++it)
+	{
+		UINT8 valueA = (*it < a.size()) ? a[*it] : 0;
+		UINT8 valueB = (*it < b.size()) ? b[*it] : 0;
+		cout << "\t" << DIFF_Hex(*it, 8) << ": ";
+		if (*it >= a.size() || *it >= b.size())
+		{
+			cout << "only in " << ((*it < a.size()) ? "the first" : "the second") << " image" << endl;
+			continue;
+		}
+		cout << DIFF_Hex(valueA, 2) << " -> " << DIFF_Hex(valueB, 2);
+		if (field)
+		{
+			cout << ", " << DIFF_DescribeBits(field, *it, valueA ^ valueB);
+		}
+		cout << endl;
+	}
+	if (report.numBytes > report.listed.size())
+	{
+		cout << "\t... and " << report.numBytes - report.listed.size() << " more" << endl;
+	}
+
+	// the field content, as the ECC decoder sees it
+	if (field && field->eccType != ECC_noECC && report.offset + report.size <= MIN(a.size(), b.size()))
+	{
+		vector<UINT8> decodedA(MAX(field->size, (UINT64) 1));
+		vector<UINT8> decodedB(MAX(field->size, (UINT64) 1));
+		ECC_decode(field->eccType, &a[report.offset], &decodedA[0], (UINT32) field->size);
+		ECC_decode(field->eccType, &b[report.offset], &decodedB[0], (UINT32) field->size);
+
+		UINT64 numDecoded = 0;
+		for (UINT64 i = 0; i < field->size; ++i)
+		{
+			if (decodedA[i] == decodedB[i])
+			{
+				continue;
+			}
+			if (numDecoded < DIFF_MAX_LISTED)
+			{
+				cout << "\tdecoded byte " << i << ": " << DIFF_Hex(decodedA[i], 2) << " -> " << DIFF_Hex(decodedB[i], 2) << endl;
+			}
+			++numDecoded;
+		}
+		if (numDecoded > DIFF_MAX_LISTED)
+		{
+			cout << "\t... and " << numDecoded - DIFF_MAX_LISTED << " more decoded bytes" << endl;
+		}
+		else if (numDecoded == 0)
+		{
+			cout << "\tthe decoded content is the same" << endl;
+		}
+	}
+}
+
+UINT32 DIFF_CompareImages( std::vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig,
+						   const std::string &imageFileA, const std::string &imageFileB, bool &identical )
+{
+	UINT32 err;
+	vector<UINT8> a;
+	vector<UINT8> b;
+
+	err = DIFF_LoadImage(imageFileA, a);
+	if (err)
+	{
+		return err;
+	}
+	err = DIFF_LoadImage(imageFileB, b);
+	if (err)
+	{
+		return err;
+	}
+
+	UINT64 commonSize = MIN(a.size(), b.size());
+	vector<DIFF_Range> ranges = (commonSize == 0) ? vector<DIFF_Range>() : DIFF_FindRanges(&a[0], &b[0], commonSize);
+
+	// the tail of the larger image differs as a whole
+	if (a.size() != b.size())
+	{
+		DIFF_Range tail = {commonSize, MAX(a.size(), b.size()) - commonSize};
+		ranges.push_back(tail);
+	}
+
+	identical = ranges.empty();
+	if (identical)
+	{
+		cout << "The images are identical" << endl;
+		return STS_OK;
+	}
+
+	if (a.size() != b.size())
+	{
+		cout << "Image sizes differ: " << a.size() << ", " << b.size() << endl;
+	}
+	if (a.size() != imageConfig.size || b.size() != imageConfig.size)
+	{
+		cout << "Warning: the layout image size is " << imageConfig.size << endl;
+	}
+
+	vector<DIFF_Report> reports = DIFF_Attribute(fields, ranges, MAX(a.size(), b.size()));
+	UINT64 numBytes = 0;
+	for (vector<DIFF_Report>::const_iterator it = reports.begin(); it != reports.end(); ++it)
+	{
+		DIFF_PrintReport(*it, a, b);
+		numBytes += it->numBytes;
+	}
+	cout << endl << numBytes << " byte(s) differ, in " << reports.size() << " field(s) and padding area(s)" << endl;
+
+	return STS_OK;
+}
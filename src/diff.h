@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#ifndef DIFF_H
+#define DIFF_H
+
+#include <string>
+#include <vector>
+#include "fields.h"
+#include "bingo_types.h"
+
+
+// DIFF=Field aware image compare
+
+/*
+	Compares two images built from the given fields (sorted and validated), and reports every difference
+	by the field it is in. Bits of ECC encoded fields are located in the field data, and the fields are
+	also compared decoded.
+	identical is set if the images are the same.
+*/
+UINT32 DIFF_CompareImages(std::vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig,
+						  const std::string &imageFileA, const std::string &imageFileB, bool &identical);
+
+#endif // DIFF_H
@@ -22,35 +22,11 @@ using namespace std;
 #define STR_SIZE 256
 
 // private functions for the ECC scope
-UINT32 ECC_encodeMajorityRule(UINT8 *dataIn, UINT8 *dataOut, UINT32 size);
-UINT32 ECC_encodeNibbleParity(UINT8 *dataIn, UINT8 *dataOut, UINT32 size);
-UINT32 ECC_encode_SECDED_Parity(UINT8 *dataIn, UINT8 *dataOut, UINT32 size);
-UINT32 ECC_encodeMajorityRule_10Bit(UINT8 *dataIn, UINT8 *dataOut, UINT32 size);
+UINT32 ECC_encodeNibbleParity(const UINT8 *dataIn, UINT8 *dataOut, UINT32 size);
+UINT32 ECC_encodeMajorityRule_10Bit(const UINT8 *dataIn, UINT8 *dataOut, UINT32 size);
 
 
-UINT32 ECC_encodeMajorityRule( UINT8 *dataIn, UINT8 *dataOut, UINT32 size )
-{
-	UINT32 err;
-	UINT32 dataInSize = size / 3;
-	// make sure given encoded buffer size is proper
-	if (size % 3)
-	{
-		err = ERR_ECC_ERROR;
-		string errStr = "Size not proper for Majority Rule ECC";
-		ERR_PrintError(err, errStr);
-		return err;
-	}
-
-	// copy two copies of dataIn into dataOut
-	memcpy(&dataOut[0], dataIn, dataInSize);
-	memcpy(&dataOut[dataInSize], dataIn, dataInSize);
-	memcpy(&dataOut[dataInSize * 2], dataIn, dataInSize);
-
-	// fill the rest of the buffer with zeros, in order to avoid false decoding
-	return STS_OK;
-}
-
-UINT32 ECC_encodeMajorityRule_10Bit( UINT8 *dataIn, UINT8 *dataOut, UINT32 size )
+UINT32 ECC_encodeMajorityRule_10Bit( const UINT8 *dataIn, UINT8 *dataOut, UINT32 size )
 {
 	UINT32 err;
 	// check that size is OK for 10 bits majority rule
@@ -92,34 +68,46 @@ UINT32 ECC_encodeMajorityRule_10Bit( UINT8 *dataIn, UINT8 *dataOut, UINT32 size
 	return STS_OK;
 }
 
-UINT32 ECC_encodeMaskNibbleParity(UINT8 *dataIn, UINT8 *dataOut, UINT32 size)
+//************************************
+// Function:  ECC_encodeMaskNibbleParity - encodes a chunk of a nibble parity mask: the mask is a single byte
+//			  (0x00/0xff), it is taken by every encoded byte
+// Returns:   UINT32 status according to errors.h
+// Parameter: ECC_Encoder & encoder - holds the mask byte, taken from the first chunk
+// Parameter: const UINT8 * dataIn - input data chunk
+// Parameter: UINT8 * dataOut - output buffer, twice the chunk size
+// Parameter: UINT32 size - size of the input data chunk
+//************************************
+static UINT32 ECC_encodeMaskNibbleParity(ECC_Encoder &encoder, const UINT8 *dataIn, UINT8 *dataOut, UINT32 size)
 {	
 	UINT32	i;
-	if (dataIn[0] != 0xff && dataIn[0] != 0x0) {	
-		char str[STR_SIZE];
-		snprintf(str, STR_SIZE, "in nibble parity, field value should be 0xff or 0x00, but it is 0x%02x\n", dataIn[0]);
-		ERR_PrintError(ERR_ILLEGAL_VAL, str);
-		return ERR_ILLEGAL_VAL; //exit(1);
+	if (encoder.position == 0 && size > 0)
+	{
+		if (dataIn[0] != 0xff && dataIn[0] != 0x0) {	
+			char str[STR_SIZE];
+			snprintf(str, STR_SIZE, "in nibble parity, field value should be 0xff or 0x00, but it is 0x%02x\n", dataIn[0]);
+			ERR_PrintError(ERR_ILLEGAL_VAL, str);
+			return ERR_ILLEGAL_VAL; //exit(1);
+		}
+		encoder.first = dataIn[0];
 	}
 	
 	for (i = 0; i < size; ++i)
 	{
-		if (i >= 1 && i < size/2)
-		{
-			if ((dataIn[i] != 0xff && dataIn[i] != 0x0) || (dataIn[i] != dataIn[0] && dataIn[i] != 0x0)  ) {
-				char str[STR_SIZE];
-				snprintf(str, STR_SIZE, "in nibble parity there shouldn't be more than 1 byte mask (0x00/0xff) but byte %d contains 0x%02x\n", i, dataIn[i]);
-				ERR_PrintError(ERR_ILLEGAL_VAL, str);
-				return ERR_ILLEGAL_VAL; //exit(1);
-			}
+		if ((dataIn[i] != 0xff && dataIn[i] != 0x0) || (dataIn[i] != encoder.first && dataIn[i] != 0x0)  ) {
+			char str[STR_SIZE];
+			snprintf(str, STR_SIZE, "in nibble parity there shouldn't be more than 1 byte mask (0x00/0xff) but byte %llu contains 0x%02x\n",
+					 encoder.position + i, dataIn[i]);
+			ERR_PrintError(ERR_ILLEGAL_VAL, str);
+			return ERR_ILLEGAL_VAL; //exit(1);
 		}
-		dataOut[i] = (dataIn[0]);
+		dataOut[2 * i] = encoder.first;
+		dataOut[2 * i + 1] = encoder.first;
 	}
 	return STS_OK;
 }
 
 
-UINT32 ECC_encodeNibbleParity( UINT8 *dataIn, UINT8 *dataOut, UINT32 size )
+UINT32 ECC_encodeNibbleParity( const UINT8 *dataIn, UINT8 *dataOut, UINT32 size )
 {
 	UINT8	nibble, encData;
 	UINT32	encIndex;
@@ -172,7 +160,7 @@ UINT32 ECC_encodeNibbleParity( UINT8 *dataIn, UINT8 *dataOut, UINT32 size )
 //                  Calc the CRC according to hamming. CRC lower bit is the R1 (location 1), etc
 //                  MSb is the parity (nidded for double error detection.  )
 //************************************
-static UINT8 FUSE_get_CRC(UINT8 *datain, UINT32 size)
+static UINT8 FUSE_get_CRC(const UINT8 *datain, UINT32 size)
 {
 	int i;
 	UINT8 CRC; // hamming code, 7 bits
@@ -184,7 +172,6 @@ static UINT8 FUSE_get_CRC(UINT8 *datain, UINT32 size)
 	UINT8 R32;
 	UINT8 R64;
 	UINT8 parity = 0;
-	UINT8 *arr = datain;
 
 #define BIT_A(n)  (READ_VAR_BIT(datain[(n-1)>>3], ((n-1) % 8)))
 
@@ -251,78 +238,276 @@ static UINT8 FUSE_get_CRC(UINT8 *datain, UINT32 size)
 }
 
 //************************************
-// Function:  ECC_encode_SECDED_Parity - execute ECC SECDED (hamming code). Add one byte of CRC for each 8 bytes.
-//            Note: all CRCs are gathered at the end of the array.
-// Returns:   UINT32 status according to errors.h
-// Parameter: UINT8 * dataIn - input data buffer
-// Parameter: UINT8 * dataOut - output data buffer
-// Parameter: UINT32 size - size of the encoded data buffer
+// Function:  ECC_encode_SECDED_Parity - execute ECC SECDED (hamming code) over a chunk. Add one byte of CRC for each 8 bytes.
+//            Note: all CRCs are gathered at the end of the field, they are kept by the encoder until ECC_encodeFinish.
+// Returns:   void
+// Parameter: ECC_Encoder & encoder
+// Parameter: const UINT8 * dataIn - input data chunk
+// Parameter: UINT8 * dataOut - output buffer, of the chunk size
+// Parameter: UINT32 size - size of the input data chunk
 //************************************
-UINT32 ECC_encode_SECDED_Parity(UINT8 *dataIn, UINT8 *dataOut, UINT32 size)
+static void ECC_encode_SECDED_Parity(ECC_Encoder &encoder, const UINT8 *dataIn, UINT8 *dataOut, UINT32 size)
 {
-	UINT32 i = 0;
-	UINT8 CRC; // hamming code, 7 bits + parity
-	UINT8 *arr = dataIn;
 	UINT32 cnt = 0;
 
-	UINT32 encoded_size = DIV_CEILING(8 * size, 9);
-
-	memcpy(dataOut, dataIn, encoded_size);
+	memcpy(dataOut, dataIn, size);
 
-	for (cnt = 0; cnt < encoded_size; cnt += 8)
+	while (cnt < size)
 	{
-
 		// each 64 bits (8 bytes) get a CRC byte at the end of the array
-		arr = dataIn + cnt;
-		CRC = FUSE_get_CRC(arr, MIN(encoded_size - cnt, 8));
-		dataOut[encoded_size + i++] = CRC;
+		if (encoder.groupSize == 0 && size - cnt >= sizeof(encoder.group))
+		{
+			encoder.checkBytes.push_back(FUSE_get_CRC(dataIn + cnt, sizeof(encoder.group)));
+			cnt += sizeof(encoder.group);
+			continue;
+		}
+
+		// a group split between chunks
+		encoder.group[encoder.groupSize++] = dataIn[cnt++];
+		if (encoder.groupSize == sizeof(encoder.group))
+		{
+			encoder.checkBytes.push_back(FUSE_get_CRC(encoder.group, sizeof(encoder.group)));
+			encoder.groupSize = 0;
+		}
 	}
+}
 
-	return STS_OK;
+void ECC_encodeInit(ECC_Encoder &encoder, ECC_Type type, UINT64 size)
+{
+	encoder.type = type;
+	encoder.size = size;
+	encoder.position = 0;
+	encoder.first = 0;
+	encoder.groupSize = 0;
+	memset(encoder.group, 0, sizeof(encoder.group));
+	encoder.checkBytes.clear();
+	if (type == ECC_SECDED)
+	{
+		encoder.checkBytes.reserve((size_t) DIV_CEILING(size, sizeof(encoder.group)));
+	}
+}
+
+UINT32 ECC_encodePasses(ECC_Type type)
+{
+	// majority rule: three copies of the data, one after the other
+	return (type == ECC_majorityRule) ? 3 : 1;
 }
 
 //************************************
-// Function:  ECC_performECC - dispatcher for the differnt ECC schemes
+// Function:  ECC_encodeChunk - encodes the next chunk of the field data
 // Returns:   UINT32 status according to errors.h
-// Parameter: ECC_Type type
-// Parameter: UINT8 * dataIn - input data buffer
-// Parameter: UINT8 * dataOut - output data buffer
-// Parameter: UINT32 size - size of the encoded data buffer
+// Parameter: ECC_Encoder & encoder
+// Parameter: const UINT8 * dataIn - input data chunk
+// Parameter: UINT32 size - size of the input data chunk
+// Parameter: UINT8 * dataOut - output buffer, of ECC_MAX_CHUNK_EXPANSION times the chunk size
+// Parameter: UINT32 & outSize - the encoded bytes written to dataOut
 //************************************
-UINT32 ECC_performECC(ECC_Type type, UINT8 *dataIn, UINT8 *dataOut, UINT32 size, UINT32 offset)
+UINT32 ECC_encodeChunk(ECC_Encoder &encoder, const UINT8 *dataIn, UINT32 size, UINT8 *dataOut, UINT32 &outSize)
 {
-	UINT32 status;
-	if (type == ECC_noECC)
+	UINT32 status = STS_OK;
+
+	outSize = size;
+	switch (encoder.type)
 	{
+	case ECC_noECC:
+	case ECC_majorityRule:
 		memcpy(dataOut, dataIn, size);
-		status = STS_OK;
+		break;
+	case ECC_nibbleParity:
+		outSize = 2 * size;
+		status = ECC_encodeNibbleParity(dataIn, dataOut, outSize);
+		break;
+	case ECC_Mask_nibbleParity:
+		outSize = 2 * size;
+		status = ECC_encodeMaskNibbleParity(encoder, dataIn, dataOut, size);
+		break;
+	case ECC_10BitsMajorityRule:
+		// the data is encoded as a whole, by ECC_encodeFinish
+		outSize = 0;
+		for (UINT32 i = 0; i < size && encoder.groupSize < sizeof(encoder.group); ++i)
+		{
+			encoder.group[encoder.groupSize++] = dataIn[i];
+		}
+		break;
+	case ECC_SECDED:
+		ECC_encode_SECDED_Parity(encoder, dataIn, dataOut, size);
+		break;
+	default:
+		status = ERR_NOT_IMPLEMENTED;
+		ERR_PrintError(status, "requested ECC scheme is not implemented\n");
+		break;
 	}
-	else if (type == ECC_Mask_nibbleParity)
+
+	encoder.position += size;
+	return status;
+}
+
+//************************************
+// Function:  ECC_encodeFinish - completes the encoding, gives the encoded bytes which follow the encoded chunks
+// Returns:   UINT32 status according to errors.h
+// Parameter: ECC_Encoder & encoder
+// Parameter: std::vector<UINT8> & dataOut - SECDED: the check bytes, 10 bits majority: the encoded field
+//************************************
+UINT32 ECC_encodeFinish(ECC_Encoder &encoder, std::vector<UINT8> &dataOut)
+{
+	dataOut.clear();
+	if (encoder.type == ECC_SECDED)
 	{
-		status = ECC_encodeMaskNibbleParity(dataIn, dataOut, size);
+		// the last group may be partial: the check bytes then start one byte after the data (a zero byte
+		// between them), as in the original layout, which leaves no room for the check byte of that group
+		if (encoder.groupSize)
+		{
+			encoder.checkBytes.insert(encoder.checkBytes.begin(), 0);
+			encoder.groupSize = 0;
+		}
+		dataOut.swap(encoder.checkBytes);
 	}
-	else if (type == ECC_nibbleParity)
+	else if (encoder.type == ECC_10BitsMajorityRule)
 	{
-		status = ECC_encodeNibbleParity(dataIn, dataOut, size);
+		dataOut.resize((size_t) ECC_getTotalSize(encoder.size, encoder.type));
+		return ECC_encodeMajorityRule_10Bit(encoder.group, dataOut.empty() ? NULL : &dataOut[0], (UINT32) dataOut.size());
 	}
-	else if (type == ECC_majorityRule)
+	return STS_OK;
+}
+
+//************************************
+// Function:  ECC_performECC - encodes a whole field, which is held in memory
+// Returns:   UINT32 status according to errors.h
+// Parameter: ECC_Type type
+// Parameter: const UINT8 * dataIn - input data buffer
+// Parameter: UINT8 * dataOut - output data buffer, of ECC_getTotalSize
+// Parameter: UINT32 size - size of the input data buffer (before ECC)
+//************************************
+UINT32 ECC_performECC(ECC_Type type, const UINT8 *dataIn, UINT8 *dataOut, UINT32 size)
+{
+	UINT32 status = STS_OK;
+	UINT32 outSize;
+	ECC_Encoder encoder;
+	vector<UINT8> tail;
+
+	ECC_encodeInit(encoder, type, size);
+	for (UINT32 pass = 0; pass < ECC_encodePasses(type) && status == STS_OK; ++pass)
 	{
-		status = ECC_encodeMajorityRule(dataIn, dataOut, size);
+		status = ECC_encodeChunk(encoder, dataIn, size, dataOut, outSize);
+		dataOut += outSize;
 	}
-	else if (type == ECC_10BitsMajorityRule)
+	if (status == STS_OK)
 	{
-		status = ECC_encodeMajorityRule_10Bit(dataIn, dataOut, size);
+		status = ECC_encodeFinish(encoder, tail);
 	}
-	else if (type == ECC_SECDED)
+	if (status == STS_OK && !tail.empty())
 	{
-		status = ECC_encode_SECDED_Parity(dataIn, dataOut, size);
+		memcpy(dataOut, &tail[0], tail.size());
 	}
-	else
+	return status;
+}
+
+std::string ECC_getName(ECC_Type type)
+{
+	switch (type)
 	{
-		status = ERR_NOT_IMPLEMENTED;
-		ERR_PrintError(status, "requested ECC scheme is not implemented\n");
+	case ECC_noECC:
+		return "none";
+	case ECC_nibbleParity:
+	case ECC_Mask_nibbleParity:
+		return "nibble";
+	case ECC_majorityRule:
+		return "majority";
+	case ECC_10BitsMajorityRule:
+		return "10_bits_majority";
+	case ECC_SECDED:
+		return "secded";
+	}
+	return "unknown";
+}
+
+ECC_BitRole ECC_locateBit(ECC_Type type, UINT64 size, UINT64 encodedBit, UINT64 &dataBit)
+{
+	UINT64 encodedByte = encodedBit / 8;
+	UINT32 bit = (UINT32) (encodedBit % 8);
+
+	switch (type)
+	{
+	case ECC_nibbleParity:
+	case ECC_Mask_nibbleParity:
+		// each encoded byte holds one nibble in its lower half, and the nibble parity in its upper half
+		dataBit = (encodedByte / 2) * 8 + (encodedByte & 1) * 4;
+		if (bit >= 4)
+		{
+			return ECC_checkBit;
+		}
+		dataBit += bit;
+		return ECC_dataBit;
+	case ECC_majorityRule:
+		dataBit = (size == 0) ? 0 : encodedBit % (size * 8);
+		return ECC_dataBit;
+	case ECC_10BitsMajorityRule:
+		// three copies of 10 bits, in a little endian 32 bit word
+		dataBit = encodedBit % 10;
+		return (encodedBit < 30) ? ECC_dataBit : ECC_unusedBit;
+	case ECC_SECDED:
+		// the CRC bytes are gathered after the data, one for every 8 bytes (a zero byte before them,
+		// when the last 8 bytes are partial)
+		if (encodedByte < size)
+		{
+			dataBit = encodedBit;
+			return ECC_dataBit;
+		}
+		if (size % 8 != 0)
+		{
+			if (encodedByte == size)
+			{
+				dataBit = size * 8;
+				return ECC_unusedBit;
+			}
+			--encodedByte;
+		}
+		dataBit = (encodedByte - size) * 64;
+		return ECC_checkBit;
+	default:
+		dataBit = encodedBit;
+		return ECC_dataBit;
 	}
-	return status;
 }
 
+void ECC_decode(ECC_Type type, const UINT8 *dataIn, UINT8 *dataOut, UINT32 size)
+{
+	UINT32 i;
 
+	switch (type)
+	{
+	case ECC_nibbleParity:
+	case ECC_Mask_nibbleParity:
+		for (i = 0; i < size; ++i)
+		{
+			dataOut[i] = (UINT8) ((dataIn[2 * i] & 0x0F) | ((dataIn[2 * i + 1] & 0x0F) << 4));
+		}
+		break;
+	case ECC_majorityRule:
+		for (i = 0; i < size; ++i)
+		{
+			UINT8 a = dataIn[i], b = dataIn[size + i], c = dataIn[2 * size + i];
+			dataOut[i] = (UINT8) ((a & b) | (a & c) | (b & c));
+		}
+		break;
+	case ECC_10BitsMajorityRule:
+	{
+		UINT32 encoded = dataIn[0] | (dataIn[1] << 8) | (dataIn[2] << 16) | ((UINT32) dataIn[3] << 24);
+		UINT32 a = READ_VAR_FIELD(encoded, LOWER_10_F);
+		UINT32 b = READ_VAR_FIELD(encoded, MIDDLE_10_F);
+		UINT32 c = READ_VAR_FIELD(encoded, UPPER_10_F);
+		UINT32 decoded = (a & b) | (a & c) | (b & c);
+		memset(dataOut, 0, size);
+		dataOut[0] = (UINT8) decoded;
+		if (size > 1)
+		{
+			dataOut[1] = (UINT8) (decoded >> 8);
+		}
+		break;
+	}
+	default:
+		// no ECC, and SECDED, keep the data as is
+		memcpy(dataOut, dataIn, size);
+		break;
+	}
+}
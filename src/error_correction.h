@@ -15,6 +15,7 @@
 #ifndef ERROR_CORRECTION_H
 #define ERROR_CORRECTION_H
 
+#include <vector>
 #include "utilities.h"
 #include "bingo_types.h"
 
@@ -30,7 +31,7 @@ typedef enum ECC_Type
 	ECC_Mask_nibbleParity
 }ECC_Type;
 
-inline UINT32 ECC_getTotalSize(UINT32 size, ECC_Type ecc)
+inline UINT64 ECC_getTotalSize(UINT64 size, ECC_Type ecc)
 {
 	if (ecc == ECC_noECC)
 	{
@@ -57,5 +58,48 @@ inline UINT32 ECC_getTotalSize(UINT32 size, ECC_Type ecc)
 }
 
 
-UINT32 ECC_performECC(ECC_Type type, UINT8 *dataIn, UINT8 *dataOut, UINT32 size, UINT32 offset);
+// Encodes a whole field (size - before ECC), dataOut takes ECC_getTotalSize bytes
+UINT32 ECC_performECC(ECC_Type type, const UINT8 *dataIn, UINT8 *dataOut, UINT32 size);
+
+/*
+	Streaming encoder, for a field which is not held in memory as a whole: ECC_encodeInit, then the field
+	data is given to ECC_encodeChunk in order, ECC_encodePasses times over (majority rule writes three copies),
+	then ECC_encodeFinish gives the encoded bytes which follow the data (the SECDED check bytes).
+	The encoded field is produced in order, chunk by chunk.
+*/
+typedef struct ECC_Encoder
+{
+	ECC_Type			type;
+	UINT64				size;			// of the field data, before ECC
+	UINT64				position;		// data bytes given so far
+	UINT8				first;			// mask nibble parity: the mask byte
+	UINT8				group[8];		// SECDED: data bytes which do not have a check byte yet, 10 bits majority: the data
+	UINT32				groupSize;
+	std::vector<UINT8>	checkBytes;		// SECDED: one for each 8 data bytes, written after the data
+}ECC_Encoder;
+
+// an encoded chunk is at most this many times the size of the data chunk
+const UINT32 ECC_MAX_CHUNK_EXPANSION = 2;
+
+void ECC_encodeInit(ECC_Encoder &encoder, ECC_Type type, UINT64 size);
+UINT32 ECC_encodePasses(ECC_Type type);
+UINT32 ECC_encodeChunk(ECC_Encoder &encoder, const UINT8 *dataIn, UINT32 size, UINT8 *dataOut, UINT32 &outSize);
+UINT32 ECC_encodeFinish(ECC_Encoder &encoder, std::vector<UINT8> &dataOut);
+
+// the name of the ECC scheme, as configured in the XML
+std::string ECC_getName(ECC_Type type);
+
+typedef enum ECC_BitRole
+{
+	ECC_dataBit = 0,	// a data bit, or a copy of it
+	ECC_checkBit,		// parity/CRC of data bits
+	ECC_unusedBit
+}ECC_BitRole;
+
+// Locates the data bit held by a bit of the encoded field (size - before ECC).
+// For a check bit, dataBit is the first data bit it protects.
+ECC_BitRole ECC_locateBit(ECC_Type type, UINT64 size, UINT64 encodedBit, UINT64 &dataBit);
+
+// Decodes an encoded field (size - before ECC). Errors are not corrected, but the majority schemes take the majority.
+void ECC_decode(ECC_Type type, const UINT8 *dataIn, UINT8 *dataOut, UINT32 size);
 #endif // ERROR_CORRECTION_H
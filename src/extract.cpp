@@ -0,0 +1,298 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cctype>
+#include <map>
+#include <algorithm>
+#include <errno.h>
+#include "extract.h"
+#include "errors.h"
+#include "error_correction.h"
+#include "utilities.h"
+
+#ifdef __LINUX_APP__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#else
+#include <direct.h>
+#endif
+
+using namespace std;
+
+// no-ECC fields which are not copied by the kernel are copied through a buffer of this size
+const UINT32 EXT_COPY_CHUNK = 0x100000;
+
+/*
+	The image the fields are extracted from, shared by the extraction threads
+*/
+typedef struct EXT_Image
+{
+	std::string	fileName;
+	UINT64		size;
+#ifdef __LINUX_APP__
+	int			fd;			// read with pread, so the threads do not share a file position
+#endif
+}EXT_Image;
+
+
+static UINT32 EXT_OpenImage( const string &fileName, EXT_Image &image )
+{
+	image.fileName = fileName;
+#ifdef __LINUX_APP__
+	struct stat fileStat;
+	image.fd = open(fileName.c_str(), O_RDONLY);
+	if (image.fd < 0 || fstat(image.fd, &fileStat) != 0)
+	{
+		string errStr = "Filename: " + fileName;
+		ERR_PrintError(ERR_FILE_NOT_FOUND, errStr);
+		return ERR_FILE_NOT_FOUND;
+	}
+	image.size = (UINT64) fileStat.st_size;
+	return STS_OK;
+#else
+	return getFileSize(fileName.c_str(), image.size);
+#endif
+}
+
+static void EXT_CloseImage( EXT_Image &image )
+{
+#ifdef __LINUX_APP__
+	if (image.fd >= 0)
+	{
+		close(image.fd);
+	}
+#endif
+}
+
+static UINT32 EXT_ReadRange( const EXT_Image &image, UINT64 offset, UINT8 *data, UINT64 size )
+{
+#ifdef __LINUX_APP__
+	while (size > 0)
+	{
+		ssize_t bytesRead = pread(image.fd, data, size, offset);
+		if (bytesRead <= 0)
+		{
+			return ERR_FILE_ERROR;
+		}
+		data += bytesRead;
+		offset += (UINT64) bytesRead;
+		size -= (UINT64) bytesRead;
+	}
+	return STS_OK;
+#else
+	ifstream file(image.fileName.c_str(), ios::binary);
+	file.seekg(offset);
+	file.read((char *) data, size);
+	return file.good() ? STS_OK : ERR_FILE_ERROR;
+#endif
+}
+
+static UINT32 EXT_WriteFile( const string &path, const UINT8 *data, UINT64 size )
+{
+	ofstream file(path.c_str(), ios::binary);
+	if (!file.is_open())
+	{
+		return ERR_OUTPUT_FILE;
+	}
+	if (size > 0)
+	{
+		file.write((const char *) data, size);
+	}
+	return file.good() ? STS_OK : ERR_FILE_ERROR;
+}
+
+//************************************
+// Function:  EXT_CopyRange - copies a range of the image to a file, without passing it through
+//							  user space when the kernel supports it (copy_file_range)
+// Returns:   UINT32
+// Parameter: const EXT_Image & image
+// Parameter: UINT64 offset
+// Parameter: UINT64 size
+// Parameter: const string & path
+//************************************
+static UINT32 EXT_CopyRange( const EXT_Image &image, UINT64 offset, UINT64 size, const string &path )
+{
+#ifdef __LINUX_APP__
+	UINT32 err = STS_OK;
+	int outFd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (outFd < 0)
+	{
+		return ERR_OUTPUT_FILE;
+	}
+
+	loff_t inOffset = offset;
+	while (size > 0)
+	{
+		ssize_t copied = copy_file_range(image.fd, &inOffset, outFd, NULL, size, 0);
+		if (copied <= 0)
+		{
+			break; // not supported between these files, the rest is copied below
+		}
+		size -= (UINT64) copied;
+	}
+
+	vector<UINT8> buffer(size > 0 ? MIN(size, (UINT64) EXT_COPY_CHUNK) : 0);
+	while (size > 0 && err == STS_OK)
+	{
+		UINT32 chunk = (UINT32) MIN(size, (UINT64) EXT_COPY_CHUNK);
+		err = EXT_ReadRange(image, (UINT64) inOffset, &buffer[0], chunk);
+		if (err == STS_OK && write(outFd, &buffer[0], chunk) != (ssize_t) chunk)
+		{
+			err = ERR_FILE_ERROR;
+		}
+		inOffset += chunk;
+		size -= chunk;
+	}
+
+	if (close(outFd) != 0 && err == STS_OK)
+	{
+		err = ERR_FILE_ERROR;
+	}
+	return err;
+#else
+	vector<UINT8> data(MAX(size, (UINT64) 1));
+	UINT32 err = EXT_ReadRange(image, offset, &data[0], size);
+	return err ? err : EXT_WriteFile(path, &data[0], size);
+#endif
+}
+
+//************************************
+// Function:  EXT_GetFileName - the field name, as a file name
+// Returns:   std::string
+// Parameter: const string & name
+//************************************
+static string EXT_GetFileName( const string &name )
+{
+	string fileName = name.empty() ? "unnamed" : name;
+	for (string::iterator c = fileName.begin(); c != fileName.end(); ++c)
+	{
+		if (!isalnum((unsigned char) *c) && *c != '-' && *c != '_' && *c != '.')
+		{
+			*c = '_';
+		}
+	}
+	return fileName + ".bin";
+}
+
+static UINT32 EXT_ExtractField( const EXT_Image &image, Field_BinField *field, const string &path )
+{
+	UINT32 err;
+	UINT64 eccSize = ECC_getTotalSize(field->size, field->eccType);
+
+	if (field->offset + eccSize > image.size)
+	{
+		return ERR_BAD_IMAGE_SIZE;
+	}
+
+	if (field->eccType == ECC_noECC && !field->isReversed)
+	{
+		return EXT_CopyRange(image, field->offset, field->size, path);
+	}
+
+	vector<UINT8> encoded(MAX(eccSize, (UINT64) 1));
+	vector<UINT8> decoded(MAX(field->size, (UINT64) 1));
+	err = EXT_ReadRange(image, field->offset, &encoded[0], eccSize);
+	if (err)
+	{
+		return err;
+	}
+	if (field->eccType == ECC_noECC)
+	{
+		decoded.swap(encoded);
+	}
+	else
+	{
+		ECC_decode(field->eccType, &encoded[0], &decoded[0], (UINT32) field->size);
+	}
+
+	// the file is written as it was given, so it builds the same image again
+	if (field->isReversed)
+	{
+		reverse(decoded.begin(), decoded.begin() + (size_t) field->size);
+	}
+	return EXT_WriteFile(path, &decoded[0], field->size);
+}
+
+UINT32 EXT_ExtractFields( std::vector<Field_BinField *> &fields, const std::string &imageFile, const std::string &outDir )
+{
+	UINT32 err;
+	EXT_Image image;
+
+#ifdef __LINUX_APP__
+	if (mkdir(outDir.c_str(), 0755) != 0 && errno != EEXIST)
+#else
+	if (_mkdir(outDir.c_str()) != 0 && errno != EEXIST)
+#endif
+	{
+		err = ERR_OUTPUT_FILE;
+		ERR_PrintError(err, "Error creating directory " + outDir);
+		return err;
+	}
+
+	err = EXT_OpenImage(imageFile, image);
+	if (err)
+	{
+		EXT_CloseImage(image);
+		return err;
+	}
+
+	// the fields are independent, each thread extracts a range of them. Two fields extracted
+	// to the same file (the same name, or names which differ only in replaced characters) would race
+	vector<UINT32> results(fields.size(), STS_OK);
+	vector<string> paths(fields.size());
+	map<string, string> extractedNames;
+	for (UINT32 i = 0; i < fields.size(); ++i)
+	{
+		paths[i] = outDir + "/" + EXT_GetFileName(fields[i]->name);
+		map<string, string>::iterator found = extractedNames.find(paths[i]);
+		if (found != extractedNames.end())
+		{
+			err = ERR_AMBIGUITY;
+			ERR_PrintError(err, "fields " + found->second + " and " + fields[i]->name + " are both extracted to " + paths[i]);
+			EXT_CloseImage(image);
+			return err;
+		}
+		extractedNames[paths[i]] = fields[i]->name;
+	}
+	RunParallel((UINT32) fields.size(), 1, [&](UINT32 first, UINT32 count)
+	{
+		for (UINT32 i = first; i < first + count; ++i)
+		{
+			results[i] = EXT_ExtractField(image, fields[i], paths[i]);
+		}
+	});
+	EXT_CloseImage(image);
+
+	for (UINT32 i = 0; i < fields.size(); ++i)
+	{
+		if (results[i])
+		{
+			ERR_PrintError(results[i], "Error extracting field " + fields[i]->name + " to " + paths[i]);
+			err = results[i];
+		}
+		else if (verbosLevel)
+		{
+			cout << fields[i]->name << " -> " << paths[i] << endl;
+		}
+	}
+	if (err == STS_OK)
+	{
+		cout << fields.size() << " field(s) extracted to " << outDir << endl;
+	}
+	return err;
+}
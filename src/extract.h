@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#ifndef EXTRACT_H
+#define EXTRACT_H
+
+#include <string>
+#include <vector>
+#include "fields.h"
+#include "bingo_types.h"
+
+
+// EXT=Extraction of the fields from an image
+
+/*
+	Writes the decoded content (ECC removed) of every field in the image to its own file in outDir,
+	named after the field. The fields are extracted in parallel.
+*/
+UINT32 EXT_ExtractFields(std::vector<Field_BinField *> &fields, const std::string &imageFile, const std::string &outDir);
+
+#endif // EXTRACT_H
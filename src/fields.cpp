@@ -14,14 +14,137 @@
  
 #include <iostream>       
 #include <sstream>
+#include <fstream>
 #include <cstring> //for memset
+#include <cstdlib>
+#include <algorithm>
+#include <map>
 #include "errors.h"
 #include "utilities.h"
 #include "fields.h"
+#include "layout.h"
+#include "cache.h"
+#include "sha2.h"
 
 using namespace std;
 
-int isMaskRequested = 0;
+static UINT32 GetFieldReferenceValue(const string &fieldName, UINT32 format, UINT64 &val);
+
+// the value is taken from a file (or a layout XML), the layout cache depends on it
+static void FLD_AddDependency(const string &str, const Field_Attributes &attributes)
+{
+	UINT32 format = attributes.format_id;
+	if (format == Field_Attributes::attr_FileSize || format == Field_Attributes::attr_FileContent ||
+		format == Field_Attributes::attr_Layout || format == Field_Attributes::attr_LayoutSize)
+	{
+		CACHE_AddDependency(str);
+	}
+}
+
+/*
+	A file read while parsing, as it was when it was read
+*/
+typedef struct FLD_KeptFile
+{
+	UINT64			size;
+	UINT64			modified;
+	vector<UINT8>	content;
+}FLD_KeptFile;
+
+// the layouts are parsed one at a time, the kept files are not shared between threads
+static bool IsKeepingFiles = false;
+static map<string, FLD_KeptFile> KeptFiles;
+
+// the compressed contents, by the SHA-256 of the content and the compression type
+static map<string, vector<UINT8> > KeptCompressed;
+
+void FLD_KeepFileContents( bool keep )
+{
+	IsKeepingFiles = keep;
+	if (!keep)
+	{
+		KeptFiles.clear();
+		KeptCompressed.clear();
+	}
+}
+
+//************************************
+// Function:  FLD_Compress - compresses a content, a content compressed before is taken as it was
+//							(while the files are kept, see FLD_KeepFileContents)
+// Returns:   UINT32
+// Parameter: CMP_Type type
+// Parameter: const vector<UINT8> & content
+// Parameter: vector<UINT8> & compressed
+//************************************
+static UINT32 FLD_Compress( CMP_Type type, const vector<UINT8> &content, vector<UINT8> &compressed )
+{
+	const UINT8 *data = content.empty() ? NULL : &content[0];
+	if (!IsKeepingFiles)
+	{
+		return CMP_Compress(type, data, (UINT32) content.size(), compressed);
+	}
+
+	UINT8 digest[SHA256_DIGEST_SIZE];
+	SHA256_Context ctx;
+	SHA256_Init(ctx);
+	SHA256_Update(ctx, data, (UINT32) content.size());
+	SHA256_Final(ctx, digest);
+	string key((const char *) digest, sizeof(digest));
+	key += (char) type;
+
+	map<string, vector<UINT8> >::iterator found = KeptCompressed.find(key);
+	if (found != KeptCompressed.end())
+	{
+		compressed = found->second;
+		return STS_OK;
+	}
+	UINT32 err = CMP_Compress(type, data, (UINT32) content.size(), compressed);
+	if (err == STS_OK)
+	{
+		KeptCompressed[key] = compressed;
+	}
+	return err;
+}
+
+//************************************
+// Function:  FLD_GetKeptFile - gets the content of a file, read once while it is unchanged (see FLD_KeepFileContents)
+// Returns:   const vector<UINT8> * - NULL when the files are not kept or the file can not be read,
+//								 the caller reads (and reports) it by itself
+// Parameter: const string & fileName
+//************************************
+static const vector<UINT8> *FLD_GetKeptFile( const string &fileName )
+{
+	UINT64 size;
+	UINT64 modified;
+
+	if (!IsKeepingFiles || !CACHE_GetFileState(fileName, size, modified))
+	{
+		return NULL;
+	}
+
+	map<string, FLD_KeptFile>::iterator found = KeptFiles.find(fileName);
+	if (found != KeptFiles.end() && found->second.size == size && found->second.modified == modified)
+	{
+		return &found->second.content;
+	}
+
+	FLD_KeptFile &kept = KeptFiles[fileName];
+	ifstream infile(fileName.c_str(), ios::binary);
+	kept.content.resize((size_t) size);
+	if (size > 0)
+	{
+		infile.read((char *) &kept.content[0], size);
+	}
+	if (!infile.is_open() || (UINT64) infile.gcount() != size)
+	{
+		KeptFiles.erase(fileName);
+		return NULL;
+	}
+	kept.size = size;
+	kept.modified = modified;
+	return &kept.content;
+}
+
 template <class UINT_T> 
 UINT32 GetIntegerFromString(string str, UINT_T &val)
 {
@@ -47,6 +170,7 @@ UINT32 HandleNumericValueString(string str, UINT_T &val, const Field_Attributes
 	
 	UINT32 err;
 	val = 0;
+	FLD_AddDependency(str, attributes);
 	// if the input is given in hex, relate to the string as raw data
 	if (attributes.format_id == Field_Attributes::attr_bytes)
 	{	
@@ -94,10 +218,10 @@ UINT32 HandleNumericValueString(string str, UINT_T &val, const Field_Attributes
 	else if (attributes.format_id == Field_Attributes::attr_FileSize)
 	{
 		// in this case str contains a path to a file, and val should be the size of it
-		UINT32 fileSize;
-		UINT32 maxSize;
+		UINT64 fileSize;
+		UINT64 maxSize;
 	
-		maxSize = (UINT_T) val - 1;
+		maxSize = (UINT_T) (val - 1);
 		err = getFileSize(str.c_str(), fileSize);
 		if (err)
 		{
@@ -143,7 +267,7 @@ UINT32 HandleNumericValueString(string str, UINT_T &val, const Field_Attributes
 				
 
 		// little endian, lowest byte located at the first address
-		UINT32 tempVal;
+		UINT_T tempVal;
 		for (int i = 0; i < sizeof(val) ; ++i)
 		{
 			tempVal = (UINT8) infile.get();
@@ -163,6 +287,28 @@ UINT32 HandleNumericValueString(string str, UINT_T &val, const Field_Attributes
 		// close file
 		infile.close();
 	}
+	else if (attributes.format_id == Field_Attributes::attr_LayoutSize)
+	{
+		// in this case str contains a path to a layout XML, and val should be the size of its image
+		const vector<UINT8> *image;
+		err = LAYOUT_GetImage(str, image);
+		if (err)
+		{
+			return err;
+		}
+		val = (UINT_T) image->size();
+	}
+	else if (attributes.isFieldReference())
+	{
+		// in this case str contains the name of another field, and val is taken from it
+		UINT64 refVal;
+		err = GetFieldReferenceValue(str, attributes.format_id, refVal);
+		if (err)
+		{
+			return err;
+		}
+		val = (UINT_T) refVal;
+	}
 
 	// perform alignment on val data according to attributes
 	if (attributes.alignment)
@@ -174,10 +320,283 @@ UINT32 HandleNumericValueString(string str, UINT_T &val, const Field_Attributes
 
 }
 
+/*
+	Digit values, each character is looked up instead of classified: 0-15 for the hex digits, 0-63 for
+	the base64 digits, FLD_NOT_A_DIGIT for the others, FLD_SPACE for white space and FLD_BASE64_PAD for '='
+*/
+
+const UINT8 FLD_NOT_A_DIGIT = 0xFF;
+const UINT8 FLD_SPACE = 0xFE;
+const UINT8 FLD_BASE64_PAD = 0xFD;
+
+typedef struct FLD_DigitTable
+{
+	UINT8	values[256];	// hex
+	UINT8	base64[256];
+}FLD_DigitTable;
+
+static FLD_DigitTable FLD_BuildDigitTable(void)
+{
+	static const char base64Digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	FLD_DigitTable table;
+	memset(table.values, FLD_NOT_A_DIGIT, sizeof(table.values));
+	memset(table.base64, FLD_NOT_A_DIGIT, sizeof(table.base64));
+	for (UINT32 i = 0; i < 10; ++i)
+	{
+		table.values['0' + i] = (UINT8) i;
+	}
+	for (UINT32 i = 0; i < 6; ++i)
+	{
+		table.values['a' + i] = (UINT8) (10 + i);
+		table.values['A' + i] = (UINT8) (10 + i);
+	}
+	for (UINT32 i = 0; i < 64; ++i)
+	{
+		table.base64[(UINT8) base64Digits[i]] = (UINT8) i;
+	}
+	table.base64['='] = FLD_BASE64_PAD;
+	table.values[' '] = table.values['\t'] = table.values['\r'] = table.values['\n'] = FLD_SPACE;
+	table.base64[' '] = table.base64['\t'] = table.base64['\r'] = table.base64['\n'] = FLD_SPACE;
+	return table;
+}
+
+static const FLD_DigitTable FLD_Digits = FLD_BuildDigitTable();
+
+static UINT32 FLD_BadCharacter( const string &format, const UINT8 *text, size_t pos )
+{
+	char errStr[STR_SIZE];
+	snprintf(errStr, STR_SIZE, "%s: illegal character '%c' at position %u\n", format.c_str(), text[pos], (UINT32) pos);
+	ERR_PrintError(ERR_ILLEGAL_VAL, errStr);
+	return ERR_ILLEGAL_VAL;
+}
+
+static UINT32 FLD_CheckDecodedSize( UINT64 count, UINT64 buffSize )
+{
+	if (buffSize < count)
+	{
+		char errStr[STR_SIZE];
+		snprintf(errStr, STR_SIZE, "Field value size is %llu and it is larger than expected %llu\n", count, buffSize);
+		ERR_PrintError(ERR_ILLEGAL_VAL, errStr);
+		return ERR_ILLEGAL_VAL;
+	}
+	return STS_OK;
+}
+
+//************************************
+// Function:  FLD_ParseBytes - parses a bytes string into a buffer, in a single pass: values separated by white space,
+//							   each in the base of its prefix (0x - hex, 0 - octal, otherwise decimal)
+// Returns:   UINT32
+// Parameter: const string & str
+// Parameter: UINT8 * buff
+// Parameter: UINT64 buffSize - more values than this is an error
+//************************************
+static UINT32 FLD_ParseBytes( const string &str, UINT8 *buff, UINT64 buffSize )
+{
+	const UINT8 *text = (const UINT8 *) str.data();
+	size_t length = str.size();
+	size_t pos = 0;
+	UINT64 count = 0;
+
+	while (true)
+	{
+		while (pos < length && FLD_Digits.values[text[pos]] == FLD_SPACE)
+		{
+			++pos;
+		}
+		if (pos == length)
+		{
+			break;
+		}
+
+		size_t start = pos;
+		UINT32 base = 10;
+		UINT32 value = 0;
+		if (text[pos] == '0' && pos + 1 < length && (text[pos + 1] == 'x' || text[pos + 1] == 'X'))
+		{
+			base = 16;
+			pos += 2;
+		}
+		else if (text[pos] == '0')
+		{
+			base = 8;
+		}
+
+		size_t digits = pos;
+		for (; pos < length && FLD_Digits.values[text[pos]] != FLD_SPACE; ++pos)
+		{
+			UINT8 digit = FLD_Digits.values[text[pos]];
+			if (digit >= base)
+			{
+				char errStr[STR_SIZE];
+				snprintf(errStr, STR_SIZE, "bytes value %llu: illegal character '%c' at position %u\n", count, text[pos], (UINT32) pos);
+				ERR_PrintError(ERR_ILLEGAL_VAL, errStr);
+				return ERR_ILLEGAL_VAL;
+			}
+			value = value * base + digit;
+			if (value > 0xFF)
+			{
+				char errStr[STR_SIZE];
+				snprintf(errStr, STR_SIZE, "bytes value %llu at position %u is larger than a byte\n", count, (UINT32) start);
+				ERR_PrintError(ERR_ILLEGAL_VAL, errStr);
+				return ERR_ILLEGAL_VAL;
+			}
+		}
+		if (pos == digits)
+		{
+			char errStr[STR_SIZE];
+			snprintf(errStr, STR_SIZE, "bytes value %llu at position %u has no digits\n", count, (UINT32) start);
+			ERR_PrintError(ERR_ILLEGAL_VAL, errStr);
+			return ERR_ILLEGAL_VAL;
+		}
+
+		// the values past the buffer are counted for the error
+		if (count < buffSize)
+		{
+			buff[count] = (UINT8) value;
+		}
+		++count;
+	}
+
+	return FLD_CheckDecodedSize(count, buffSize);
+}
+
+//************************************
+// Function:  FLD_ParseHex - decodes a hex string into a buffer: two digits for each byte, first byte first.
+//							 White space between the digits is ignored.
+// Returns:   UINT32
+// Parameter: const string & str
+// Parameter: UINT8 * buff
+// Parameter: UINT64 buffSize - more bytes than this is an error
+//************************************
+static UINT32 FLD_ParseHex( const string &str, UINT8 *buff, UINT64 buffSize )
+{
+	const UINT8 *text = (const UINT8 *) str.data();
+	size_t length = str.size();
+	size_t pos = 0;
+	UINT64 count = 0;
+	UINT8 high = 0;
+	bool isHigh = true;
+
+	while (pos < length)
+	{
+		// the common case, two digits with no space between them
+		if (isHigh && pos + 1 < length && FLD_Digits.values[text[pos]] < 16 && FLD_Digits.values[text[pos + 1]] < 16)
+		{
+			if (count < buffSize)
+			{
+				buff[count] = (UINT8) ((FLD_Digits.values[text[pos]] << 4) | FLD_Digits.values[text[pos + 1]]);
+			}
+			++count;
+			pos += 2;
+			continue;
+		}
+
+		UINT8 digit = FLD_Digits.values[text[pos]];
+		if (digit == FLD_NOT_A_DIGIT)
+		{
+			return FLD_BadCharacter(Field_Attributes::SupportedFormatAttr[Field_Attributes::attr_hex], text, pos);
+		}
+		if (digit != FLD_SPACE)
+		{
+			if (isHigh)
+			{
+				high = digit;
+			}
+			else
+			{
+				if (count < buffSize)
+				{
+					buff[count] = (UINT8) ((high << 4) | digit);
+				}
+				++count;
+			}
+			isHigh = !isHigh;
+		}
+		++pos;
+	}
+
+	if (!isHigh)
+	{
+		ERR_PrintError(ERR_ILLEGAL_VAL, "hex: odd number of digits, the last byte has a single digit");
+		return ERR_ILLEGAL_VAL;
+	}
+	return FLD_CheckDecodedSize(count, buffSize);
+}
+
+//************************************
+// Function:  FLD_ParseBase64 - decodes a base64 string into a buffer. White space is ignored, and the '='
+//								padding at the end may be omitted.
+// Returns:   UINT32
+// Parameter: const string & str
+// Parameter: UINT8 * buff
+// Parameter: UINT64 buffSize - more bytes than this is an error
+//************************************
+static UINT32 FLD_ParseBase64( const string &str, UINT8 *buff, UINT64 buffSize )
+{
+	const string &format = Field_Attributes::SupportedFormatAttr[Field_Attributes::attr_base64];
+	const UINT8 *text = (const UINT8 *) str.data();
+	size_t length = str.size();
+	UINT64 count = 0;
+	UINT32 group = 0;		// the digits of the current 4 digit group, 6 bits each
+	UINT32 digits = 0;		// in the current group
+	UINT32 pads = 0;
+
+	for (size_t pos = 0; pos < length; ++pos)
+	{
+		UINT8 digit = FLD_Digits.base64[text[pos]];
+		if (digit == FLD_SPACE)
+		{
+			continue;
+		}
+		// padding completes the last group, which has at least two digits, and nothing follows it
+		if (digit == FLD_NOT_A_DIGIT || (digit == FLD_BASE64_PAD && digits < 2) || (digit != FLD_BASE64_PAD && pads > 0))
+		{
+			return FLD_BadCharacter(format, text, pos);
+		}
+		if (digit == FLD_BASE64_PAD)
+		{
+			++pads;
+			digit = 0;
+		}
+
+		group = (group << 6) | digit;
+		if (++digits == 4)
+		{
+			for (UINT32 i = 0; i < 3 - pads; ++i)
+			{
+				if (count < buffSize)
+				{
+					buff[count] = (UINT8) (group >> (16 - 8 * i));
+				}
+				++count;
+			}
+			group = 0;
+			digits = 0;
+			pads = (pads > 0) ? 4 : 0; // nothing but space after the padding
+		}
+	}
+
+	// a group without its padding
+	if (digits == 1)
+	{
+		ERR_PrintError(ERR_ILLEGAL_VAL, "base64: the last group has a single digit");
+		return ERR_ILLEGAL_VAL;
+	}
+	for (UINT32 i = 0; digits > 1 && i < digits - 1 - pads; ++i)
+	{
+		if (count < buffSize)
+		{
+			buff[count] = (UINT8) ((group << (6 * (4 - digits))) >> (16 - 8 * i));
+		}
+		++count;
+	}
+	return FLD_CheckDecodedSize(count, buffSize);
+}
+
 /*
 	dedicated numeric string parser, for buffers output
 */
-UINT32 HandleNumericValueString(std::string str, UINT8 * &buff, UINT32 buffSize, const Field_Attributes &attributes, UINT8 padValue=0)
+UINT32 HandleNumericValueString(std::string str, UINT8 * &buff, UINT64 buffSize, const Field_Attributes &attributes, FLD_Arena &arena, UINT8 padValue=0)
 {
 	UINT32 err;
 	
@@ -188,46 +607,30 @@ UINT32 HandleNumericValueString(std::string str, UINT8 * &buff, UINT32 buffSize,
 		ERR_PrintError(err, errStr);
 		return err;
 	}
-	buff = new UINT8[buffSize];
+	buff = arena.allocate(buffSize);
 	memset(buff, padValue, buffSize);
+	FLD_AddDependency(str, attributes);
+
+	// the file may have been read by a previous layout of the run
+	const vector<UINT8> *keptFile = (attributes.format_id == Field_Attributes::attr_FileContent) ? FLD_GetKeptFile(str) : NULL;
 
 	// if the input is given in hex, relate to the string as raw data
 	if (attributes.format_id == Field_Attributes::attr_bytes)
 	{	
-		// split to bytes (in case string has spaces)
-		vector<string> str_vals = split(str, ' ');
-
-		// if size does not coincide with val size
-		if (buffSize < str_vals.size())
+		// little endian, lowest byte located at the first address
+		err = FLD_ParseBytes(str, buff, buffSize);
+		if (err)
 		{
-			char str[STR_SIZE];
-			snprintf(str, STR_SIZE, "Field value size is %d and it is larger than expected %d\n", str_vals.size(), buffSize );
-			// assert warning/error
-			ERR_PrintError(ERR_ILLEGAL_VAL, str);
-			
-			// stop the parser
-			return(ERR_ILLEGAL_VAL);
+			return err;
 		}
-		else
+	}
+	else if (attributes.format_id == Field_Attributes::attr_hex || attributes.format_id == Field_Attributes::attr_base64)
+	{
+		// the bytes are given encoded, first byte first, a shorter content leaves padding at the end
+		err = (attributes.format_id == Field_Attributes::attr_hex) ? FLD_ParseHex(str, buff, buffSize) : FLD_ParseBase64(str, buff, buffSize);
+		if (err)
 		{
-			// little endian, lowest byte located at the first address
-			UINT32 i = 0;
-			for (vector<string>::iterator it = str_vals.begin(); it != str_vals.end(); ++it)
-			{
-				UINT8 tempVal;
-				err = GetIntegerFromString(*it, tempVal);
-				if (err)
-				{
-					return err;
-				}
-				buff[i] = tempVal;
-				i++;
-				// in case the size of the data larger than the input type, take only first bytes
-				if (i >= buffSize)
-				{
-					break;
-				}
-			}
+			return err;
 		}
 	}
 	else if (attributes.format_id == Field_Attributes::attr_32bit)
@@ -257,28 +660,44 @@ UINT32 HandleNumericValueString(std::string str, UINT8 * &buff, UINT32 buffSize,
 		}
 		
 	}	
-	else if (attributes.format_id == Field_Attributes::attr_FileSize)
+	else if (attributes.format_id == Field_Attributes::attr_FileSize || attributes.format_id == Field_Attributes::attr_LayoutSize ||
+			 attributes.isFieldReference())
 	{
 		// in this case str contains a path to a file, and val should be the size of it
-		UINT32 fileSize;
-		UINT32 maxSize;
+		// (or the name of another field, and val should be its size/offset)
+		UINT64 fileSize;
+		UINT64 maxSize;
 
-		if (buffSize > 4)
+		if (buffSize > sizeof(fileSize))
 		{
 			err = ERR_ILLEGAL_VAL;
-			string errStr = "when using the FileSize attribute, maximum field size should not exceed 4 bytes";
+			string errStr = "when using the " + Field_Attributes::SupportedFormatAttr[attributes.format_id] + " attribute, maximum field size should not exceed 8 bytes";
 			ERR_PrintError(ERR_ILLEGAL_VAL, errStr);
+			return err;
 		}
-		else if (buffSize == 4)
+		else if (buffSize == sizeof(fileSize))
 		{
-			maxSize = 0xFFFFFFFF;
+			maxSize = 0xFFFFFFFFFFFFFFFFULL;
 		}
 		else
 		{
-			maxSize = (UINT32) (1<<(buffSize*8)) - 1;
+			maxSize = (1ULL << (buffSize*8)) - 1;
 		}
 
-		err = getFileSize(str.c_str(), fileSize);
+		if (attributes.format_id == Field_Attributes::attr_FileSize)
+		{
+			err = getFileSize(str.c_str(), fileSize);
+		}
+		else if (attributes.format_id == Field_Attributes::attr_LayoutSize)
+		{
+			const vector<UINT8> *image;
+			err = LAYOUT_GetImage(str, image);
+			fileSize = err ? 0 : (UINT64) image->size();
+		}
+		else
+		{
+			err = GetFieldReferenceValue(str, attributes.format_id, fileSize);
+		}
 		if (err)
 		{
 			return err;
@@ -295,6 +714,16 @@ UINT32 HandleNumericValueString(std::string str, UINT8 * &buff, UINT32 buffSize,
 			memcpy(buff, &fileSize, buffSize);
 		}
 	}
+	else if (keptFile != NULL)
+	{
+		if (attributes.fileStartOffset > keptFile->size() || buffSize > keptFile->size() - attributes.fileStartOffset)
+		{
+			string errString = "reached end of file prematurely";
+			ERR_PrintError(ERR_FILE_ERROR, errString);
+			return ERR_FILE_ERROR;
+		}
+		memcpy(buff, &(*keptFile)[(size_t) attributes.fileStartOffset], (size_t) buffSize);
+	}
 	else if (attributes.format_id == Field_Attributes::attr_FileContent)
 	{
 		// in this case str contains a path to a file, and val should be the content of it (only those who gets in the var type)
@@ -322,31 +751,40 @@ UINT32 HandleNumericValueString(std::string str, UINT8 * &buff, UINT32 buffSize,
 		}
 
 
-		// little endian, lowest byte located at the first address
-		UINT8 tempVal;
-		for (UINT32 i = 0; i < buffSize ; ++i)
+		// the file is read as is, lowest byte located at the first address
+		infile.read((char *)buff, buffSize);
+		if ((UINT64) infile.gcount() != buffSize)
 		{
-			tempVal = (UINT8) infile.get();
-			if (infile.good())
-			{
-				buff[i] = tempVal;
-			}
-			else
-			{
-				string errString = "reached end of file prematurely";
-				ERR_PrintError(ERR_FILE_ERROR, errString);
-				return ERR_FILE_ERROR;
-			}
-
+			string errString = "reached end of file prematurely";
+			ERR_PrintError(ERR_FILE_ERROR, errString);
+			return ERR_FILE_ERROR;
 		}
 
 		// close file
 		infile.close();
 	}
+	else if (attributes.format_id == Field_Attributes::attr_Layout)
+	{
+		// in this case str contains a path to a layout XML, and the buffer is taken from the image built from it
+		const vector<UINT8> *image;
+		err = LAYOUT_GetImage(str, image);
+		if (err)
+		{
+			return err;
+		}
+		if (attributes.fileStartOffset > image->size() || buffSize > image->size() - attributes.fileStartOffset)
+		{
+			err = ERR_FILE_ERROR;
+			string errString = "layout image is smaller than the field: " + str;
+			ERR_PrintError(err, errString);
+			return err;
+		}
+		memcpy(buff, &(*image)[attributes.fileStartOffset], buffSize);
+	}
 	// reverse buffer in case 
 	if (attributes.reversed)
 	{
-		for (UINT32 i = 0; i < (UINT32)buffSize/2; ++i) 
+		for (UINT64 i = 0; i < buffSize/2; ++i) 
 		{
 			UINT8 temp = buff[buffSize-i-1];
 			buff[buffSize-i-1] = buff[i];
@@ -356,15 +794,15 @@ UINT32 HandleNumericValueString(std::string str, UINT8 * &buff, UINT32 buffSize,
 	// perform alignment on val data according to attributes
 	if (attributes.alignment)
 	{
-		if (buffSize > 4)
+		if (buffSize > 8)
 		{
 			err = ERR_ILLEGAL_VAL;
-			string errStr = "can not align values which are larger than 4 bytes";
+			string errStr = "can not align values which are larger than 8 bytes";
 			ERR_PrintError(err, errStr);
 			return err;
 		}
 		
-		UINT32 tempVal = 0;
+		UINT64 tempVal = 0;
 		memcpy(&tempVal, buff, buffSize);
 		tempVal = ALIGN(tempVal,attributes.alignment);
 
@@ -384,129 +822,524 @@ const std::string Field_BinField::validConfigurationStrings[NUM_OF_VALID_CONFIGS
 The Binary Field
 */
 
-Field_BinField::Field_BinField()
+Field_BinField::Field_BinField(Field_ImageProperties *imageConfig)
 {
+	this->imageConfig = imageConfig;
 	this->dataBuffer = nullptr;
 	this->name = "";
 	this->eccType = ECC_noECC;
 	this->offset = 0;
 	this->size = 0;
+	this->maskBuffer = nullptr;
 	this->maskExists = false;
+	this->maskFound = false;
+	this->contentIsZero = true;
+	this->isReversed = false;
+	this->sourceOffset = 0;
+	this->isStreamed = false;
+	this->isComputed = false;
+	memset(this->resolveState, 0, sizeof(this->resolveState));
+	this->sideIndex = FLD_NO_SIDE_SETTINGS;
 }
 
 Field_BinField::~Field_BinField()
 {
-	delete[] dataBuffer;
+	// the buffers (and the side settings) are released with imageConfig
 }
 
-UINT32 Field_BinField::setConfiguration( std::string configurationString, std::string valueString, const Field_Attributes &attributes )
+Field_SideSettings *Field_BinField::getSide()
 {
-	UINT32 err;
-	for (UINT32 selectedConfig = 0; selectedConfig < NUM_OF_VALID_CONFIGS ; selectedConfig++)
+	if (this->sideIndex == FLD_NO_SIDE_SETTINGS)
 	{
-		if (configurationString == validConfigurationStrings[selectedConfig])
-		{
-			if (selectedConfig == configEcc)
-			{
-				// Configure ECC method, no attributes supported
+		this->sideIndex = (UINT32) imageConfig->sideSettings.size();
+		imageConfig->sideSettings.push_back(Field_SideSettings());
+	}
+	return &imageConfig->sideSettings[this->sideIndex];
+}
 
-				// make sure the configuration did not appear twice
-				if (this->eccType != ECC_noECC)
-				{
-					ERR_PrintError(ERR_SAME_FIELD_TWICE, configurationString);
-					return ERR_SAME_FIELD_TWICE;
-				}
+const Field_SideSettings *Field_BinField::findSide() const
+{
+	return (this->sideIndex == FLD_NO_SIDE_SETTINGS) ? nullptr : &imageConfig->sideSettings[this->sideIndex];
+}
 
-				if (valueString == "none")
-				{
-					this->eccType = ECC_noECC;
-				}
-				else if (valueString == "majority")
-				{
-					this->eccType = ECC_majorityRule;
-				}
-				else if (valueString == "nibble")
-				{
-					this->eccType = ECC_nibbleParity;
-				}
-				else if (valueString == "secded")
-				{
-					this->eccType = ECC_SECDED;
-				}
-				else if (valueString == "10_bits_majority")
-				{
-					this->eccType = ECC_10BitsMajorityRule;
-				}
-				else
-				{
-					ERR_PrintError(ERR_NOT_IMPLEMENTED, valueString);
-					return ERR_NOT_IMPLEMENTED;
-				}
-			}
-			else if (selectedConfig == configOffset)
-			{
-				// configure start offset of the field inside the binary image
-				// make sure field was not encountered twice
-				if (this->offset != 0)
-				{
-					ERR_PrintError(ERR_SAME_FIELD_TWICE, configurationString);
-					return ERR_SAME_FIELD_TWICE;
-				}
+bool Field_BinField::isEncrypted() const
+{
+	const Field_SideSettings *side = findSide();
+	return side != nullptr && side->encryption.enabled;
+}
 
-				err = HandleNumericValueString(valueString, this->offset, attributes); 
-				if (err)
-				{
-					ERR_PrintError(err, valueString);
-					return err; 
-				}
+void Field_BinField::setImageConfig( Field_ImageProperties *imageConfig )
+{
+	const Field_SideSettings *side = findSide();
 
+	// the settings are copied from the table of the previous image, which is kept
+	this->imageConfig = imageConfig;
+	this->sideIndex = FLD_NO_SIDE_SETTINGS;
+	if (side != nullptr)
+	{
+		*getSide() = *side;
+		imageConfig->hasDeferredValues = imageConfig->hasDeferredValues || !side->deferredValues.empty();
+	}
+}
+
+UINT32 Field_BinField::setConfiguration( const std::string &configurationString, const std::string &valueString, const Field_Attributes &attributes )
+{
+	UINT32 err;
+	INT32 selectedConfig = FLD_FindKeyword(FLD_keywordBinConfig, configurationString.c_str());
+
+	if (selectedConfig == configEcc)
+	{
+		// Configure ECC method, no attributes supported
+
+		// make sure the configuration did not appear twice
+		if (this->eccType != ECC_noECC)
+		{
+			ERR_PrintError(ERR_SAME_FIELD_TWICE, configurationString);
+			return ERR_SAME_FIELD_TWICE;
+		}
+
+		INT32 ecc = FLD_FindKeyword(FLD_keywordEcc, valueString.c_str());
+		if (ecc == FLD_KEYWORD_NOT_FOUND)
+		{
+			ERR_PrintError(ERR_NOT_IMPLEMENTED, valueString);
+			return ERR_NOT_IMPLEMENTED;
+		}
+		this->eccType = (ECC_Type) ecc;
+	}
+	else if (selectedConfig == configOffset)
+	{
+		// configure start offset of the field inside the binary image
+		// make sure field was not encountered twice
+		if (this->offset != 0)
+		{
+			ERR_PrintError(ERR_SAME_FIELD_TWICE, configurationString);
+			return ERR_SAME_FIELD_TWICE;
+		}
+
+		err = HandleNumericValueString(valueString, this->offset, attributes); 
+		if (err)
+		{
+			ERR_PrintError(err, valueString);
+			return err; 
+		}
+
+	}
+	else if (selectedConfig == configSize)
+	{
+		if (this->size != 0)
+		{
+			ERR_PrintError(ERR_SAME_FIELD_TWICE, configurationString);
+			return ERR_SAME_FIELD_TWICE;
+		}
+
+		err = HandleNumericValueString(valueString, this->size, attributes); 
+		if (err)
+		{
+			ERR_PrintError(err, valueString);
+			return err; 
+		}
+	}
+	else
+	{
+		// error - no valid configuration 
+		ERR_PrintError(ERR_ILLEGAL_FIELD, configurationString);
+		return ERR_ILLEGAL_FIELD;
+	}
+	return STS_OK;
+}
+
+UINT32 Field_BinField::setConfiguration( const std::string &configurationString, const std::string &valueString )
+{
+	Field_Attributes dummyAttr;
+	return setConfiguration(configurationString, valueString, dummyAttr);
+}
+
+
+
+
+UINT32 Field_BinField::setContent( std::string configurationString, std::string valueString, const Field_Attributes &attributes )
+{
+	UINT32 err;
+
+	// the mask is kept beside the content, both images are created from the same fields
+	UINT8 *&buffer = (configurationString == "mask") ? this->maskBuffer : this->dataBuffer;
+	if (configurationString == "mask")
+	{
+		this->maskFound = true;
+		if (this->eccType == ECC_SECDED) 
+		{
+			if (valueString == "0xff" || valueString == "0xFF")
+			{
+				this->maskExists = true;
 			}
-			else if (selectedConfig == configSize)
+			else if (valueString != "0x00" && valueString != "0x0" && valueString != "0")
 			{
-				if (this->size != 0)
-				{
-					ERR_PrintError(ERR_SAME_FIELD_TWICE, configurationString);
-					return ERR_SAME_FIELD_TWICE;
-				}
-
-				err = HandleNumericValueString(valueString, this->size, attributes); 
-				if (err)
-				{
-					ERR_PrintError(err, valueString);
-					return err; 
-				}
+				std::cout << "error encountered at " << this->name << "." << configurationString <<", value is: " << valueString <<", when mask can only be 0x00/0xff"<< endl;
+				return ERR_ILLEGAL_VAL;
 			}
 			
-			return STS_OK;
+		}
+		
+	}
+	else if (valueString != "")
+	{
+		// without a mask, the mask image holds zeros, which is valid only for an empty content.
+		// the content is checked quietly, as it is an error only when the mask image is requested
+		const char *start = valueString.c_str();
+		char *end;
+		long long tempVal = strtoll(start, &end, 0);
+		this->contentIsZero = (end != start && tempVal == 0);
+	}
+
+	// kept for the layout map
+	if (configurationString == "content")
+	{
+		bool fromFile = (attributes.format_id == Field_Attributes::attr_FileContent || attributes.format_id == Field_Attributes::attr_Layout);
+		this->sourceFile = fromFile ? valueString : "";
+		this->isReversed = attributes.reversed;
+		this->sourceOffset = (attributes.format_id == Field_Attributes::attr_FileContent) ? attributes.fileStartOffset : 0;
+	}
+
+	if (attributes.compression != CMP_none && configurationString == "content")
+	{
+		return setCompressedContent(configurationString, valueString, attributes);
+	}
+
+	if (configurationString == "content" && attributes.format_id == Field_Attributes::attr_FileContent && !attributes.reversed &&
+		size >= FLD_STREAM_MIN_SIZE)
+	{
+		return setStreamedContent(configurationString, valueString, attributes);
+	}
+
+	if (attributes.isComputed() && configurationString == "content")
+	{
+		if (attributes.format_id == Field_Attributes::attr_Signature && attributes.signer.empty() == attributes.signerLibrary.empty())
+		{
+			std::cout << "error encountered at " << this->name << "." << configurationString << ", a signature needs either a signer or a signer_lib" << endl;
+			return ERR_ILLEGAL_VAL;
+		}
+		// the value is calculated once the image is built, until then the field holds padding
+		this->isComputed = true;
+		getSide()->computedSource = valueString;
+		getSide()->computedAttributes = attributes;
+		valueString = "";
+	}
+
+	//if the value string is not empty, handle it
+	buffer = nullptr;
+	if (valueString != "")
+	{
+		err = HandleNumericValueString(valueString, buffer, size, attributes, imageConfig->arena, imageConfig->paddingValue);
+		if (err)
+		{
+			std::cout << "error encountered at " << this->name << "." << configurationString << "=" << valueString<<endl;;	
+			return err;
 		}
 	}
+	else // value string is empty, fill buffer with padding value
+	{
+		buffer = imageConfig->arena.allocate(size);
+		memset(buffer, imageConfig->paddingValue, size);
+	}	
 
-	// error - no valid configuration 
-	ERR_PrintError(ERR_ILLEGAL_FIELD, configurationString);
-	return ERR_ILLEGAL_FIELD;
+	return STS_OK;
 }
 
-UINT32 Field_BinField::setConfiguration( std::string configurationString, std::string valueString )
+//************************************
+// Function:  Field_BinField::setStreamedContent - sets the content to a large file, which is only checked here.
+//								 The file is read when the image is written (see readContent), so the
+//								 memory used does not depend on the field size.
+// Returns:   UINT32
+// Parameter: std::string configurationString
+// Parameter: std::string valueString - the file path
+// Parameter: const Field_Attributes & attributes
+//************************************
+UINT32 Field_BinField::setStreamedContent( std::string configurationString, std::string valueString, const Field_Attributes &attributes )
 {
-	Field_Attributes dummyAttr;
-	return setConfiguration(configurationString, valueString, dummyAttr);
+	UINT32 err;
+	UINT64 fileSize;
+
+	CACHE_AddDependency(valueString);
+	err = getFileSize(valueString.c_str(), fileSize);
+	if (err)
+	{
+		std::cout << "error encountered at " << this->name << "." << configurationString << "=" << valueString << endl;
+		return err;
+	}
+	if (attributes.fileStartOffset > fileSize || this->size > fileSize - attributes.fileStartOffset)
+	{
+		err = ERR_FILE_ERROR;
+		ERR_PrintError(err, "reached end of file prematurely");
+		std::cout << "error encountered at " << this->name << "." << configurationString << "=" << valueString << endl;
+		return err;
+	}
+
+	dataBuffer = nullptr;
+	this->isStreamed = true;
+	return STS_OK;
+}
+
+//************************************
+// Function:  Field_BinField::readContent - reads a part of the content, from the buffer or from the streamed file
+// Returns:   UINT32
+// Parameter: UINT64 position - in the field
+// Parameter: UINT8 * buff
+// Parameter: UINT64 count
+//************************************
+UINT32 Field_BinField::readContent( UINT64 position, UINT8 *buff, UINT64 count ) const
+{
+	if (!this->isStreamed)
+	{
+		memcpy(buff, this->dataBuffer + position, count);
+		return STS_OK;
+	}
+
+	ifstream infile(this->sourceFile.c_str(), ios::binary);
+	if (infile.is_open())
+	{
+		infile.seekg(this->sourceOffset + position);
+		infile.read((char *)buff, count);
+	}
+	if (!infile.is_open() || (UINT64) infile.gcount() != count)
+	{
+		ERR_PrintError(ERR_FILE_ERROR, "error reading " + this->sourceFile + " for field " + this->name);
+		return ERR_FILE_ERROR;
+	}
+	return STS_OK;
+}
+
+UINT32 Field_BinField::loadContent()
+{
+	UINT32 err;
+
+	if (!this->isStreamed)
+	{
+		return STS_OK;
+	}
+
+	UINT8 *buff = imageConfig->arena.allocate(size);
+	err = readContent(0, buff, size);
+	if (err)
+	{
+		return err;
+	}
+	dataBuffer = buff;
+	this->isStreamed = false;
+	return STS_OK;
+}
+
+//************************************
+// Function:  Field_BinField::setCompressedContent - sets the content to a compressed file.
+//								 If the field size is not configured, it is set to the compressed size.
+// Returns:   UINT32
+// Parameter: std::string configurationString
+// Parameter: std::string valueString - the file path
+// Parameter: const Field_Attributes & attributes
+//************************************
+UINT32 Field_BinField::setCompressedContent( std::string configurationString, std::string valueString, const Field_Attributes &attributes )
+{
+	UINT32 err;
+
+	if (attributes.format_id != Field_Attributes::attr_FileContent)
+	{
+		err = ERR_ILLEGAL_VAL;
+		std::cout << "error encountered at " << this->name << "." << configurationString << ", compress requires format='FileContent'" << endl;
+		return err;
+	}
+
+	// the whole file is compressed, from file_start_offset
+	CACHE_AddDependency(valueString);
+	vector<UINT8> fileContent;
+	const vector<UINT8> *kept = FLD_GetKeptFile(valueString);
+	if (kept != NULL && attributes.fileStartOffset <= kept->size())
+	{
+		fileContent.assign(kept->begin() + (size_t) attributes.fileStartOffset, kept->end());
+	}
+	else
+	{
+		ifstream infile(valueString.c_str(), ios::binary);
+		if (!infile.is_open())
+		{
+			string errStr = "Filename: " + valueString;
+			ERR_PrintError(ERR_FILE_NOT_FOUND, errStr);
+			return ERR_FILE_NOT_FOUND;
+		}
+		infile.seekg(attributes.fileStartOffset);
+		if (!infile.good())
+		{
+			string errString = "offset not found in file";
+			ERR_PrintError(ERR_FILE_ERROR, errString);
+			return ERR_FILE_ERROR;
+		}
+		fileContent.assign(istreambuf_iterator<char>(infile), istreambuf_iterator<char>());
+	}
+
+	vector<UINT8> compressed;
+	if (fileContent.size() > 0xFFFFFFFF)
+	{
+		err = ERR_BAD_FIELD_SIZE;
+		std::cout << "error encountered at " << this->name << "." << configurationString << ", can not compress a file of 4GB or more" << endl;
+		return err;
+	}
+	err = FLD_Compress(attributes.compression, fileContent, compressed);
+	if (err)
+	{
+		std::cout << "error encountered at " << this->name << "." << configurationString << "=" << valueString << endl;
+		return err;
+	}
+
+	if (this->size == 0)
+	{
+		this->size = compressed.size();
+	}
+	else if (compressed.size() > this->size)
+	{
+		err = ERR_BAD_FIELD_SIZE;
+		stringstream errStr;
+		errStr << this->name << ": compressed size " << compressed.size() << " exceeds the field size " << this->size;
+		ERR_PrintError(err, errStr.str());
+		return err;
+	}
+
+	// the rest of the field is padded
+	dataBuffer = imageConfig->arena.allocate(size);
+	memset(dataBuffer, imageConfig->paddingValue, size);
+	memcpy(dataBuffer, &compressed[0], compressed.size());
+	return STS_OK;
+}
+
+UINT32 Field_BinField::overrideValue( const std::string &configurationString, const std::string &valueString,
+									  const Field_XmlAttributes &xmlAttributes )
+{
+	UINT32 err;
+	Field_Attributes attributes;
+	INT32 element = FLD_FindKeyword(FLD_keywordElement, configurationString.c_str());
+
+	// the value replaces the XML one, also when it referred to another field
+	dropDeferred(configurationString);
+
+	if (element == FLD_elementContent || element == FLD_elementMask)
+	{
+		// the value is in the format of the XML one (a file for a FileContent, the source of a computed value...)
+		attributes = (element == FLD_elementMask) ? xmlAttributes.mask : xmlAttributes.content;
+		if (element == FLD_elementContent)
+		{
+			this->isStreamed = false;
+			if (this->isComputed)
+			{
+				this->isComputed = false;
+				getSide()->computedSource = "";
+			}
+		}
+		if (attributes.isFieldReference() || isDeferred(resolveSize))
+		{
+			// set when the references are resolved again, see FLD_ApplyOverrides
+			return deferValue(configurationString, valueString, attributes);
+		}
+		return setContent(configurationString, valueString, attributes);
+	}
+
+	// the configuration may be set once in the XML, clear it first
+	INT32 selectedConfig = FLD_FindKeyword(FLD_keywordBinConfig, configurationString.c_str());
+	UINT64 previousSize = this->size;
+	if (selectedConfig == configEcc)
+	{
+		this->eccType = ECC_noECC;
+	}
+	else if (selectedConfig == configOffset)
+	{
+		this->offset = 0;
+	}
+	else if (selectedConfig == configSize)
+	{
+		this->size = 0;
+	}
+	err = setConfiguration(configurationString, valueString, attributes);
+	if (err)
+	{
+		std::cout << "error encountered at " << this->name << "." << configurationString << "=" << valueString << endl;
+		return err;
+	}
+
+	// the buffers were allocated for the previous size
+	UINT8 **buffers[] = {&this->dataBuffer, &this->maskBuffer};
+	for (UINT32 i = 0; i < sizeof(buffers) / sizeof(buffers[0]) && this->size != previousSize; ++i)
+	{
+		if (*buffers[i] != nullptr)
+		{
+			UINT8 *resized = imageConfig->arena.allocate(this->size);
+			memset(resized, imageConfig->paddingValue, this->size);
+			memcpy(resized, *buffers[i], min(this->size, previousSize));
+			*buffers[i] = resized;
+		}
+	}
+	return STS_OK;
+}
+
+UINT32 Field_BinField::deferValue( std::string configurationString, std::string valueString, const Field_Attributes &attributes )
+{
+	Field_DeferredValue deferred;
+	deferred.configurationString = configurationString;
+	deferred.valueString = valueString;
+	deferred.attributes = attributes;
+	getSide()->deferredValues.push_back(deferred);
+	imageConfig->hasDeferredValues = true;
+	return STS_OK;
 }
 
+void Field_BinField::dropDeferred( const std::string &configurationString )
+{
+	if (findSide() == nullptr)
+	{
+		return;
+	}
+
+	vector<Field_DeferredValue> &deferredValues = getSide()->deferredValues;
+	vector<Field_DeferredValue>::iterator kept = deferredValues.begin();
+	for (vector<Field_DeferredValue>::iterator it = deferredValues.begin(); it != deferredValues.end(); ++it)
+	{
+		if (it->configurationString != configurationString)
+		{
+			*kept++ = *it;
+		}
+	}
+	deferredValues.erase(kept, deferredValues.end());
+}
 
+bool Field_BinField::isDeferred( UINT32 stage )
+{
+	const Field_SideSettings *side = findSide();
+	if (side == nullptr)
+	{
+		return false;
+	}
 
+	for (vector<Field_DeferredValue>::const_iterator it = side->deferredValues.begin(); it != side->deferredValues.end(); ++it)
+	{
+		if ((stage == resolveOffset && it->configurationString == validConfigurationStrings[configOffset]) ||
+			(stage == resolveSize && it->configurationString == validConfigurationStrings[configSize]) ||
+			(stage == resolveContent && (it->configurationString == "content" || it->configurationString == "mask")))
+		{
+			return true;
+		}
+	}
+	return false;
+}
 
 UINT32 Field_BinField::handleElememtXML( pugi::xml_node &node )
 {
 
 	UINT32 err;
 	Field_Attributes attributes;
-	bool MaskFound = false;
+	Field_XmlAttributes xmlAttributes;
+	bool hasXmlAttributes = false;
 	// The BinField field is two levels deep
 	for (pugi::xml_node_iterator node_it = node.begin(); node_it != node.end(); ++node_it)
 	{
 		
 		string subField = node_it->name();
-		if (subField == "config")
+		INT32 element = FLD_FindKeyword(FLD_keywordElement, node_it->name());
+		if (element == FLD_elementConfig)
 		{
 			pugi::xml_node configNode = (*node_it);
 			for (pugi::xml_node_iterator L2_it = configNode.begin(); L2_it != configNode.end(); ++L2_it)
@@ -515,7 +1348,15 @@ UINT32 Field_BinField::handleElememtXML( pugi::xml_node &node )
 				string valueString = L2_it->child_value();
 				
 				attributes.getAttributesFromNode(*L2_it);
-				err = setConfiguration(configurationString, valueString, attributes);
+				if (attributes.isFieldReference())
+				{
+					// the referenced field may not be parsed yet, set it later
+					err = deferValue(configurationString, valueString, attributes);
+				}
+				else
+				{
+					err = setConfiguration(configurationString, valueString, attributes);
+				}
 				if (err)
 				{
 					std::cout << "error encountered at " << this->name << "." << subField << "." << configurationString << "=" << valueString<<endl;
@@ -523,11 +1364,20 @@ UINT32 Field_BinField::handleElememtXML( pugi::xml_node &node )
 				}
 			}
 		}
-		else if (subField == "name")
+		else if (element == FLD_elementName)
 		{
 			this->name = node_it->child_value();
 		}
-		else if (subField == "content" || subField == "mask")
+		else if (element == FLD_elementEncrypt)
+		{
+			err = getSide()->encryption.handleElememtXML(*node_it);
+			if (err)
+			{
+				std::cout << "error encountered at " << this->name << "." << subField << endl;
+				return err;
+			}
+		}
+		else if (element == FLD_elementContent || element == FLD_elementMask || element == FLD_elementSignature)
 		{
 			err = attributes.getAttributesFromNode(*node_it);
 			if (err)
@@ -535,69 +1385,29 @@ UINT32 Field_BinField::handleElememtXML( pugi::xml_node &node )
 				std::cout << "error encountered at " << this->name << "." << subField<<endl;
 				return err;
 			}
-
-			string configurationString = node_it->name();
-			if (configurationString == "mask" && isMaskRequested)
+			if (element == FLD_elementSignature)
 			{
-				MaskFound = true;
-				if (this->eccType == ECC_nibbleParity )
-				{
-					this->eccType = ECC_Mask_nibbleParity;
-				}
-				if (this->eccType == ECC_SECDED) 
-				{
-					string value = node_it->child_value();
-					if (value == "0xff" || value == "0xFF")
-					{
-						this->maskExists = true;
-					}
-					else if (value != "0x00" && value != "0x0" && value != "0")
-					{
-						std::cout << "error encountered at " << this->name << "." << subField <<", value is: " << value <<", when mask can only be 0x00/0xff"<< endl;
-						return err;
-					}
-					
-				}
-				
+				// a signature is content computed in the Signature format
+				subField = "content";
+				attributes.format_id = Field_Attributes::attr_Signature;
 			}
-			else if (configurationString == "content" && MaskFound)
+			(element == FLD_elementMask ? xmlAttributes.mask : xmlAttributes.content) = attributes;
+			hasXmlAttributes = true;
+
+			string valueString = node_it->child_value();
+			// content is deferred when it refers to other fields, or when its size is not known yet
+			if (attributes.isFieldReference() || isDeferred(resolveSize) || isDeferred(resolveContent))
 			{
-				continue; //skipping , mask came before content in XML and no meaning for content in this stage 
+				err = deferValue(subField, valueString, attributes);
 			}
-			else if (configurationString == "content" && isMaskRequested)
+			else
 			{
-				//reached here- meaning no mask on XML field, fail if content != 0 
-				string valueString = node_it->child_value();
-				if (valueString != "")
-				{
-					UINT32 tempVal;
-					err = GetIntegerFromString(valueString, tempVal);
-					if (tempVal != 0)
-					{
-						std::cout << "error encountered at " << this->name << "." << subField << "." << configurationString << "=" << valueString << ", error, the content is not empty while the mask in compatible bit is 0 "<< endl;;
-						return err;
-					}
-				}
-				dataBuffer = new UINT8[size];
-				memset(dataBuffer,0x00, size);
-				continue;
+				err = setContent(subField, valueString, attributes);
 			}
-			string valueString = node_it->child_value();
-			//if the value string is not empty, handle it
-			if (valueString != "")
+			if (err)
 			{
- 				err = HandleNumericValueString(valueString, dataBuffer, size, attributes, ImageConfig.paddingValue);
-				if (err)
-				{
-					std::cout << "error encountered at " << this->name << "." << subField << "." << configurationString << "=" << valueString<<endl;;	
-					return err;
-				}
+				return err;
 			}
-			else // value string is empty, fill buffer with padding value
-			{
-				dataBuffer = new UINT8[size];
-				memset(dataBuffer, ImageConfig.paddingValue, size);
-			}	
 		}
 		else
 		{
@@ -609,31 +1419,173 @@ UINT32 Field_BinField::handleElememtXML( pugi::xml_node &node )
 			return err;
 		}
 	}
+
+	// kept by name (which may follow the content in the XML) only when overrides are given
+	if (hasXmlAttributes && imageConfig->keepXmlAttributes)
+	{
+		imageConfig->xmlAttributes[this->name] = xmlAttributes;
+	}
 	return STS_OK;
 }
 
-void Field_BinField::dumpField()
+//************************************
+// Function:  Field_BinField::resolve - sets the values which were deferred for the given stage,
+//								 resolving the referenced fields first (see GetFieldReferenceValue)
+// Returns:   UINT32
+// Parameter: UINT32 stage - resolveOffset, resolveSize or resolveContent
+//************************************
+UINT32 Field_BinField::resolve( UINT32 stage )
 {
-	cout << "Name: " << this->name << endl;
-	cout << " eccType:" << this->eccType;
-	cout << " size:" << this->size;
-	cout << " data:" << endl;
+	UINT32 err;
 
-	if (this->dataBuffer != nullptr)
+	if (resolveState[stage] == resolveDone)
 	{
-		for (UINT32 i = 0; i < this->size; ++i)
-		{
-			if (i %16 == 0)
-			{
-				cout << endl;
-			}
-			printf("0x%02X ",dataBuffer[i]);
-	
-		}
-		cout << endl;
+		return STS_OK;
+	}
+	if (resolveState[stage] == resolveInProgress)
+	{
+		err = ERR_ILLEGAL_VAL;
+		ERR_PrintError(err, "circular field reference at " + this->name);
+		return err;
+	}
+	resolveState[stage] = resolveInProgress;
+
+	// content can be set only after the size of the field is known
+	if (stage == resolveContent)
+	{
+		err = resolve(resolveSize);
+		if (err)
+		{
+			return err;
+		}
+	}
+
+	// a field without side settings has no deferred values
+	const Field_SideSettings *side = findSide();
+	for (UINT32 i = 0; side != nullptr && i < side->deferredValues.size(); ++i)
+	{
+		const Field_DeferredValue *it = &side->deferredValues[i];
+		if ((stage == resolveOffset && it->configurationString == validConfigurationStrings[configOffset]) ||
+			(stage == resolveSize && it->configurationString == validConfigurationStrings[configSize]))
+		{
+			err = setConfiguration(it->configurationString, it->valueString, it->attributes);
+			if (err)
+			{
+				std::cout << "error encountered at " << this->name << "." << it->configurationString << "=" << it->valueString << endl;
+				return err;
+			}
+		}
+		else if (stage == resolveContent && (it->configurationString == "content" || it->configurationString == "mask"))
+		{
+			// setContent reports the failing value by itself
+			err = setContent(it->configurationString, it->valueString, it->attributes);
+			if (err)
+			{
+				return err;
+			}
+		}
+	}
+
+	resolveState[stage] = resolveDone;
+	return STS_OK;
+}
+
+//************************************
+// Function:  Field_BinField::clearResolved - clears the offset and the size which were deferred (they may be set
+//								 once), and marks every stage as pending, so that resolve sets the values again
+// Returns:   void
+//************************************
+void Field_BinField::clearResolved()
+{
+	if (isDeferred(resolveOffset))
+	{
+		this->offset = 0;
+	}
+	if (isDeferred(resolveSize))
+	{
+		this->size = 0;
+	}
+	memset(this->resolveState, resolvePending, sizeof(this->resolveState));
+}
+
+void Field_BinField::dumpField()
+{
+	cout << "Name: " << this->name << endl;
+	cout << " eccType:" << this->eccType;
+	cout << " size:" << this->size;
+	cout << " data:" << endl;
+
+	if (this->dataBuffer != nullptr)
+	{
+		for (UINT64 i = 0; i < this->size; ++i)
+		{
+			if (i %16 == 0)
+			{
+				cout << endl;
+			}
+			printf("0x%02X ",dataBuffer[i]);
+	
+		}
+		cout << endl;
 	}
 }
 
+/*
+Field buffers arena
+*/
+
+// small buffers share blocks of this size, larger ones are allocated alone
+const UINT64 FLD_ARENA_BLOCK_SIZE = 0x100000;
+const UINT64 FLD_ARENA_MAX_SHARED = FLD_ARENA_BLOCK_SIZE / 16;
+const UINT64 FLD_ARENA_ALIGNMENT = 8;
+
+FLD_Arena::FLD_Arena(void)
+{
+	this->current = nullptr;
+	this->left = 0;
+}
+
+FLD_Arena::~FLD_Arena(void)
+{
+	release();
+}
+
+UINT8 *FLD_Arena::allocate( UINT64 size )
+{
+	UINT8 *buffer;
+
+	if (size > FLD_ARENA_MAX_SHARED)
+	{
+		buffer = new UINT8[(size_t) size];
+		blocks.push_back(buffer);
+		return buffer;
+	}
+
+	// keep the buffers aligned, an empty buffer still gets an address of its own
+	size = (size == 0) ? FLD_ARENA_ALIGNMENT : (size + FLD_ARENA_ALIGNMENT - 1) & ~(FLD_ARENA_ALIGNMENT - 1);
+	if (size > left)
+	{
+		current = new UINT8[(size_t) FLD_ARENA_BLOCK_SIZE];
+		blocks.push_back(current);
+		left = FLD_ARENA_BLOCK_SIZE;
+	}
+	buffer = current;
+	current += size;
+	left -= size;
+	return buffer;
+}
+
+void FLD_Arena::release()
+{
+	for (vector<UINT8 *>::iterator it = blocks.begin(); it != blocks.end(); ++it)
+	{
+		delete[] *it;
+	}
+	blocks.clear();
+	current = nullptr;
+	left = 0;
+}
+
 const std::string Field_ImageProperties::descriptor = "ImageProperties";
 const std::string Field_ImageProperties::validConfigurationStrings[NUM_OF_VALID_CONFIGS] = {"BinSize", "PadValue"};
 
@@ -645,59 +1597,58 @@ Field_ImageProperties::Field_ImageProperties(void)
 {
 	this->size = 0;
 	this->paddingValue = 0;
+	this->keepXmlAttributes = false;
+	this->hasDeferredValues = false;
 }
 Field_ImageProperties::~Field_ImageProperties(void)
 {
 }
 
 
-UINT32 Field_ImageProperties::setConfiguration( std::string configurationString, std::string valueString )
+UINT32 Field_ImageProperties::setConfiguration( const std::string &configurationString, const std::string &valueString )
 {
 	UINT32 err;
+	INT32 selectedConfig = FLD_FindKeyword(FLD_keywordImageConfig, configurationString.c_str());
+
 	// make sure that size is initialized and was not written already
-	for (UINT32 selectedConfig = 0; selectedConfig < NUM_OF_VALID_CONFIGS ; selectedConfig++)
+	if (selectedConfig == configImageSize)
 	{
-		if (configurationString == validConfigurationStrings[selectedConfig])
-		{
-			if (selectedConfig == configImageSize)
-			{
-
-				if (this->size != 0)
-				{
-					ERR_PrintError(ERR_SAME_FIELD_TWICE, configurationString);
-					return ERR_SAME_FIELD_TWICE;
-				}
 
-				err = GetIntegerFromString(valueString, this->size); 
-				if (err)
-				{
-					ERR_PrintError(err, valueString);
-					return err; 
-				}
-			}
-			else if(selectedConfig == configPaddingValue)
-			{
-				if (this->paddingValue != 0)
-				{
-					ERR_PrintError(ERR_SAME_FIELD_TWICE, configurationString);
-					return ERR_SAME_FIELD_TWICE;
-				}
-
-				err = GetIntegerFromString(valueString, this->paddingValue); 
-				if (err)
-				{
-					ERR_PrintError(err, valueString);
-					return err; 
-				}
-			}
+		if (this->size != 0)
+		{
+			ERR_PrintError(ERR_SAME_FIELD_TWICE, configurationString);
+			return ERR_SAME_FIELD_TWICE;
+		}
 
-			return STS_OK;
+		err = GetIntegerFromString(valueString, this->size); 
+		if (err)
+		{
+			ERR_PrintError(err, valueString);
+			return err; 
 		}
 	}
+	else if(selectedConfig == configPaddingValue)
+	{
+		if (this->paddingValue != 0)
+		{
+			ERR_PrintError(ERR_SAME_FIELD_TWICE, configurationString);
+			return ERR_SAME_FIELD_TWICE;
+		}
 
-	// error - no valid configuration 
-	ERR_PrintError(ERR_ILLEGAL_FIELD, configurationString);
-	return ERR_ILLEGAL_FIELD;
+		err = GetIntegerFromString(valueString, this->paddingValue); 
+		if (err)
+		{
+			ERR_PrintError(err, valueString);
+			return err; 
+		}
+	}
+	else
+	{
+		// error - no valid configuration 
+		ERR_PrintError(ERR_ILLEGAL_FIELD, configurationString);
+		return ERR_ILLEGAL_FIELD;
+	}
+	return STS_OK;
 }
 
 UINT32 Field_ImageProperties::handleElememtXML( pugi::xml_node &node)
@@ -718,12 +1669,123 @@ UINT32 Field_ImageProperties::handleElememtXML( pugi::xml_node &node)
 }
 
 
+const std::string Field_Encryption::descriptor = "encrypt";
+const std::string Field_Encryption::validAttributeStrings[NUM_OF_VALID_ATTRIBUTES] = {"alg", "key", "iv", "sector_size"};
+const std::string Field_Encryption::validAlgorithmStrings[AES_NUM_OF_MODES] = {"aes-ctr", "aes-xts"};
+
+/*
+Binary Field Encryption
+
+*/
+Field_Encryption::Field_Encryption(void)
+{
+	this->enabled = false;
+	this->mode = AES_ctr;
+	memset(this->iv, 0, sizeof(this->iv));
+	this->sectorSize = 0;
+}
+
+UINT32 Field_Encryption::handleElememtXML( pugi::xml_node &node )
+{
+	UINT32 err;
+	string keyFile;
+
+	if (this->enabled)
+	{
+		ERR_PrintError(ERR_SAME_FIELD_TWICE, descriptor);
+		return ERR_SAME_FIELD_TWICE;
+	}
+	this->enabled = true;
+
+	for (pugi::xml_attribute attr = node.first_attribute(); attr; attr = attr.next_attribute())
+	{
+		string attrName = attr.name();
+		string attrValue = attr.value();
+		string errStr = attrName + "=" + attrValue;
+		INT32 attrIdx = FLD_FindKeyword(FLD_keywordEncryptAttribute, attr.name());
+
+		if (attrIdx == attrAlgorithm)
+		{
+			INT32 mode = FLD_FindKeyword(FLD_keywordEncryptAlgorithm, attr.value());
+			if (mode == FLD_KEYWORD_NOT_FOUND)
+			{
+				ERR_PrintError(ERR_UNKNOWN_ATTR, errStr);
+				return ERR_UNKNOWN_ATTR;
+			}
+			this->mode = (AES_Mode) mode;
+		}
+		else if (attrIdx == attrKey)
+		{
+			keyFile = attrValue;
+		}
+		else if (attrIdx == attrIv)
+		{
+			// the iv bytes in hex, first byte first
+			string hex = attrValue.compare(0, 2, "0x") == 0 ? attrValue.substr(2) : attrValue;
+			if (hex.size() != 2 * AES_BLOCK_SIZE || hex.find_first_not_of("0123456789abcdefABCDEF") != string::npos)
+			{
+				ERR_PrintError(ERR_ILLEGAL_VAL, errStr);
+				return ERR_ILLEGAL_VAL;
+			}
+			for (UINT32 i = 0; i < AES_BLOCK_SIZE; ++i)
+			{
+				this->iv[i] = (UINT8) stoul(hex.substr(2 * i, 2), 0, 16);
+			}
+		}
+		else if (attrIdx == attrSectorSize)
+		{
+			err = GetIntegerFromString(attrValue, this->sectorSize);
+			if (err)
+			{
+				ERR_PrintError(err, errStr);
+				return err;
+			}
+		}
+		else
+		{
+			ERR_PrintError(ERR_UNKNOWN_ATTR, errStr);
+			return ERR_UNKNOWN_ATTR;
+		}
+	}
+
+	// the key is read now, so a bad key file fails before anything is built
+	CACHE_AddDependency(keyFile);
+	ifstream infile(keyFile.c_str(), ios::binary);
+	if (!infile.is_open())
+	{
+		string errStr = "Key filename: " + keyFile;
+		ERR_PrintError(ERR_FILE_NOT_FOUND, errStr);
+		return ERR_FILE_NOT_FOUND;
+	}
+	this->key.assign(istreambuf_iterator<char>(infile), istreambuf_iterator<char>());
+	if (!AES_isValidKeySize(this->mode, (UINT32) this->key.size()))
+	{
+		stringstream errStr;
+		errStr << keyFile << ": key size " << this->key.size() << " does not suit " << validAlgorithmStrings[this->mode];
+		ERR_PrintError(ERR_ILLEGAL_VAL, errStr.str());
+		return ERR_ILLEGAL_VAL;
+	}
+
+	return STS_OK;
+}
+
+UINT32 Field_Encryption::encrypt( UINT8 *data, UINT32 size ) const
+{
+	return AES_Encrypt(this->mode, &this->key[0], (UINT32) this->key.size(), this->iv, data, size, this->sectorSize);
+}
+
 Field_Attributes::Field_Attributes(void)
 {
 	format_id = attr_32bit;
 	alignment = 0;
 	fileStartOffset = 0;
 	reversed = false;
+	rangeOffset = 0;
+	rangeSize = 0;
+	signer = "";
+	signerLibrary = "";
+	digestFormat = attr_Sha256;
+	compression = CMP_none;
 }
 
 
@@ -737,95 +1799,113 @@ void Field_Attributes::clearValues()
 	alignment = 0;
 	fileStartOffset = 0;
 	reversed = false;
+	rangeOffset = 0;
+	rangeSize = 0;
+	signer = "";
+	signerLibrary = "";
+	digestFormat = attr_Sha256;
+	compression = CMP_none;
 }
 
-UINT32 Field_Attributes::setAttribute( pugi::xml_attribute &attr )
+bool Field_Attributes::isComputed() const
 {
-	string attrName ;
-	string attrValue;
-	for (int attrIdx = 0; attrIdx < NUM_SUPPORTED_ATTRIBUTES; ++attrIdx)
-	{
-		attrName = attr.name();
-		attrValue = attr.value();
-
-		if (SupportedAttributes[attrIdx] == attrName)
-		{
-			if (attrIdx == attr_format)
-			{
-				if (attrValue == SupportedFormatAttr[attr_32bit])
-				{
-					this->format_id = attr_32bit;
-				}
-				else if (attrValue == SupportedFormatAttr[attr_bytes])
-				{
-					this->format_id = attr_bytes;
-				}
-				else if (attrValue == SupportedFormatAttr[attr_FileSize])
-				{
-					this->format_id = attr_FileSize;
-				}
-				else if (attrValue == SupportedFormatAttr[attr_FileContent])
-				{
-					this->format_id = attr_FileContent;
-				}
-				else
-				{
-					string errStr = attrName+"="+attrValue;
-					ERR_PrintError(ERR_UNKNOWN_ATTR, errStr);
-					return ERR_UNKNOWN_ATTR;
-				}
+	return (format_id == attr_Crc16 || format_id == attr_CrcCcitt ||
+			format_id == attr_CrcDnp || format_id == attr_Crc32 ||
+			format_id == attr_Sha256 || format_id == attr_Sha512 ||
+			format_id == attr_Signature);
+}
 
-				return STS_OK;
-			} 
-			else if (attrIdx == attr_align)
-			{
-				UINT32 err = GetIntegerFromString(attrValue, this->alignment);
-				if (err)
-				{
-					string errStr = attrName+"="+attrValue;
-					ERR_PrintError(err, errStr);
-					return err;
-				}
+bool Field_Attributes::isFieldReference() const
+{
+	return (format_id == attr_FieldSize || format_id == attr_FieldEccSize ||
+			format_id == attr_FieldOffset || format_id == attr_FieldEnd);
+}
 
-				return STS_OK;
-			}
-			else if (attrIdx == attr_file_start_offset)
-			{
-				UINT32 err = GetIntegerFromString(attrValue, this->fileStartOffset);
-				if (err)
-				{
-					string errStr = attrName+"="+attrValue;
-					ERR_PrintError(err, errStr);
-					return err;
-				}
-				return STS_OK;
-			}
-			else if (attrIdx == attr_reverse_bytes)
-			{
-				if (attrValue == "true")
-				{
-					this->reversed = true;
-				}
-				else if (attrValue == "false")
-				{
-					this->reversed = false;
-				}
-				else
-				{
-					UINT32 err = ERR_UNKNOWN_ATTR;
-					string errStr = attrName+"="+attrValue;
-					ERR_PrintError(err, errStr);
-					return err;
-				}
-				return STS_OK;
-			}
-		} 
+UINT32 Field_Attributes::setAttribute( pugi::xml_attribute &attr )
+{
+	UINT32 err = STS_OK;
+	const char *attrName = attr.name();
+	const char *attrValue = attr.value();
+	INT32 attrIdx = FLD_FindKeyword(FLD_keywordAttribute, attrName);
 
+	if (attrIdx == attr_format)
+	{
+		INT32 formatIdx = FLD_FindKeyword(FLD_keywordFormat, attrValue);
+		if (formatIdx == FLD_KEYWORD_NOT_FOUND)
+		{
+			err = ERR_UNKNOWN_ATTR;
+		}
+		else
+		{
+			this->format_id = formatIdx;
+		}
+	} 
+	else if (attrIdx == attr_align)
+	{
+		err = GetIntegerFromString(attrValue, this->alignment);
+	}
+	else if (attrIdx == attr_file_start_offset)
+	{
+		err = GetIntegerFromString(attrValue, this->fileStartOffset);
+	}
+	else if (attrIdx == attr_range_offset || attrIdx == attr_range_size)
+	{
+		err = GetIntegerFromString(attrValue, (attrIdx == attr_range_offset) ? this->rangeOffset : this->rangeSize);
+	}
+	else if (attrIdx == attr_signer || attrIdx == attr_signer_lib)
+	{
+		((attrIdx == attr_signer) ? this->signer : this->signerLibrary) = attrValue;
+	}
+	else if (attrIdx == attr_digest)
+	{
+		INT32 digestIdx = FLD_FindKeyword(FLD_keywordFormat, attrValue);
+		if (digestIdx == attr_Sha256 || digestIdx == attr_Sha512)
+		{
+			this->digestFormat = digestIdx;
+		}
+		else
+		{
+			err = ERR_UNKNOWN_ATTR;
+		}
+	}
+	else if (attrIdx == attr_compress)
+	{
+		INT32 compressionIdx = FLD_FindKeyword(FLD_keywordCompression, attrValue);
+		if (compressionIdx == FLD_KEYWORD_NOT_FOUND)
+		{
+			err = ERR_UNKNOWN_ATTR;
+		}
+		else
+		{
+			this->compression = (CMP_Type) compressionIdx;
+		}
+	}
+	else if (attrIdx == attr_reverse_bytes)
+	{
+		if (strcmp(attrValue, "true") == 0)
+		{
+			this->reversed = true;
+		}
+		else if (strcmp(attrValue, "false") == 0)
+		{
+			this->reversed = false;
+		}
+		else
+		{
+			err = ERR_UNKNOWN_ATTR;
+		}
+	}
+	else
+	{
+		err = ERR_UNKNOWN_ATTR;
 	}
 
-	string errStr = attrName+"="+attrValue;
-	ERR_PrintError(ERR_UNKNOWN_ATTR, errStr);
-	return ERR_UNKNOWN_ATTR;
+	if (err)
+	{
+		string errStr = string(attrName) + "=" + attrValue;
+		ERR_PrintError(err, errStr);
+	}
+	return err;
 }
 
 UINT32 Field_Attributes::getAttributesFromNode( pugi::xml_node &node )
@@ -847,5 +1927,302 @@ UINT32 Field_Attributes::getAttributesFromNode( pugi::xml_node &node )
 	return STS_OK;
 }
 
-const string Field_Attributes::SupportedAttributes[NUM_SUPPORTED_ATTRIBUTES] = {"format", "align", "file_start_offset", "reverse"};
-const string Field_Attributes::SupportedFormatAttr[NUM_OF_SUPPORTED_FORMAT_ATTR] = {"32bit" ,"bytes", "FileSize", "FileContent"};
+const string Field_Attributes::SupportedAttributes[NUM_SUPPORTED_ATTRIBUTES] = {"format", "align", "file_start_offset", "reverse", "range_offset", "range_size",
+	"signer", "signer_lib", "digest", "compress"};
+const string Field_Attributes::SupportedFormatAttr[NUM_OF_SUPPORTED_FORMAT_ATTR] = {"32bit" ,"bytes", "FileSize", "FileContent",
+	"FieldSize", "FieldEccSize", "FieldOffset", "FieldEnd",
+	"Layout", "LayoutSize",
+	"Crc16", "CrcCcitt", "CrcDnp", "Crc32",
+	"Sha256", "Sha512", "Signature",
+	"hex", "base64"};
+const string Field_Attributes::SupportedCompressionAttr[CMP_NUM_OF_TYPES] = {"none", "lz4"};
+
+
+/*
+	Keywords
+*/
+
+/*
+	A keyword of the table all the groups share, sorted by group and text
+*/
+typedef struct FLD_Keyword
+{
+	std::string	text;
+	INT32		group;
+	INT32		index;		// in the enum of the group
+}FLD_Keyword;
+
+static bool FLD_KeywordLess( const FLD_Keyword &a, const FLD_Keyword &b )
+{
+	return (a.group != b.group) ? (a.group < b.group) : (strcmp(a.text.c_str(), b.text.c_str()) < 0);
+}
+
+static void FLD_AddKeywords( vector<FLD_Keyword> &keywords, INT32 group, const string *texts, INT32 count )
+{
+	for (INT32 index = 0; index < count; ++index)
+	{
+		FLD_Keyword keyword;
+		keyword.text = texts[index];
+		keyword.group = group;
+		keyword.index = index;
+		keywords.push_back(keyword);
+	}
+}
+
+//************************************
+// Function:  FLD_BuildKeywordTable - collects the keywords of all the groups (from the strings the handlers
+//									 are documented by), sorted for a binary search
+// Returns:   const vector<FLD_Keyword> *
+//************************************
+static const vector<FLD_Keyword> *FLD_BuildKeywordTable( void )
+{
+	vector<FLD_Keyword> *keywords = new vector<FLD_Keyword>;
+	const string elements[FLD_NUM_OF_ELEMENTS] = {Field_BinField::descriptor, Field_ImageProperties::descriptor, "config", "name",
+												  Field_Encryption::descriptor, "content", "mask", "signature"};
+	string eccNames[ECC_SECDED + 1];
+	for (INT32 ecc = ECC_noECC; ecc <= ECC_SECDED; ++ecc)
+	{
+		eccNames[ecc] = ECC_getName((ECC_Type) ecc);
+	}
+
+	FLD_AddKeywords(*keywords, FLD_keywordElement, elements, FLD_NUM_OF_ELEMENTS);
+	FLD_AddKeywords(*keywords, FLD_keywordBinConfig, Field_BinField::validConfigurationStrings, Field_BinField::NUM_OF_VALID_CONFIGS);
+	FLD_AddKeywords(*keywords, FLD_keywordImageConfig, Field_ImageProperties::validConfigurationStrings,
+					Field_ImageProperties::NUM_OF_VALID_CONFIGS);
+	FLD_AddKeywords(*keywords, FLD_keywordAttribute, Field_Attributes::SupportedAttributes, Field_Attributes::NUM_SUPPORTED_ATTRIBUTES);
+	FLD_AddKeywords(*keywords, FLD_keywordFormat, Field_Attributes::SupportedFormatAttr, Field_Attributes::NUM_OF_SUPPORTED_FORMAT_ATTR);
+	FLD_AddKeywords(*keywords, FLD_keywordCompression, Field_Attributes::SupportedCompressionAttr, CMP_NUM_OF_TYPES);
+	FLD_AddKeywords(*keywords, FLD_keywordEcc, eccNames, ECC_SECDED + 1);
+	FLD_AddKeywords(*keywords, FLD_keywordEncryptAttribute, Field_Encryption::validAttributeStrings, Field_Encryption::NUM_OF_VALID_ATTRIBUTES);
+	FLD_AddKeywords(*keywords, FLD_keywordEncryptAlgorithm, Field_Encryption::validAlgorithmStrings, AES_NUM_OF_MODES);
+
+	// a keyword listed twice in its group keeps its first index
+	stable_sort(keywords->begin(), keywords->end(), FLD_KeywordLess);
+	return keywords;
+}
+
+INT32 FLD_FindKeyword( FLD_KeywordGroup group, const char *str )
+{
+	// built on first use, the keyword strings of the classes are all set by then
+	static const vector<FLD_Keyword> *keywords = FLD_BuildKeywordTable();
+
+	size_t first = 0;
+	size_t count = keywords->size();
+	while (count > 0)
+	{
+		size_t half = count / 2;
+		const FLD_Keyword &keyword = (*keywords)[first + half];
+		if (keyword.group < group || (keyword.group == group && strcmp(keyword.text.c_str(), str) < 0))
+		{
+			first += half + 1;
+			count -= half + 1;
+		}
+		else
+		{
+			count = half;
+		}
+	}
+	if (first < keywords->size() && (*keywords)[first].group == group && (*keywords)[first].text == str)
+	{
+		return (*keywords)[first].index;
+	}
+	return FLD_KEYWORD_NOT_FOUND;
+}
+
+
+/*
+	Cross-field references
+*/
+
+// fields of the layout being resolved, the index by name is built on the first reference
+typedef struct FLD_ResolveScope
+{
+	std::vector<Field_BinField *>		*fields;
+	map<string, Field_BinField *>		fieldsByName;	// NULL when the name is not unique
+}FLD_ResolveScope;
+
+static FLD_ResolveScope *ResolvedScope = NULL;
+
+static void FLD_IndexFieldNames( FLD_ResolveScope &scope )
+{
+	for (vector<Field_BinField *>::iterator it = scope.fields->begin(); it != scope.fields->end(); ++it)
+	{
+		pair<map<string, Field_BinField *>::iterator, bool> inserted = scope.fieldsByName.insert(make_pair((*it)->name, *it));
+		if (!inserted.second)
+		{
+			inserted.first->second = NULL;
+		}
+	}
+}
+
+static UINT32 GetFieldReferenceValue( const string &fieldName, UINT32 format, UINT64 &val )
+{
+	UINT32 err;
+
+	if (ResolvedScope == NULL)
+	{
+		err = ERR_ILLEGAL_VAL;
+		ERR_PrintError(err, "field references are supported only in BinField elements");
+		return err;
+	}
+
+	if (ResolvedScope->fieldsByName.empty())
+	{
+		FLD_IndexFieldNames(*ResolvedScope);
+	}
+
+	map<string, Field_BinField *>::iterator found = ResolvedScope->fieldsByName.find(fieldName);
+	if (found == ResolvedScope->fieldsByName.end())
+	{
+		err = ERR_ILLEGAL_VAL;
+		ERR_PrintError(err, "referenced field not found: " + fieldName);
+		return err;
+	}
+	if (found->second == NULL)
+	{
+		err = ERR_AMBIGUITY;
+		ERR_PrintError(err, "more than one field is named " + fieldName);
+		return err;
+	}
+
+	Field_BinField *field = found->second;
+	if (format != Field_Attributes::attr_FieldSize && format != Field_Attributes::attr_FieldEccSize)
+	{
+		err = field->resolve(Field_BinField::resolveOffset);
+		if (err)
+		{
+			return err;
+		}
+	}
+	if (format != Field_Attributes::attr_FieldOffset)
+	{
+		err = field->resolve(Field_BinField::resolveSize);
+		if (err)
+		{
+			return err;
+		}
+	}
+
+	if (format == Field_Attributes::attr_FieldSize)
+	{
+		val = field->size;
+	}
+	else if (format == Field_Attributes::attr_FieldEccSize)
+	{
+		val = ECC_getTotalSize(field->size, field->eccType);
+	}
+	else if (format == Field_Attributes::attr_FieldOffset)
+	{
+		val = field->offset;
+	}
+	else
+	{
+		val = field->offset + ECC_getTotalSize(field->size, field->eccType);
+	}
+	return STS_OK;
+}
+
+static UINT32 FLD_ApplyOverride( std::vector<Field_BinField *> &fields, const Field_ImageProperties &parsedConfig,
+								 const std::string &assignment )
+{
+	UINT32 err;
+	size_t equals = assignment.find('=');
+	size_t dot = (equals == string::npos) ? string::npos : assignment.rfind('.', equals);
+
+	// the field name may have dots of its own, the configuration is after the last one
+	if (dot == string::npos || dot == 0)
+	{
+		err = ERR_CMD_LINE_ERR;
+		ERR_PrintError(err, "an override is given as Field.config=value: " + assignment);
+		return err;
+	}
+	string fieldName = assignment.substr(0, dot);
+	string configurationString = assignment.substr(dot + 1, equals - dot - 1);
+	string valueString = assignment.substr(equals + 1);
+
+	Field_BinField *field = NULL;
+	for (vector<Field_BinField *>::iterator it = fields.begin(); it != fields.end(); ++it)
+	{
+		if ((*it)->name != fieldName)
+		{
+			continue;
+		}
+		if (field != NULL)
+		{
+			err = ERR_AMBIGUITY;
+			ERR_PrintError(err, "more than one field is named " + fieldName);
+			return err;
+		}
+		field = *it;
+	}
+	if (field == NULL)
+	{
+		err = ERR_ILLEGAL_VAL;
+		ERR_PrintError(err, "overridden field not found: " + fieldName);
+		return err;
+	}
+
+	// a field without a content (or mask) in the XML has no attributes recorded, the default ones are used
+	Field_XmlAttributes noAttributes;
+	map<string, Field_XmlAttributes>::const_iterator found = parsedConfig.xmlAttributes.find(fieldName);
+	return field->overrideValue(configurationString, valueString, (found != parsedConfig.xmlAttributes.end()) ? found->second : noAttributes);
+}
+
+UINT32 FLD_ApplyOverrides( std::vector<Field_BinField *> &fields, const Field_ImageProperties &parsedConfig,
+						   const std::vector<std::string> &assignments )
+{
+	UINT32 err;
+
+	if (assignments.empty())
+	{
+		return STS_OK;
+	}
+	for (vector<string>::const_iterator it = assignments.begin(); it != assignments.end(); ++it)
+	{
+		err = FLD_ApplyOverride(fields, parsedConfig, *it);
+		if (err)
+		{
+			return err;
+		}
+	}
+
+	// a FieldSize (FieldOffset...) of an overridden field is set again, as are the overridden references
+	if (fields.empty() || !fields.front()->imageConfig->hasDeferredValues)
+	{
+		return STS_OK;
+	}
+	for (vector<Field_BinField *>::iterator it = fields.begin(); it != fields.end(); ++it)
+	{
+		(*it)->clearResolved();
+	}
+	return FLD_ResolveReferences(fields);
+}
+
+UINT32 FLD_ResolveReferences( std::vector<Field_BinField *> &fields )
+{
+	UINT32 err = STS_OK;
+	FLD_ResolveScope scope;
+
+	// most layouts have no references, they are not gone over at all
+	if (fields.empty() || !fields.front()->imageConfig->hasDeferredValues)
+	{
+		return STS_OK;
+	}
+
+	// the names are indexed only when a reference is met
+	scope.fields = &fields;
+
+	// layouts may be nested (format='Layout'), keep the scope of the including layout
+	FLD_ResolveScope *includingScope = ResolvedScope;
+	ResolvedScope = &scope;
+	for (vector<Field_BinField *>::iterator it = fields.begin(); it != fields.end() && err == STS_OK; ++it)
+	{
+		for (UINT32 stage = 0; stage < Field_BinField::NUM_OF_RESOLVE_STAGES && err == STS_OK; ++stage)
+		{
+			err = (*it)->resolve(stage);
+		}
+	}
+	ResolvedScope = includingScope;
+
+	return err;
+}
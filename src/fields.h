@@ -16,8 +16,12 @@
 #define FIELDS_H
 
 #include "error_correction.h"
+#include "aes.h"
+#include "compress.h"
 #include "bingo_types.h"
 #include "pugiXML/pugixml.hpp"
+#include <deque>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -34,6 +38,8 @@ public:
 	UINT32 setAttribute(pugi::xml_attribute &attr);
 	UINT32 getAttributesFromNode(pugi::xml_node &node);
 	void clearValues();
+	bool isFieldReference() const;
+	bool isComputed() const;
 
 	enum validNumericAttributes
 	{
@@ -41,6 +47,12 @@ public:
 		attr_align,		 // describes the alignment of the output
 		attr_file_start_offset,
 		attr_reverse_bytes,
+		attr_range_offset,	// start of the range a computed value (Crc32...) is calculated over
+		attr_range_size,	// size of that range (0 - up to the end of the field/image)
+		attr_signer,		// helper command which signs a Signature digest
+		attr_signer_lib,	// shared library which signs a Signature digest
+		attr_digest,		// digest signed by a Signature (Sha256/Sha512)
+		attr_compress,		// compression of a FileContent (lz4)
 		NUM_SUPPORTED_ATTRIBUTES
 	};
 	static const std::string SupportedAttributes[NUM_SUPPORTED_ATTRIBUTES]; //  = {"format", "align", "start_offset"};
@@ -51,21 +63,142 @@ public:
 		attr_bytes,
 		attr_FileSize,
 		attr_FileContent,
+		attr_FieldSize,		// raw size of another field
+		attr_FieldEccSize,	// size of another field after ECC encoding
+		attr_FieldOffset,	// offset of another field
+		attr_FieldEnd,		// offset of another field plus its ECC size
+		attr_Layout,		// image built from another layout XML
+		attr_LayoutSize,	// size of the image built from another layout XML
+		attr_Crc16,			// CRC computed over a range of the built image
+		attr_CrcCcitt,
+		attr_CrcDnp,
+		attr_Crc32,
+		attr_Sha256,		// digest computed over a range of the built image
+		attr_Sha512,
+		attr_Signature,		// signature of a digest computed over a range of the built image
+		attr_hex,			// contiguous hex digits, first byte first
+		attr_base64,		// base64 encoded bytes
 		NUM_OF_SUPPORTED_FORMAT_ATTR
 	}formatAttr;
 	static const std::string SupportedFormatAttr[NUM_OF_SUPPORTED_FORMAT_ATTR];
+	static const std::string SupportedCompressionAttr[CMP_NUM_OF_TYPES];
 	
 	
 	UINT32		format_id;
 	UINT32		alignment;
-	UINT32		fileStartOffset;
+	UINT64		fileStartOffset;
 	bool		reversed;
+	UINT64		rangeOffset;
+	UINT64		rangeSize;
+	std::string	signer;
+	std::string	signerLibrary;
+	UINT32		digestFormat;
+	CMP_Type	compression;
 
 
 };
 
 
 
+/*
+	Encryption of a BinField content, applied before the ECC
+*/
+class Field_Encryption
+{
+public:
+
+	Field_Encryption(void);
+	static const std::string descriptor;
+
+	// XML node handler, the settings are the node attributes
+	UINT32	handleElememtXML(pugi::xml_node &node);
+
+	// Encrypts the data in place
+	UINT32	encrypt(UINT8 *data, UINT32 size) const;
+
+	enum validAttributes
+	{
+		attrAlgorithm = 0,
+		attrKey,
+		attrIv,
+		attrSectorSize,
+		NUM_OF_VALID_ATTRIBUTES
+	};
+
+	static const std::string validAttributeStrings[NUM_OF_VALID_ATTRIBUTES];
+	static const std::string validAlgorithmStrings[AES_NUM_OF_MODES];
+
+	bool				enabled;
+	AES_Mode			mode;
+	std::vector<UINT8>	key;			// taken from the key file
+	UINT8				iv[AES_BLOCK_SIZE];
+	UINT32				sectorSize;		// xts data unit size, 0 - the whole field
+
+};
+
+/*
+	A value which depends on other fields (FieldSize, FieldOffset...),
+	kept aside while parsing and set once the referenced fields are known
+*/
+class Field_DeferredValue
+{
+public:
+	std::string			configurationString;	// offset, size, content or mask
+	std::string			valueString;
+	Field_Attributes	attributes;
+};
+
+/*
+	Settings which only some fields have (encryption, a computed content, values referring to other fields).
+	They are kept in a side table of the image (Field_ImageProperties::sideSettings) rather than in every field,
+	see Field_BinField::getSide
+*/
+class Field_SideSettings
+{
+public:
+	Field_Encryption	encryption;
+
+	// content computed over the built image (Crc32, Sha256...), set by FM_CreateBinImage
+	std::string			computedSource;		// name of the field the value is computed over, empty for an image range
+	Field_Attributes	computedAttributes;
+
+	// values referring to other fields (FieldSize...), in XML order. They are kept after they are resolved,
+	// to be resolved again once the referenced fields are overridden
+	std::vector<Field_DeferredValue>	deferredValues;
+};
+
+/*
+	The attributes of the content and of the mask of a BinField in the XML, an override is parsed with them
+*/
+class Field_XmlAttributes
+{
+public:
+	Field_Attributes	content;
+	Field_Attributes	mask;
+};
+
+/*
+	Memory the field buffers of one image are carved from, it is released as a whole
+	when the image properties are destructed (a buffer is never released by itself)
+*/
+class FLD_Arena
+{
+public:
+	FLD_Arena(void);
+	~FLD_Arena(void);
+
+	// returns size bytes, a large buffer gets a block of its own
+	UINT8	*allocate(UINT64 size);
+	void	release();
+
+private:
+	FLD_Arena(const FLD_Arena &);
+	FLD_Arena &operator=(const FLD_Arena &);
+
+	std::vector<UINT8 *>	blocks;
+	UINT8					*current;	// free space of the last small block
+	UINT64					left;
+};
 
 /*
 	Image properties field
@@ -89,19 +222,27 @@ public:
 		NUM_OF_VALID_CONFIGS
 	};
 
-	UINT32 setConfiguration(std::string configurationString, std::string valueString);
+	UINT32 setConfiguration(const std::string &configurationString, const std::string &valueString);
 	
+	static const std::string validConfigurationStrings[NUM_OF_VALID_CONFIGS];
+
 	// field values
-	UINT32	size;
+	UINT64	size;
 	UINT8	paddingValue;
 
+	// the buffers of the fields of this image
+	FLD_Arena	arena;
 
-private:
-	static const std::string validConfigurationStrings[NUM_OF_VALID_CONFIGS];
+	// the side settings of the fields which have any, by Field_BinField::sideIndex
+	std::deque<Field_SideSettings>	sideSettings;
+	bool							hasDeferredValues;	// a field refers to another one, see FLD_ResolveReferences
 
-};
+	// The XML attributes of the fields with a content or a mask, by field name, for the overrides (see
+	// FLD_ApplyOverrides). They are recorded only if keepXmlAttributes is set before the XML is parsed.
+	bool										keepXmlAttributes;
+	std::map<std::string, Field_XmlAttributes>	xmlAttributes;
 
-extern Field_ImageProperties ImageConfig;
+};
 
 /*
 	Binary Field Properties
@@ -110,7 +251,7 @@ class Field_BinField
 {
 public:
 
-	Field_BinField(void); // constructor
+	Field_BinField(Field_ImageProperties *imageConfig); // constructor
 	~Field_BinField(void);
 	static const std::string descriptor;
 	UINT32					allocataDataBuffer();
@@ -118,20 +259,56 @@ public:
 	
 	std::string		name;
 	ECC_Type		eccType;
-	UINT32			offset;
-	UINT32			size;
-	UINT8			*dataBuffer;
-	bool			maskExists;
-
+	UINT64			offset;
+	UINT64			size;
+	UINT8			*dataBuffer;		// nullptr for a streamed content, see isStreamed (imageConfig->arena)
+	UINT8			*maskBuffer;		// the mask value, nullptr if the field has no mask (imageConfig->arena)
+	bool			maskExists;			// secded mask of 0xFF, the whole encoded field is masked
+	bool			maskFound;
+	bool			contentIsZero;		// a field without a mask must have an empty (or zero) content
+	bool			isReversed;			// the content is stored byte reversed (reverse attribute)
+	std::string		sourceFile;			// the file a FileContent/Layout content was taken from
+	UINT64			sourceOffset;		// the offset the content was taken from in sourceFile
+	bool			isStreamed;			// a large FileContent, read from sourceFile only when the image is written
+	Field_ImageProperties	*imageConfig;	// properties of the image this field belongs to
+	bool			isComputed;			// content computed over the built image (Crc32, Sha256...), see getSide
 	
+	// The side settings of the field (encryption, computed content, deferred values), getSide adds them
+	// to imageConfig->sideSettings on first use, findSide gives nullptr for a field which has none
+	Field_SideSettings			*getSide();
+	const Field_SideSettings	*findSide() const;
+	bool						isEncrypted() const;
+
+	// Moves the field (a copy of a field of another image) to the given image, with its side settings
+	void					setImageConfig(Field_ImageProperties *imageConfig);
 
 	// Sets the field configuration, according to given attributes
-	UINT32					setConfiguration(std::string configurationString, std::string valueString);
-	UINT32					setConfiguration(std::string configurationString, std::string valueString, const Field_Attributes &attributes );
+	UINT32					setConfiguration(const std::string &configurationString, const std::string &valueString);
+	UINT32					setConfiguration(const std::string &configurationString, const std::string &valueString, const Field_Attributes &attributes );
 	
+	// Sets the field content (or mask), according to given attributes
+	UINT32					setContent(std::string configurationString, std::string valueString, const Field_Attributes &attributes);
+
+	// Replaces a configuration or the content (or mask) already set, a new size keeps the content (cut or padded).
+	// A content (or mask) is parsed with the attributes it has in the XML.
+	UINT32					overrideValue(const std::string &configurationString, const std::string &valueString,
+										  const Field_XmlAttributes &xmlAttributes);
+
 	// XML node handler, according to field structure
 	UINT32					handleElememtXML(pugi::xml_node &node);
 
+	// Sets the values which were deferred for the given stage
+	UINT32					resolve(UINT32 stage);
+
+	// Clears the values which were deferred, so that resolve sets them again
+	void					clearResolved();
+
+	// Reads count bytes of the content, from the given position in the field
+	UINT32					readContent(UINT64 position, UINT8 *buff, UINT64 count) const;
+
+	// Reads a streamed content into dataBuffer, for the ECC and the encryption which need it whole
+	UINT32					loadContent();
+
 
 	enum validConfigs
 	{
@@ -140,14 +317,111 @@ public:
 		configSize,
 		NUM_OF_VALID_CONFIGS
 	};
+	static const std::string validConfigurationStrings[NUM_OF_VALID_CONFIGS];
+
+	enum resolveStages
+	{
+		resolveOffset = 0,
+		resolveSize,
+		resolveContent,
+		NUM_OF_RESOLVE_STAGES
+	};
+
+	enum resolveStates
+	{
+		resolvePending = 0,
+		resolveInProgress,
+		resolveDone
+	};
 
 private:
-	static const std::string validConfigurationStrings[NUM_OF_VALID_CONFIGS];
+	UINT32					setStreamedContent(std::string configurationString, std::string valueString, const Field_Attributes &attributes);
+	UINT32					setCompressedContent(std::string configurationString, std::string valueString, const Field_Attributes &attributes);
+	UINT32					deferValue(std::string configurationString, std::string valueString, const Field_Attributes &attributes);
+	bool					isDeferred(UINT32 stage);
+	void					dropDeferred(const std::string &configurationString);
+
+	UINT8					resolveState[NUM_OF_RESOLVE_STAGES];
+	UINT32					sideIndex;		// in imageConfig->sideSettings, FLD_NO_SIDE_SETTINGS if none
 
 
 };
 
 
+// FLD=Fields
+
+/*
+	Resolves cross-field references (FieldSize, FieldEccSize, FieldOffset, FieldEnd).
+	Referenced fields are resolved first, circular references are reported as errors.
+	The fields share one image, nothing is done if none of them has a deferred value (hasDeferredValues).
+*/
+UINT32 FLD_ResolveReferences(std::vector<Field_BinField *> &fields);
+
+/*
+	Applies overrides of field values (Field.config=value, config is ecc/offset/size/content/mask)
+	to the resolved fields, then resolves again the values referring to the overridden fields.
+	A content (or mask) is given as in the XML, and parsed with the attributes it has there
+	(e.g. a file name for a FileContent, see Field_ImageProperties::xmlAttributes, which are recorded only
+	when keepXmlAttributes is set before parsing), a configuration is given as a number.
+	parsedConfig is the image the fields were parsed into, the fields may be copies of them.
+*/
+UINT32 FLD_ApplyOverrides(std::vector<Field_BinField *> &fields, const Field_ImageProperties &parsedConfig,
+						  const std::vector<std::string> &assignments);
+
+/*
+	Keeps the files read while parsing (FileContent, compressed contents) by their path and modification time,
+	so that the layouts parsed one after the other in a run (see MTX_BuildVariants) read each file once.
+	A compressed content is kept as well, by the digest of the content, and compressed once.
+	The kept contents are released when it is turned off.
+*/
+void FLD_KeepFileContents(bool keep);
+
+// Field_BinField::sideIndex of a field without side settings
+const UINT32 FLD_NO_SIDE_SETTINGS = 0xFFFFFFFF;
+
+// a FileContent of at least this size is not loaded while parsing, it is streamed into the image
+const UINT64 FLD_STREAM_MIN_SIZE = 0x100000;
+
+/*
+	Groups of the layout XML keywords. The index of a keyword is its value in the enum of its group.
+*/
+typedef enum FLD_KeywordGroup
+{
+	FLD_keywordElement = 0,			// FLD_Element
+	FLD_keywordBinConfig,			// Field_BinField::validConfigs
+	FLD_keywordImageConfig,			// Field_ImageProperties::validConfigs
+	FLD_keywordAttribute,			// Field_Attributes::validNumericAttributes
+	FLD_keywordFormat,				// Field_Attributes::formatAttr
+	FLD_keywordCompression,			// CMP_Type
+	FLD_keywordEcc,					// ECC_Type
+	FLD_keywordEncryptAttribute,	// Field_Encryption::validAttributes
+	FLD_keywordEncryptAlgorithm,	// AES_Mode
+	FLD_NUM_OF_KEYWORD_GROUPS
+}FLD_KeywordGroup;
+
+/*
+	Elements of the layout XML
+*/
+typedef enum FLD_Element
+{
+	FLD_elementBinField = 0,
+	FLD_elementImageProperties,
+	FLD_elementConfig,
+	FLD_elementName,
+	FLD_elementEncrypt,
+	FLD_elementContent,
+	FLD_elementMask,
+	FLD_elementSignature,
+	FLD_NUM_OF_ELEMENTS
+}FLD_Element;
+
+const INT32 FLD_KEYWORD_NOT_FOUND = -1;
+
+/*
+	Returns the index of the keyword in its group (FLD_KEYWORD_NOT_FOUND if the string is not a keyword of the group).
+	Works on the strings of the XML nodes as they are, all the groups share one sorted table (binary search).
+*/
+INT32 FLD_FindKeyword(FLD_KeywordGroup group, const char *str);
 
 
 #endif // FIELDS_H
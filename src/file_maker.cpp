@@ -13,18 +13,56 @@
 */
 
 #include <algorithm>
+#include <iostream>
 #include <fstream>
 #include <sstream>
 #include <cstring>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include "checksum.h"
+#include "sha2.h"
+#include "signer.h"
 #include "error_correction.h"
 #include "errors.h"
 #include "file_maker.h"
 
 using namespace std;
-extern int isMaskRequested;
-bool FM_binFieldSortFunctionHandler( Field_BinField *f1, Field_BinField *f2 )
+
+// the encoded fields, by the digest of their content and their encoding (see FM_KeepEncodedFields).
+// The variants are built in parallel, an entry is added under the lock and is not changed once added.
+static bool IsKeepingEncoded = false;
+static std::mutex EncodedFieldsLock;
+static map<string, vector<UINT8> > EncodedFields;
+// sort key of a field, the keys are contiguous so the sort does not reach the fields themselves
+typedef struct FM_FieldKey
+{
+	UINT64	offset;
+	size_t	index;		// in the unsorted vector
+}FM_FieldKey;
+
+static bool FM_FieldKeyLess( const FM_FieldKey &k1, const FM_FieldKey &k2 )
 {
-	return ((f1->offset) < (f2->offset));
+	return (k1.offset < k2.offset) || (k1.offset == k2.offset && k1.index < k2.index);
+}
+
+void FM_SortFields( std::vector<Field_BinField *> &fields )
+{
+	vector<FM_FieldKey> keys(fields.size());
+	for (size_t i = 0; i < fields.size(); ++i)
+	{
+		keys[i].offset = fields[i]->offset;
+		keys[i].index = i;
+	}
+
+	std::sort(keys.begin(), keys.end(), FM_FieldKeyLess);
+
+	vector<Field_BinField *> sorted(fields.size());
+	for (size_t i = 0; i < keys.size(); ++i)
+	{
+		sorted[i] = fields[keys[i].index];
+	}
+	fields.swap(sorted);
 }
 
 UINT32 FM_ValidateFieldVector( std::vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig )
@@ -32,8 +70,8 @@ UINT32 FM_ValidateFieldVector( std::vector<Field_BinField *> &fields, Field_Imag
 	UINT32 err;
 
 	// make sure there is no field overlap
-	UINT32 prevOffset = 0;
-	UINT32 prevSize = 0;
+	UINT64 prevOffset = 0;
+	UINT64 prevSize = 0;
 	
 	for (vector<Field_BinField *>::iterator it = fields.begin(); it != fields.end(); ++it)
 	{
@@ -49,6 +87,15 @@ UINT32 FM_ValidateFieldVector( std::vector<Field_BinField *> &fields, Field_Imag
 		prevOffset = (*it)->offset;
 		prevSize = ECC_getTotalSize((*it)->size, (*it)->eccType);
 
+		// the ECC and the encryption are performed over buffers of up to 4GB
+		if (((*it)->eccType != ECC_noECC || (*it)->isEncrypted()) && prevSize > 0xFFFFFFFF)
+		{
+			err = ERR_BAD_FIELD_SIZE;
+			string errStr = (*it)->name + ": an ECC encoded or encrypted field can not exceed 4GB";
+			ERR_PrintError(err, errStr);
+			return err;
+		}
+
 		// if the ECC is 10 bit majority make sure size is 2 bytes
 		if (((*it)->eccType == ECC_10BitsMajorityRule) && ((*it)->size != ECC_SIZE_FOR_10BIT_MAJORITY) )
 		{
@@ -61,13 +108,13 @@ UINT32 FM_ValidateFieldVector( std::vector<Field_BinField *> &fields, Field_Imag
 
 
 
-	UINT32 calculateSize = prevOffset + prevSize;
+	UINT64 calculateSize = prevOffset + prevSize;
 
 	if (calculateSize < prevOffset)
 	{
 		// result overflowed
 		err = ERR_ILLEGAL_VAL;
-		string errStr = "calculated file size overflows (32bit)";
+		string errStr = "calculated file size overflows (64bit)";
 		ERR_PrintError(err, errStr);
 		return err;
 	}
@@ -93,139 +140,982 @@ UINT32 FM_ValidateFieldVector( std::vector<Field_BinField *> &fields, Field_Imag
 	return STS_OK;
 }
 
+void FM_KeepEncodedFields( bool keep )
+{
+	IsKeepingEncoded = keep;
+	if (!keep)
+	{
+		EncodedFields.clear();
+	}
+}
+
+// the encoding of a field changes its content: an encryption, or an ECC other than copies of the content
+static bool FM_IsEncodingKept( Field_BinField *field )
+{
+	return IsKeepingEncoded && (field->isEncrypted() || (field->eccType != ECC_noECC && field->eccType != ECC_majorityRule));
+}
+
+//************************************
+// Function:  FM_GetEncodingKey - gets the key of an encoded field: the digest of its content and the settings
+//								 its encoding depends on
+// Returns:   std::string
+// Parameter: Field_BinField * field - its content is loaded
+//************************************
+static string FM_GetEncodingKey( Field_BinField *field )
+{
+	UINT8 digest[SHA256_DIGEST_SIZE];
+	SHA256_Context ctx;
+	SHA256_Init(ctx);
+	SHA256_Update(ctx, field->dataBuffer, (UINT32) field->size);
+	SHA256_Final(ctx, digest);
+
+	// the bytes the ECC does not write keep the padding value
+	stringstream key;
+	key.write((const char *) digest, sizeof(digest));
+	key << ":" << field->size << ":" << field->eccType << ":" << (UINT32) field->imageConfig->paddingValue;
+	if (field->isEncrypted())
+	{
+		const Field_Encryption &encryption = field->findSide()->encryption;
+		key << ":" << encryption.mode << ":" << encryption.sectorSize << ":";
+		key.write((const char *) encryption.iv, sizeof(encryption.iv));
+		key.write((const char *) encryption.key.data(), encryption.key.size());
+	}
+	return key.str();
+}
+
 //************************************
-// Function:  FM_CreateBinFile - creates the binary image, and writes it to the file
-//								 this is done field by field.
+// Function:  FM_EncodeField - encodes a field (of a non-zero size) into its location in the image
 // Returns:   UINT32
-// Parameter: std::vector<Field_BinField * > & fields
-// Parameter: Field_ImageProperties & imageConfig
-// Parameter: string fileName
-// Precondition: 
-//		1) Fields are sorted by location in the array, with no overlaps. 
-//		2) imageConfige.size is valid (i.e image is not smaller than all fields)
-//		* notice: these preconditions are tested by FM_ValidateFieldVector
+// Parameter: Field_BinField * field
+// Parameter: UINT8 * fieldImage - the field area, in the image or in a buffer of the encoded size
 //************************************
-UINT32 FM_CreateBinFile( std::vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig, string fileName)
+static UINT32 FM_EncodeField( Field_BinField *field, UINT8 *fieldImage )
 {
-	UINT32 err = 0;
-	// temporary buffer that will hold data to be passed to file stream
-	UINT8 *tempBuff;
+	UINT32 err = STS_OK;
+
+	bool encrypt = field->isEncrypted();
+	if (field->eccType == ECC_noECC)
+	{
+		//in this case the data stays intact, so copy the buffer directly from the field object (or its file)
+		err = field->readContent(0, fieldImage, field->size);
+		if (encrypt && err == STS_OK)
+		{
+			err = field->findSide()->encryption.encrypt(fieldImage, (UINT32) field->size);
+		}
+	} 
+	else 
+	{
+		err = field->loadContent();
+		if (err)
+		{
+			return err;
+		}
+
+		{
+			// the field buffer keeps the plain content, the ECC is performed over an encrypted copy
+			UINT8 *data = field->dataBuffer;
+			vector<UINT8> encrypted;
+			if (encrypt)
+			{
+				encrypted.assign(field->dataBuffer, field->dataBuffer + field->size);
+				data = &encrypted[0];
+				err = field->findSide()->encryption.encrypt(data, (UINT32) field->size);
+				if (err)
+				{
+					return err;
+				}
+			}
+
+			// perform ECC (the field area is already filled with padding data)
+			err = ECC_performECC(field->eccType, data, fieldImage, (UINT32) field->size);
+			if (err)
+			{
+				printf("CRC failed offset %llu\n", field->offset);
+			}
+		}
+	}
 
-	// indicates current offset in image
-	UINT32 currentOffset = 0;
+	return err;
+}
+
+//************************************
+// Function:  FM_PlaceField - encodes a field into its location in the image, an encoding kept by a variant built
+//							 before (see FM_KeepEncodedFields) is copied
+// Returns:   UINT32
+// Parameter: Field_BinField * field
+// Parameter: UINT8 * fieldImage - the field area, in the image or in a buffer of the encoded size
+//************************************
+static UINT32 FM_PlaceField( Field_BinField *field, UINT8 *fieldImage )
+{
+	UINT32 err;
 
-	// open the output file for writing
-	ofstream outFile (fileName.c_str(), ofstream::binary);
-	if (!outFile.is_open())
+	if (field->size == 0)
+	{
+		return STS_OK;
+	}
+	if (!FM_IsEncodingKept(field))
+	{
+		return FM_EncodeField(field, fieldImage);
+	}
+
+	err = field->loadContent();
+	if (err)
 	{
-		err = ERR_FILE_ERROR;
-		string errStr = "Error creating or opening file " + fileName;
-		ERR_PrintError(err, errStr);
 		return err;
 	}
-	
-	// run through the fields, fill a temporary buffer encoded data, and then fill write data to the file
-	for (vector<Field_BinField *>::iterator it = fields.begin(); it != fields.end(); ++it)
+	string key = FM_GetEncodingKey(field);
+	UINT64 encodedSize = ECC_getTotalSize(field->size, field->eccType);
 	{
-		// if there is a space between the previous offset and the current one, fill it with padding
-		if ((*it)->offset > currentOffset)
+		std::lock_guard<std::mutex> lock(EncodedFieldsLock);
+		map<string, vector<UINT8> >::iterator found = EncodedFields.find(key);
+		if (found != EncodedFields.end())
 		{
-			UINT32 paddingSize = (*it)->offset - currentOffset;
-			tempBuff = new UINT8[paddingSize];
-			memset(tempBuff, imageConfig.paddingValue, paddingSize);
+			memcpy(fieldImage, &found->second[0], (size_t) encodedSize);
+			return STS_OK;
+		}
+	}
 
-			outFile.write((char *)tempBuff, paddingSize);
-			if (!outFile.good())
-			{
-				err = ERR_FILE_ERROR;
-				string errStr = "Error writing to file " + fileName;
-				ERR_PrintError(err, errStr);
-				break;
-			}
-			
-			currentOffset += paddingSize;
-			delete[] tempBuff;
+	err = FM_EncodeField(field, fieldImage);
+	if (err == STS_OK)
+	{
+		// two variants encoding the same field at once both encode it, the first is kept
+		std::lock_guard<std::mutex> lock(EncodedFieldsLock);
+		vector<UINT8> &encoded = EncodedFields[key];
+		if (encoded.empty())
+		{
+			encoded.assign(fieldImage, fieldImage + encodedSize);
 		}
+	}
+	return err;
+}
+
+//************************************
+// Function:  FM_CheckFieldMask - a field whose mask bit is not set in the compatible mask must be empty
+// Returns:   UINT32
+// Parameter: Field_BinField * field
+//************************************
+static UINT32 FM_CheckFieldMask( Field_BinField *field )
+{
+	if (!field->maskFound && !field->contentIsZero)
+	{
+		std::cout << "error encountered at " << field->name << ".content, error, the content is not empty while the mask in compatible bit is 0 " << endl;
+		return ERR_ILLEGAL_VAL;
+	}
+	return STS_OK;
+}
+
+// a nibble parity mask covers the whole byte, including its parity
+static ECC_Type FM_GetMaskEccType( Field_BinField *field )
+{
+	return (field->eccType == ECC_nibbleParity && field->maskFound) ? ECC_Mask_nibbleParity : field->eccType;
+}
+
+//************************************
+// Function:  FM_PlaceFieldMask - encodes the field mask into its location in the mask image.
+//								 A field without a mask is encoded as zeros.
+// Returns:   UINT32
+// Parameter: Field_BinField * field
+// Parameter: UINT8 * fieldImage - the field area, in the mask image or in a buffer of the encoded size
+//************************************
+static UINT32 FM_PlaceFieldMask( Field_BinField *field, UINT8 *fieldImage )
+{
+	UINT32 err = STS_OK;
+
+	if (field->size == 0)
+	{
+		return STS_OK;
+	}
+
+	err = FM_CheckFieldMask(field);
+	if (err)
+	{
+		return err;
+	}
+
+	vector<UINT8> zeros;
+	UINT8 *mask = field->maskBuffer;
+	if (!mask)
+	{
+		zeros.assign(field->size, 0x00);
+		mask = &zeros[0];
+	}
+
+	UINT64 encodedSize = ECC_getTotalSize(field->size, field->eccType);
+	if (field->eccType == ECC_noECC)
+	{
+		memcpy(fieldImage, mask, field->size);
+	}
+	else if (field->maskExists)
+	{
+		memset(fieldImage, 0xff, encodedSize);
+	}
+	else
+	{
+		err = ECC_performECC(FM_GetMaskEccType(field), mask, fieldImage, (UINT32) field->size);
+	}
 
-		if ((*it)->eccType == ECC_noECC)
+	return err;
+}
+
+//************************************
+// Function:  FM_GetComputedRange - finds the image range a computed field is calculated over
+// Returns:   UINT32
+// Parameter: Field_BinField * field - the computed field
+// Parameter: std::map<std::string, Field_BinField * > & fieldsByName - fields of the image (NULL for non-unique names)
+// Parameter: UINT64 imageSize
+// Parameter: UINT64 & start
+// Parameter: UINT64 & size
+//************************************
+static UINT32 FM_GetComputedRange( Field_BinField *field, map<string, Field_BinField *> &fieldsByName, UINT64 imageSize, UINT64 &start, UINT64 &size )
+{
+	UINT32 err;
+	UINT64 areaStart = 0;
+	UINT64 areaSize = imageSize;
+	const Field_SideSettings *computed = field->findSide();
+	const Field_Attributes &attributes = computed->computedAttributes;
+
+	// the range is given relative to another field, or to the image
+	if (computed->computedSource != "")
+	{
+		map<string, Field_BinField *>::iterator found = fieldsByName.find(computed->computedSource);
+		if (found == fieldsByName.end() || found->second == NULL)
 		{
-			//in this case the data stays intact, so copy the buffer directly from the field object
-			// (this could save some time and memory when the field data content is large
-			// and no ECC scheme is applied)
-			outFile.write((char *)(*it)->dataBuffer, (*it)->size);
-			if (!outFile.good())
-			{
-				err = ERR_FILE_ERROR;
-				string errStr = "Error writing to file '" + fileName + "'. field name:" + (*it)->name;
-				ERR_PrintError(err, errStr);
-				break;
-			}
+			err = ERR_ILLEGAL_VAL;
+			ERR_PrintError(err, field->name + ": field not found or not unique: " + computed->computedSource);
+			return err;
+		}
+		areaStart = found->second->offset;
+		areaSize = ECC_getTotalSize(found->second->size, found->second->eccType);
+	}
+
+	if (attributes.rangeOffset > areaSize || attributes.rangeSize > areaSize - attributes.rangeOffset)
+	{
+		err = ERR_ILLEGAL_VAL;
+		ERR_PrintError(err, field->name + ": range exceeds the area it is computed over");
+		return err;
+	}
+
+	start = areaStart + attributes.rangeOffset;
+	size = attributes.rangeSize ? attributes.rangeSize : (areaSize - attributes.rangeOffset);
+	return STS_OK;
+}
+
+/*
+	State of a computed field calculation, see FM_ComputeFields
+*/
+typedef struct FM_ComputeContext
+{
+	Field_BinField	*field;
+	UINT64			rangeStart;
+	UINT64			rangeSize;
+	UINT32			crc;
+	SHA256_Context	sha256;
+	SHA512_Context	sha512;
+	vector<UINT8>	value;		// set by FM_ComputeFinal
+}FM_ComputeContext;
+
+// computed fields are calculated together, over chunks of this size, so the image is read once
+const UINT32 FM_COMPUTE_CHUNK_SIZE = 0x10000;
+
+// a streamed image is built in chunks of this size, an image built with bounded memory in smaller ones
+const UINT64 FM_STREAM_CHUNK_SIZE = 0x100000;
+const UINT64 FM_STREAM_MIN_CHUNK_SIZE = 0x1000;
+
+static CRC_Type FM_GetCrcType( UINT32 format )
+{
+	if (format == Field_Attributes::attr_Crc16)
+	{
+		return CRC_crc16;
+	}
+	else if (format == Field_Attributes::attr_CrcCcitt)
+	{
+		return CRC_ccitt;
+	}
+	else if (format == Field_Attributes::attr_CrcDnp)
+	{
+		return CRC_dnp;
+	}
+	return CRC_crc32;
+}
+
+// the algorithm run over the range, a signature signs a digest
+static UINT32 FM_GetComputeFormat( const Field_Attributes &attributes )
+{
+	if (attributes.format_id == Field_Attributes::attr_Signature)
+	{
+		return attributes.digestFormat;
+	}
+	return attributes.format_id;
+}
+
+static void FM_ComputeInit( FM_ComputeContext &ctx )
+{
+	UINT32 format = FM_GetComputeFormat(ctx.field->findSide()->computedAttributes);
+
+	if (format == Field_Attributes::attr_Sha256)
+	{
+		SHA256_Init(ctx.sha256);
+	}
+	else if (format == Field_Attributes::attr_Sha512)
+	{
+		SHA512_Init(ctx.sha512);
+	}
+	else
+	{
+		ctx.crc = CRC_Init(FM_GetCrcType(format));
+	}
+}
+
+static void FM_ComputeUpdate( FM_ComputeContext &ctx, const UINT8 *data, UINT32 size )
+{
+	UINT32 format = FM_GetComputeFormat(ctx.field->findSide()->computedAttributes);
+
+	if (format == Field_Attributes::attr_Sha256)
+	{
+		SHA256_Update(ctx.sha256, data, size);
+	}
+	else if (format == Field_Attributes::attr_Sha512)
+	{
+		SHA512_Update(ctx.sha512, data, size);
+	}
+	else
+	{
+		ctx.crc = CRC_Update(FM_GetCrcType(format), ctx.crc, data, size);
+	}
+}
+
+// completes a computed field calculation, the value is not set to the field yet
+static void FM_ComputeFinal( FM_ComputeContext &ctx )
+{
+	UINT32 format = FM_GetComputeFormat(ctx.field->findSide()->computedAttributes);
+
+	if (format == Field_Attributes::attr_Sha256)
+	{
+		ctx.value.resize(SHA256_DIGEST_SIZE);
+		SHA256_Final(ctx.sha256, &ctx.value[0]);
+	}
+	else if (format == Field_Attributes::attr_Sha512)
+	{
+		ctx.value.resize(SHA512_DIGEST_SIZE);
+		SHA512_Final(ctx.sha512, &ctx.value[0]);
+	}
+	else
+	{
+		CRC_Type crcType = FM_GetCrcType(format);
+		UINT32 crc = CRC_Final(crcType, ctx.crc);
+		ctx.value.resize(CRC_getSize(crcType));
+		// little endian, lowest byte located at the first address
+		for (UINT32 i = 0; i < ctx.value.size(); ++i)
+		{
+			ctx.value[i] = (UINT8) (crc >> (8 * i));
+		}
+	}
+}
+
+//************************************
+// Function:  FM_SignComputedValues - replaces the digests of the Signature fields by their signatures.
+//								 All the signatures are requested together.
+// Returns:   UINT32
+// Parameter: std::vector<FM_ComputeContext> & contexts
+//************************************
+static UINT32 FM_SignComputedValues( std::vector<FM_ComputeContext> &contexts )
+{
+	UINT32 err;
+	vector<SIGN_Request> requests;
+	vector<FM_ComputeContext *> signedContexts;
+
+	for (vector<FM_ComputeContext>::iterator it = contexts.begin(); it != contexts.end(); ++it)
+	{
+		const Field_Attributes &attributes = it->field->findSide()->computedAttributes;
+		if (attributes.format_id == Field_Attributes::attr_Signature)
+		{
+			SIGN_Request request;
+			request.isLibrary = !attributes.signerLibrary.empty();
+			request.signer = request.isLibrary ? attributes.signerLibrary : attributes.signer;
+			request.hash = Field_Attributes::SupportedFormatAttr[attributes.digestFormat];
+			request.digest = it->value;
+			request.maxSize = (UINT32) it->field->size;
+			requests.push_back(request);
+			signedContexts.push_back(&(*it));
+		}
+	}
+
+	if (requests.empty())
+	{
+		return STS_OK;
+	}
+
+	err = SIGN_SignBatch(requests);
+	if (err)
+	{
+		return err;
+	}
+
+	for (UINT32 i = 0; i < requests.size(); ++i)
+	{
+		signedContexts[i]->value = requests[i].signature;
+	}
+	return STS_OK;
+}
+
+//************************************
+// Function:  FM_SetComputedValue - sets a computed value as the field content
+// Returns:   UINT32
+// Parameter: FM_ComputeContext & ctx
+//************************************
+static UINT32 FM_SetComputedValue( FM_ComputeContext &ctx )
+{
+	UINT32 err;
+	Field_BinField *field = ctx.field;
+
+	if (field->size < ctx.value.size())
+	{
+		err = ERR_BAD_FIELD_SIZE;
+		stringstream errStr;
+		errStr << field->name << ": field size " << field->size << " is smaller than the " 
+			   << Field_Attributes::SupportedFormatAttr[field->findSide()->computedAttributes.format_id] << " size " << ctx.value.size();
+		ERR_PrintError(err, errStr.str());
+		return err;
+	}
+
+	if (!ctx.value.empty())
+	{
+		memcpy(field->dataBuffer, &ctx.value[0], ctx.value.size());
+	}
+	if (field->findSide()->computedAttributes.reversed)
+	{
+		std::reverse(field->dataBuffer, field->dataBuffer + field->size);
+	}
+	return STS_OK;
+}
 
-			currentOffset += (*it)->size;
-		} 
-		else 
+//************************************
+// Function:  FM_ComputeFields - sets the computed fields (Crc32, Sha256, Signature...) over the built image.
+//								 A computed field located inside the range of another one is set first.
+//								 Fields which do not depend on each other are calculated in a single
+//								 pass over the image, chunk by chunk.
+// Returns:   UINT32
+// Parameter: std::vector<Field_BinField * > & fields
+// Parameter: std::vector<UINT8> & image
+//************************************
+static UINT32 FM_ComputeFields( std::vector<Field_BinField *> &fields, std::vector<UINT8> &image )
+{
+	UINT32 err;
+	vector<FM_ComputeContext> pending;
+	map<string, Field_BinField *> fieldsByName;
+
+	for (vector<Field_BinField *>::iterator it = fields.begin(); it != fields.end(); ++it)
+	{
+		fieldsByName[(*it)->name] = fieldsByName.count((*it)->name) ? NULL : (*it);
+		if ((*it)->isComputed)
 		{
-			
-			// calculate post-encoding size
-			UINT32 tempBuffSize = ECC_getTotalSize((*it)->size, (*it)->eccType);
+			FM_ComputeContext ctx;
+			ctx.field = *it;
+			pending.push_back(ctx);
+		}
+	}
 
-			// allocate buffer
-			tempBuff = new UINT8[tempBuffSize];
+	for (vector<FM_ComputeContext>::iterator it = pending.begin(); it != pending.end(); ++it)
+	{
+		err = FM_GetComputedRange(it->field, fieldsByName, image.size(), it->rangeStart, it->rangeSize);
+		if (err)
+		{
+			return err;
+		}
+	}
 
-			
-			if ((*it)->maskExists == true && isMaskRequested)
+	while (!pending.empty())
+	{
+		// take the fields whose range does not contain other pending computed fields
+		vector<FM_ComputeContext> ready;
+		vector<FM_ComputeContext> waiting;
+		for (UINT32 i = 0; i < pending.size(); ++i)
+		{
+			bool isReady = true;
+			for (UINT32 j = 0; j < pending.size() && isReady; ++j)
+			{
+				UINT64 otherStart = pending[j].field->offset;
+				UINT64 otherEnd = otherStart + ECC_getTotalSize(pending[j].field->size, pending[j].field->eccType);
+				if (j != i && otherStart < pending[i].rangeStart + pending[i].rangeSize && pending[i].rangeStart < otherEnd)
+				{
+					isReady = false;
+				}
+			}
+			if (isReady)
 			{
-				// fill buffer with padding data
-				memset(tempBuff, 0xff, tempBuffSize);
+				ready.push_back(pending[i]);
 			}
 			else
 			{
-				// fill buffer with padding data
-				memset(tempBuff, imageConfig.paddingValue, tempBuffSize);
-				// perform ECC
-				err = ECC_performECC((*it)->eccType, (*it)->dataBuffer, tempBuff, tempBuffSize, currentOffset);
-				if (err)
+				waiting.push_back(pending[i]);
+			}
+		}
+
+		if (ready.empty())
+		{
+			err = ERR_ILLEGAL_VAL;
+			ERR_PrintError(err, "computed fields depend on each other's ranges");
+			return err;
+		}
+
+		// one pass over the union of the ranges
+		UINT64 start = ready[0].rangeStart;
+		UINT64 end = ready[0].rangeStart + ready[0].rangeSize;
+		for (vector<FM_ComputeContext>::iterator it = ready.begin(); it != ready.end(); ++it)
+		{
+			FM_ComputeInit(*it);
+			start = MIN(start, it->rangeStart);
+			end = MAX(end, it->rangeStart + it->rangeSize);
+		}
+		for (UINT64 chunkStart = start; chunkStart < end; chunkStart += MIN((UINT64) FM_COMPUTE_CHUNK_SIZE, end - chunkStart))
+		{
+			UINT64 chunkEnd = chunkStart + MIN((UINT64) FM_COMPUTE_CHUNK_SIZE, end - chunkStart);
+			for (vector<FM_ComputeContext>::iterator it = ready.begin(); it != ready.end(); ++it)
+			{
+				UINT64 updateStart = MAX(chunkStart, it->rangeStart);
+				UINT64 updateEnd = MIN(chunkEnd, it->rangeStart + it->rangeSize);
+				if (updateStart < updateEnd)
 				{
-					printf("CRC failed offset %d\n", currentOffset);
-					break;
+					FM_ComputeUpdate(*it, &image[updateStart], (UINT32) (updateEnd - updateStart));
 				}
+			}
+		}
 
+		for (vector<FM_ComputeContext>::iterator it = ready.begin(); it != ready.end(); ++it)
+		{
+			FM_ComputeFinal(*it);
+		}
+		err = FM_SignComputedValues(ready);
+		if (err)
+		{
+			return err;
+		}
+		for (vector<FM_ComputeContext>::iterator it = ready.begin(); it != ready.end(); ++it)
+		{
+			err = FM_SetComputedValue(*it);
+			if (err == STS_OK)
+			{
+				err = FM_PlaceField(it->field, &image[it->field->offset]);
 			}
-			
-			// write buffer to file
-			outFile.write((char *)tempBuff, tempBuffSize);
-			if (!outFile.good())
+			if (err)
 			{
-				err = ERR_FILE_ERROR;
-				string errStr = "Error writing to file " + fileName;
-				ERR_PrintError(err, errStr);
-				break;
+				return err;
 			}
-			// release buffer and prepare for next vector
-			currentOffset += tempBuffSize;
-			delete[] tempBuff;
 		}
+
+		pending = waiting;
 	}
 
-	// if everything so far was OK, and did not reach the end of the image, fill the rest of it with padding
-	if ((err == STS_OK) && (currentOffset < imageConfig.size))
+	return STS_OK;
+}
+
+//************************************
+// Function:  FM_GetExtents - gets the ranges of the image taken by the fields, adjacent fields are merged
+// Returns:   std::vector<OUT_Extent>
+// Parameter: std::vector<Field_BinField * > & fields - sorted by offset
+//************************************
+static vector<OUT_Extent> FM_GetExtents( std::vector<Field_BinField *> &fields )
+{
+	vector<OUT_Extent> extents;
+
+	for (vector<Field_BinField *>::iterator it = fields.begin(); it != fields.end(); ++it)
 	{
-		UINT32 tempBuffSize = imageConfig.size - currentOffset;
-		tempBuff = new UINT8[tempBuffSize];
-		memset(tempBuff, imageConfig.paddingValue, tempBuffSize);
-		// write buffer to file
-		outFile.write((char *)tempBuff, tempBuffSize);
-		if (!outFile.good())
+		OUT_Extent extent;
+		extent.offset = (*it)->offset;
+		extent.size = ECC_getTotalSize((*it)->size, (*it)->eccType);
+		if (extent.size == 0)
 		{
-			err = ERR_FILE_ERROR;
-			string errStr = "Error writing to file " + fileName;
-			ERR_PrintError(err, errStr);
+			continue;
+		}
+
+		if (!extents.empty() && extents.back().offset + extents.back().size >= extent.offset)
+		{
+			UINT64 end = MAX(extents.back().offset + extents.back().size, extent.offset + extent.size);
+			extents.back().size = end - extents.back().offset;
+		}
+		else
+		{
+			extents.push_back(extent);
+		}
+	}
+	return extents;
+}
+
+//************************************
+// Function:  FM_CreateBinImages - creates the binary image and/or the mask image in memory, in a single
+//								 pass over the fields. ECC encoded fields are encoded directly into the images.
+//								 Computed fields (Crc32...) are set once all other fields are placed.
+// Returns:   UINT32
+// Parameter: std::vector<Field_BinField * > & fields
+// Parameter: Field_ImageProperties & imageConfig
+// Parameter: std::vector<UINT8> * image - NULL if not requested
+// Parameter: std::vector<UINT8> * maskImage - NULL if not requested
+// Precondition: 
+//		1) Fields are sorted by location in the array, with no overlaps. 
+//		2) imageConfige.size is valid (i.e image is not smaller than all fields)
+//		* notice: these preconditions are tested by FM_ValidateFieldVector
+//************************************
+UINT32 FM_CreateBinImages( std::vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig, std::vector<UINT8> *image,
+						   std::vector<UINT8> *maskImage )
+{
+	UINT32 err = 0;
+
+	// the gaps between the fields, and the rest of the image, are filled with padding
+	if (image)
+	{
+		image->assign(imageConfig.size, imageConfig.paddingValue);
+	}
+	if (maskImage)
+	{
+		maskImage->assign(imageConfig.size, imageConfig.paddingValue);
+	}
+
+	for (vector<Field_BinField *>::iterator it = fields.begin(); it != fields.end(); ++it)
+	{
+		if (image)
+		{
+			err = FM_PlaceField(*it, &(*image)[(*it)->offset]);
 		}
-		delete[] tempBuff;
+		if (err == STS_OK && maskImage)
+		{
+			err = FM_PlaceFieldMask(*it, &(*maskImage)[(*it)->offset]);
+		}
+		if (err)
+		{
+			return err;
+		}
+	}
+
+	// the mask of a computed field is taken from the XML, only the image is computed
+	return image ? FM_ComputeFields(fields, *image) : STS_OK;
+}
+
+UINT32 FM_CreateBinImage( std::vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig, std::vector<UINT8> &image)
+{
+	return FM_CreateBinImages(fields, imageConfig, &image, NULL);
+}
+
+//************************************
+// Function:  FM_AddMapGap - adds the gap up to the given offset, if there is one
+// Returns:   void
+// Parameter: OUT_Map & map
+// Parameter: UINT64 end
+//************************************
+static void FM_AddMapGap( OUT_Map &map, UINT64 end )
+{
+	UINT64 start = map.entries.empty() ? 0 : map.entries.back().offset + map.entries.back().eccSize;
+	if (end > start)
+	{
+		OUT_MapEntry gap;
+		gap.isGap = true;
+		gap.offset = start;
+		gap.size = end - start;
+		gap.eccSize = end - start;
+		gap.sourceOffset = 0;
+		map.entries.push_back(gap);
+	}
+}
+
+//************************************
+// Function:  FM_GetMap - describes the fields, and the gaps between them, for the layout map.
+//						  The digests are set when the image is written.
+// Returns:   OUT_Map
+// Parameter: std::vector<Field_BinField * > & fields - sorted by offset
+// Parameter: UINT64 imageSize
+//************************************
+static OUT_Map FM_GetMap( std::vector<Field_BinField *> &fields, UINT64 imageSize )
+{
+	OUT_Map map;
+	map.imageSize = imageSize;
 
+	for (vector<Field_BinField *>::iterator it = fields.begin(); it != fields.end(); ++it)
+	{
+		FM_AddMapGap(map, (*it)->offset);
+
+		OUT_MapEntry entry;
+		entry.isGap = false;
+		entry.name = (*it)->name;
+		entry.offset = (*it)->offset;
+		entry.size = (*it)->size;
+		entry.eccSize = ECC_getTotalSize((*it)->size, (*it)->eccType);
+		entry.ecc = ECC_getName((*it)->eccType);
+		entry.sourceFile = (*it)->sourceFile;
+		entry.sourceOffset = (*it)->sourceOffset;
+		map.entries.push_back(entry);
+	}
+	FM_AddMapGap(map, imageSize);
+	return map;
+}
+
+// reads a chunk of the field content, or of its mask (a field without a mask buffer has a zero mask)
+static UINT32 FM_ReadFieldChunk( Field_BinField *field, bool isMask, UINT64 position, UINT8 *buff, UINT64 count )
+{
+	if (!isMask)
+	{
+		return field->readContent(position, buff, count);
+	}
+	if (field->maskBuffer)
+	{
+		memcpy(buff, field->maskBuffer + position, (size_t) count);
+	}
+	else
+	{
+		memset(buff, 0x00, (size_t) count);
+	}
+	return STS_OK;
+}
+
+//************************************
+// Function:  FM_StreamField - writes a field (or its mask) to a streamed image, chunk by chunk: the content is
+//							   read and ECC encoded a chunk at a time, so a field is never held as a whole.
+//							   A content which is not changed by its ECC (none, majority rule) is written as is,
+//							   once for each copy. An encrypted field is encrypted and encoded as a whole, and so
+//							   is an encoded field kept for the other variants.
+// Returns:   UINT32
+// Parameter: OUT_Stream & stream
+// Parameter: Field_BinField * field
+// Parameter: bool isMask
+// Parameter: UINT64 maxMemory - bound on the buffers of the field (0 - no limit)
+//************************************
+static UINT32 FM_StreamField( OUT_Stream &stream, Field_BinField *field, bool isMask, UINT64 maxMemory )
+{
+	UINT32 err;
+	UINT32 encodedChunkSize;
+	UINT64 encodedSize = ECC_getTotalSize(field->size, field->eccType);
+	ECC_Type eccType = field->eccType;
+	ECC_Encoder encoder;
+	vector<UINT8> tail;
+
+	if (field->size == 0)
+	{
+		return STS_OK;
+	}
+
+	if (isMask)
+	{
+		err = FM_CheckFieldMask(field);
+		if (err)
+		{
+			return err;
+		}
+		if (eccType != ECC_noECC && field->maskExists)
+		{
+			return OUT_StreamFill(stream, 0xff, encodedSize);
+		}
+		eccType = FM_GetMaskEccType(field);
+	}
+
+	// a field which is not encoded, or the majority rule copies of a field, repeat the content as is:
+	// written from the content buffer, or copied from the content file, once for each copy
+	if ((eccType == ECC_noECC || eccType == ECC_majorityRule) && (isMask || !field->isEncrypted()))
+	{
+		UINT32 copies = ECC_encodePasses(eccType);
+		if (isMask && !field->maskBuffer)
+		{
+			return OUT_StreamFill(stream, 0x00, encodedSize);
+		}
+		if (!isMask && field->isStreamed)
+		{
+			return OUT_StreamCopy(stream, field->sourceFile, field->sourceOffset, field->size, copies);
+		}
+		return OUT_StreamRepeat(stream, isMask ? field->maskBuffer : field->dataBuffer, field->size, copies);
+	}
+
+	// an encrypted field is held as a whole, the SECDED check bytes are kept until the data is written
+	UINT64 keptSize = 0;
+	if (!isMask && field->isEncrypted())
+	{
+		keptSize = field->size + encodedSize;
+	}
+	else if (eccType == ECC_SECDED)
+	{
+		keptSize = encodedSize - field->size;
+	}
+	if (maxMemory && keptSize > maxMemory)
+	{
+		err = ERR_BAD_FIELD_SIZE;
+		stringstream errStr;
+		errStr << field->name << ": the field needs " << keptSize << " bytes of memory, more than the bound of " << maxMemory;
+		ERR_PrintError(err, errStr.str());
+		return err;
+	}
+
+	// as is a field the variants share (see FM_KeepEncodedFields), which is then encoded once
+	bool isKept = !isMask && FM_IsEncodingKept(field) && !field->isStreamed && (!maxMemory || encodedSize <= maxMemory);
+	if ((!isMask && field->isEncrypted()) || isKept)
+	{
+		vector<UINT8> encoded((size_t) encodedSize, field->imageConfig->paddingValue);
+		err = FM_PlaceField(field, &encoded[0]);
+		if (err)
+		{
+			return err;
+		}
+		return OUT_StreamWrite(stream, &encoded[0], encodedSize);
+	}
+
+	UINT64 chunkSize = maxMemory ? MAX(MIN(FM_STREAM_CHUNK_SIZE, maxMemory / 8), FM_STREAM_MIN_CHUNK_SIZE) : FM_STREAM_CHUNK_SIZE;
+	vector<UINT8> chunk((size_t) MIN(field->size, chunkSize));
+	vector<UINT8> encoded(chunk.size() * ECC_MAX_CHUNK_EXPANSION);
+
+	ECC_encodeInit(encoder, eccType, field->size);
+	for (UINT64 position = 0; position < field->size; position += chunk.size())
+	{
+		UINT64 count = MIN(field->size - position, (UINT64) chunk.size());
+		err = FM_ReadFieldChunk(field, isMask, position, &chunk[0], count);
+		if (err == STS_OK)
+		{
+			err = ECC_encodeChunk(encoder, &chunk[0], (UINT32) count, &encoded[0], encodedChunkSize);
+		}
+		if (err == STS_OK)
+		{
+			err = OUT_StreamWrite(stream, &encoded[0], encodedChunkSize);
+		}
+		if (err)
+		{
+			return err;
+		}
+	}
+
+	err = ECC_encodeFinish(encoder, tail);
+	if (err == STS_OK && !tail.empty())
+	{
+		err = OUT_StreamWrite(stream, &tail[0], tail.size());
 	}
-	outFile.close();
 	return err;
+}
+
+//************************************
+// Function:  FM_StreamImage - writes the bin image (or the mask image) field by field, the padding
+//							   between the fields is written without being built in memory
+// Returns:   UINT32
+// Parameter: std::vector<Field_BinField * > & fields - sorted by offset
+// Parameter: Field_ImageProperties & imageConfig
+// Parameter: const std::string & fileName - empty to compute the map digests only
+// Parameter: bool isMask
+// Parameter: OUT_Map * map - NULL if not requested
+// Parameter: UINT64 maxMemory - bound on the memory used (0 - no limit)
+//************************************
+static UINT32 FM_StreamImage( std::vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig, const std::string &fileName,
+							  bool isMask, OUT_Map *map, UINT64 maxMemory )
+{
+	UINT32 err;
+	OUT_Stream stream;
+	UINT64 position = 0;
 
+	err = OUT_StreamOpen(stream, fileName, map);
+	for (vector<Field_BinField *>::iterator it = fields.begin(); it != fields.end() && err == STS_OK; ++it)
+	{
+		err = OUT_StreamFill(stream, imageConfig.paddingValue, (*it)->offset - position);
+		if (err == STS_OK)
+		{
+			err = FM_StreamField(stream, *it, isMask, maxMemory);
+		}
+		position = (*it)->offset + ECC_getTotalSize((*it)->size, (*it)->eccType);
+	}
+	if (err == STS_OK)
+	{
+		err = OUT_StreamFill(stream, imageConfig.paddingValue, imageConfig.size - position);
+	}
+	if (err == STS_OK)
+	{
+		err = OUT_StreamClose(stream);
+	}
+	else
+	{
+		OUT_StreamAbort(stream);
+	}
+	return err;
 }
 
+//************************************
+// Function:  FM_CreateOutputFiles - creates the requested images and map, building the images together
+// Returns:   UINT32
+// Parameter: std::vector<Field_BinField * > & fields
+// Parameter: Field_ImageProperties & imageConfig
+// Parameter: const FM_OutputFiles & outputs
+// Precondition: same as FM_CreateBinImages
+//************************************
+UINT32 FM_CreateOutputFiles( std::vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig, const FM_OutputFiles &outputs )
+{
+	UINT32 err;
+	vector<UINT8> image;
+	vector<UINT8> maskImage;
+	bool mapRequested = !outputs.mapFile.empty();
+	bool imageRequested = !outputs.imageFile.empty() || mapRequested; // the map describes the data image
+	bool maskRequested = !outputs.maskFile.empty();
+	OUT_Map map;
+
+	// the map (and the digests it holds) is not built unless it is written
+	if (mapRequested)
+	{
+		map = FM_GetMap(fields, imageConfig.size);
+	}
+
+	// a bin image is streamed, unless computed fields need the whole image
+	bool isStreamed = (outputs.format == OUT_bin);
+	for (vector<Field_BinField *>::iterator it = fields.begin(); it != fields.end(); ++it)
+	{
+		isStreamed = isStreamed && !(*it)->isComputed;
+	}
+	if (isStreamed)
+	{
+		// the mask is checked first, so no image is written for a bad mask
+		err = maskRequested ? FM_StreamImage(fields, imageConfig, outputs.maskFile, true, NULL, outputs.maxMemory) : STS_OK;
+		if (err == STS_OK && imageRequested)
+		{
+			err = FM_StreamImage(fields, imageConfig, outputs.imageFile, false, mapRequested ? &map : NULL, outputs.maxMemory);
+		}
+		if (err == STS_OK && mapRequested)
+		{
+			err = OUT_WriteMap(map, outputs.mapFile);
+		}
+		return err;
+	}
+
+	// the images are built in memory, each of the image size
+	UINT64 imagesSize = imageConfig.size * ((imageRequested ? 1 : 0) + (maskRequested ? 1 : 0));
+	if (outputs.maxMemory && imagesSize > outputs.maxMemory)
+	{
+		err = ERR_IMAGE_TOO_LARGE;
+		stringstream errStr;
+		errStr << "the image is built in memory (" << (outputs.format == OUT_bin ? "it has computed fields" : "the format is not bin")
+			   << "), it needs " << imagesSize << " bytes, more than the bound of " << outputs.maxMemory;
+		ERR_PrintError(err, errStr.str());
+		return err;
+	}
+
+	err = FM_CreateBinImages(fields, imageConfig, imageRequested ? &image : NULL, maskRequested ? &maskImage : NULL);
+	if (err)
+	{
+		return err;
+	}
+
+	// the map digests are computed while the image is written
+	vector<OUT_Extent> extents = FM_GetExtents(fields);
+	if (!outputs.imageFile.empty())
+	{
+		err = OUT_WriteImage(outputs.format, image, extents, outputs.imageFile, mapRequested ? &map : NULL);
+		if (err)
+		{
+			return err;
+		}
+	}
+	if (maskRequested)
+	{
+		err = OUT_WriteImage(outputs.format, maskImage, extents, outputs.maskFile, NULL);
+		if (err)
+		{
+			return err;
+		}
+	}
+	if (mapRequested)
+	{
+		if (outputs.imageFile.empty())
+		{
+			OUT_DigestImage(image, map);
+		}
+		err = OUT_WriteMap(map, outputs.mapFile);
+	}
+
+	return err;
+}
@@ -17,11 +17,15 @@
 #include <string>
 #include <vector>
 #include "fields.h"
+#include "output.h"
 
 
 // FM=File Maker
 
-bool   FM_binFieldSortFunctionHandler(Field_BinField *f1, Field_BinField *f2);
+/*
+	Sorts the fields by offset, fields of the same offset keep their order
+*/
+void   FM_SortFields(std::vector<Field_BinField *> &fields);
 
 /*
 	Validate the following parameters:
@@ -31,8 +35,38 @@ bool   FM_binFieldSortFunctionHandler(Field_BinField *f1, Field_BinField *f2);
 UINT32 FM_ValidateFieldVector(std::vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig);
 
 /*
-	Creates the binary image into a file
+	The files created from the fields, an empty name is not created
+*/
+typedef struct FM_OutputFiles
+{
+	std::string	imageFile;
+	std::string	maskFile;		// the programming mask of the image
+	std::string	mapFile;		// layout map
+	OUT_Format	format;			// of the image and mask files
+	UINT64		maxMemory;		// bound on the memory used to build the images (0 - no limit)
+}FM_OutputFiles;
+
+/*
+	Creates the binary image and/or its mask in memory (NULL - not requested), in a single pass over the fields
+*/
+UINT32 FM_CreateBinImages(std::vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig, std::vector<UINT8> *image,
+						  std::vector<UINT8> *maskImage);
+
+/*
+	Creates the binary image in memory
+*/
+UINT32 FM_CreateBinImage(std::vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig, std::vector<UINT8> &image);
+
+/*
+	Creates the requested files: the image and the mask (in the given format), and the map
+*/
+UINT32 FM_CreateOutputFiles(std::vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig, const FM_OutputFiles &outputs);
+
+/*
+	Keeps the ECC encoded and encrypted fields by their content and encoding, so that the variants built in a run
+	(see MTX_BuildVariants) encode a field they share once. Thread safe, the kept fields are released when it is
+	turned off.
 */
-UINT32 FM_CreateBinFile(std::vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig, std::string fileName);
+void   FM_KeepEncodedFields(bool keep);
 
 #endif // FILE_MAKER_H
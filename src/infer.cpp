@@ -0,0 +1,475 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include "infer.h"
+#include "errors.h"
+#include "utilities.h"
+
+using namespace std;
+
+// shorter runs of the pad value are taken as data
+const UINT32 INF_MIN_PAD_RUN = 64;
+
+// a size word is looked for in the first bytes of a data region, with the payload starting aligned after it
+const UINT32 INF_MAX_HEADER_SIZE = 0x200;
+const UINT32 INF_PAYLOAD_ALIGN = 0x10;
+const UINT32 INF_MIN_PAYLOAD_SIZE = 0x10;
+
+// true if one of the bytes of the 64 bit word is zero
+#define INF_HAS_ZERO_BYTE(x)	((((x) - 0x0101010101010101ULL) & ~(x) & 0x8080808080808080ULL) != 0)
+
+/*
+	A known header: its start tag, and where it keeps the size of the code which follows it
+*/
+typedef struct INF_Tag
+{
+	const char	*name;
+	UINT8		tag[8];
+	UINT32		tagSize;
+	UINT32		sizeWordOffset;		// of the code size, 0 - the tag is not followed by code
+	UINT32		headerSize;			// the code starts right after the header
+}INF_Tag;
+
+static const INF_Tag INF_KnownTags[] =
+{
+	{"BootBlock",	{0x50, 0x07, 0x55, 0xAA, 0x54, 0x4F, 0x4F, 0x42}, 8, 0x144, 0x200},	// BootBlockHeader.xml
+	{"UbootBlk",	{0x55, 0x42, 0x4F, 0x4F, 0x54, 0x42, 0x4C, 0x4B}, 8, 0x144, 0x200},	// ubootHeader.xml
+	{"CpBoot",		{0x43, 0x50, 0x42, 0x4F, 0x4F, 0x54}, 6, 0, 0},						// CP tag, in the BootBlock header
+};
+const UINT32 INF_NUM_OF_TAGS = sizeof(INF_KnownTags) / sizeof(INF_KnownTags[0]);
+
+typedef struct INF_Range
+{
+	UINT64	offset;
+	UINT64	size;
+}INF_Range;
+
+typedef struct INF_TagHit
+{
+	UINT64			offset;
+	const INF_Tag	*tag;
+}INF_TagHit;
+
+typedef enum INF_FieldType
+{
+	INF_tagField,		// the bytes of a known tag
+	INF_sizeField,		// the size of another field
+	INF_dataField		// content taken from the image
+}INF_FieldType;
+
+typedef struct INF_Field
+{
+	std::string		name;
+	INF_FieldType	type;
+	UINT64			offset;
+	UINT64			size;
+	std::string		sizeOf;		// INF_sizeField: the field whose size it holds
+	const INF_Tag	*tag;		// INF_tagField
+}INF_Field;
+
+
+static UINT32 INF_ReadWord( const vector<UINT8> &image, UINT64 offset )
+{
+	return image[offset] | (image[offset + 1] << 8) | (image[offset + 2] << 16) | ((UINT32) image[offset + 3] << 24);
+}
+
+static string INF_Hex( UINT64 value )
+{
+	stringstream str;
+	str << "0x" << hex << uppercase << value;
+	return str.str();
+}
+
+static string INF_XmlEscape( const string &str )
+{
+	string text;
+	for (string::const_iterator c = str.begin(); c != str.end(); ++c)
+	{
+		switch (*c)
+		{
+		case '&':	text += "&amp;";	break;
+		case '<':	text += "&lt;";		break;
+		case '>':	text += "&gt;";		break;
+		case '\'':	text += "&apos;";	break;
+		default:	text += *c;			break;
+		}
+	}
+	return text;
+}
+
+static void INF_AddField( vector<INF_Field> &fields, const string &name, INF_FieldType type, UINT64 offset, UINT64 size )
+{
+	if (size == 0)
+	{
+		return;
+	}
+	INF_Field field;
+	field.name = name;
+	field.type = type;
+	field.offset = offset;
+	field.size = size;
+	field.tag = NULL;
+	fields.push_back(field);
+}
+
+//************************************
+// Function:  INF_FindPadRuns - finds the runs of the pad value, the image is scanned 8 bytes at a time
+// Returns:   std::vector<INF_Range> - the runs of at least INF_MIN_PAD_RUN bytes, sorted by offset
+// Parameter: const vector<UINT8> & image
+// Parameter: UINT8 pad
+//************************************
+static vector<INF_Range> INF_FindPadRuns( const vector<UINT8> &image, UINT8 pad )
+{
+	vector<INF_Range> runs;
+	UINT64 size = image.size();
+	UINT64 runStart = 0;
+	bool inRun = false;
+	UINT64 padWord;
+	memset(&padWord, pad, sizeof(padWord));
+
+	for (UINT64 i = 0; i <= size; )
+	{
+		bool isPad;
+		UINT32 step = 1;
+
+		if (i == size)
+		{
+			isPad = false;
+		}
+		else if ((i & 7) == 0 && i + 8 <= size)
+		{
+			UINT64 word;
+			memcpy(&word, &image[i], sizeof(word));
+			word ^= padWord;
+			if (word == 0 || !INF_HAS_ZERO_BYTE(word))
+			{
+				// all pad, or no pad at all
+				isPad = (word == 0);
+				step = 8;
+			}
+			else
+			{
+				isPad = (image[i] == pad);
+			}
+		}
+		else
+		{
+			isPad = (image[i] == pad);
+		}
+
+		if (isPad && !inRun)
+		{
+			inRun = true;
+			runStart = i;
+		}
+		else if (!isPad && inRun)
+		{
+			inRun = false;
+			if (i - runStart >= INF_MIN_PAD_RUN)
+			{
+				INF_Range run = {runStart, i - runStart};
+				runs.push_back(run);
+			}
+		}
+		i += step;
+	}
+	return runs;
+}
+
+//************************************
+// Function:  INF_FindTags - finds the known tags. Each tag is searched for by its first byte with memchr,
+//							 which is vectorized by the C library, and compared where the byte is found.
+// Returns:   std::vector<INF_TagHit> - sorted by offset
+// Parameter: const vector<UINT8> & image
+//************************************
+static vector<INF_TagHit> INF_FindTags( const vector<UINT8> &image )
+{
+	vector<INF_TagHit> hits;
+	if (image.empty())
+	{
+		return hits;
+	}
+
+	const UINT8 *end = &image[0] + image.size();
+	for (UINT32 t = 0; t < INF_NUM_OF_TAGS; ++t)
+	{
+		const INF_Tag *tag = &INF_KnownTags[t];
+		const UINT8 *position = &image[0];
+		while ((position = (const UINT8 *) memchr(position, tag->tag[0], end - position)) != NULL)
+		{
+			if ((UINT32) (end - position) >= tag->tagSize && memcmp(position, tag->tag, tag->tagSize) == 0)
+			{
+				INF_TagHit hit = {(UINT64) (position - &image[0]), tag};
+				hits.push_back(hit);
+			}
+			++position;
+		}
+	}
+
+	sort(hits.begin(), hits.end(), [](const INF_TagHit &a, const INF_TagHit &b) { return a.offset < b.offset; });
+	return hits;
+}
+
+//************************************
+// Function:  INF_AddTaggedFields - describes the known headers and the code that follows them
+// Returns:   std::vector<INF_Range> - the claimed ranges, sorted by offset
+// Parameter: const vector<UINT8> & image
+// Parameter: vector<INF_Field> & fields
+//************************************
+static vector<INF_Range> INF_AddTaggedFields( const vector<UINT8> &image, vector<INF_Field> &fields )
+{
+	vector<INF_Range> claimed;
+	vector<INF_TagHit> hits = INF_FindTags(image);
+	UINT64 claimedEnd = 0;
+	UINT32 tagCount[INF_NUM_OF_TAGS] = {0};
+
+	for (vector<INF_TagHit>::iterator it = hits.begin(); it != hits.end(); ++it)
+	{
+		const INF_Tag *tag = it->tag;
+		UINT64 offset = it->offset;
+		if (offset < claimedEnd)
+		{
+			continue; // inside a header or code which was already found
+		}
+
+		stringstream prefix;
+		prefix << tag->name << ++tagCount[tag - INF_KnownTags];
+
+		INF_AddField(fields, prefix.str() + "_Tag", INF_tagField, offset, tag->tagSize);
+		fields.back().tag = tag;
+		UINT64 end = offset + tag->tagSize;
+
+		// the header is followed by code of the size kept in the header
+		if (tag->sizeWordOffset && offset + tag->headerSize <= image.size())
+		{
+			UINT32 codeSize = INF_ReadWord(image, offset + tag->sizeWordOffset);
+			if (codeSize > 0 && offset + tag->headerSize + codeSize <= image.size())
+			{
+				string codeName = prefix.str() + "_Code";
+				INF_AddField(fields, prefix.str() + "_Header", INF_dataField, offset + tag->tagSize, tag->sizeWordOffset - tag->tagSize);
+				INF_AddField(fields, prefix.str() + "_CodeSize", INF_sizeField, offset + tag->sizeWordOffset, 4);
+				fields.back().sizeOf = codeName;
+				INF_AddField(fields, prefix.str() + "_Header2", INF_dataField, offset + tag->sizeWordOffset + 4,
+							 tag->headerSize - tag->sizeWordOffset - 4);
+				INF_AddField(fields, codeName, INF_dataField, offset + tag->headerSize, codeSize);
+				end = offset + tag->headerSize + codeSize;
+			}
+		}
+
+		INF_Range range = {offset, end - offset};
+		claimed.push_back(range);
+		claimedEnd = end;
+	}
+	return claimed;
+}
+
+//************************************
+// Function:  INF_AddDataFields - describes a data region which is not a known header. If a word in its
+//								  first bytes holds the size of the payload which follows, the region is
+//								  split into a header, the size and the payload.
+// Returns:   void
+// Parameter: const vector<UINT8> & image
+// Parameter: vector<INF_Field> & fields
+// Parameter: const INF_Range & region
+// Parameter: UINT64 limit - the payload may extend over padding, up to here
+// Parameter: UINT32 index - of the region, for the field names
+//************************************
+static void INF_AddDataFields( const vector<UINT8> &image, vector<INF_Field> &fields, const INF_Range &region, UINT64 limit, UINT32 index )
+{
+	UINT64 start = region.offset;
+	UINT64 end = region.offset + region.size;
+	UINT64 headerEnd = MIN(end, start + INF_MAX_HEADER_SIZE);
+	stringstream prefix;
+	prefix << "Data" << index;
+
+	for (UINT64 word = start; word + 4 <= headerEnd; word += 4)
+	{
+		UINT32 payloadSize = INF_ReadWord(image, word);
+		if (payloadSize < INF_MIN_PAYLOAD_SIZE)
+		{
+			continue;
+		}
+
+		// the payload must cover the rest of the region, and may only add padding to it
+		for (UINT64 payload = start + ALIGN(word + 4 - start, INF_PAYLOAD_ALIGN); payload < headerEnd; payload += INF_PAYLOAD_ALIGN)
+		{
+			UINT64 payloadEnd = payload + payloadSize;
+			if (payloadEnd >= end && payloadEnd <= limit)
+			{
+				string payloadName = prefix.str() + "_Payload";
+				INF_AddField(fields, prefix.str() + "_Header", INF_dataField, start, word - start);
+				INF_AddField(fields, prefix.str() + "_Size", INF_sizeField, word, 4);
+				fields.back().sizeOf = payloadName;
+				INF_AddField(fields, prefix.str() + "_Header2", INF_dataField, word + 4, payload - word - 4);
+				INF_AddField(fields, payloadName, INF_dataField, payload, payloadSize);
+				return;
+			}
+		}
+	}
+
+	INF_AddField(fields, prefix.str(), INF_dataField, start, end - start);
+}
+
+static void INF_WriteXml( ofstream &xml, const vector<INF_Field> &fields, const string &imageFile, UINT64 imageSize, UINT8 pad )
+{
+	xml << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>" << endl
+		<< "<!-- inferred by bingo from " << INF_XmlEscape(imageFile) << ", a starting point to be reviewed -->" << endl
+		<< "<Bin_Ecc_Map>" << endl
+		<< "\t<ImageProperties>" << endl
+		<< "\t\t<BinSize>" << INF_Hex(imageSize) << "</BinSize>" << endl
+		<< "\t\t<PadValue>" << INF_Hex(pad) << "</PadValue>" << endl
+		<< "\t</ImageProperties>" << endl;
+
+	for (vector<INF_Field>::const_iterator it = fields.begin(); it != fields.end(); ++it)
+	{
+		xml << endl
+			<< "\t<BinField>" << endl
+			<< "\t\t<name>" << INF_XmlEscape(it->name) << "</name>" << endl
+			<< "\t\t<config>" << endl
+			<< "\t\t\t<offset>" << INF_Hex(it->offset) << "</offset>" << endl
+			<< "\t\t\t<size>" << INF_Hex(it->size) << "</size>" << endl
+			<< "\t\t</config>" << endl;
+
+		if (it->type == INF_tagField)
+		{
+			xml << "\t\t<content format='bytes'>";
+			for (UINT32 i = 0; i < it->tag->tagSize; ++i)
+			{
+				xml << (i ? " " : "") << "0x" << hex << uppercase << setfill('0') << setw(2) << (UINT32) it->tag->tag[i] << dec;
+			}
+			xml << "</content>" << endl;
+		}
+		else if (it->type == INF_sizeField)
+		{
+			xml << "\t\t<content format='FieldSize'>" << INF_XmlEscape(it->sizeOf) << "</content>" << endl;
+		}
+		else
+		{
+			xml << "\t\t<content format='FileContent' file_start_offset='" << INF_Hex(it->offset) << "'>"
+				<< INF_XmlEscape(imageFile) << "</content>" << endl;
+		}
+		xml << "\t</BinField>" << endl;
+	}
+	xml << "</Bin_Ecc_Map>" << endl;
+}
+
+UINT32 INF_InferLayout( const std::string &imageFile, const std::string &outXml )
+{
+	UINT32 err = STS_OK;
+
+	ifstream imageStream(imageFile.c_str(), ios::binary | ios::ate);
+	if (!imageStream.is_open())
+	{
+		string errStr = "Filename: " + imageFile;
+		ERR_PrintError(ERR_FILE_NOT_FOUND, errStr);
+		return ERR_FILE_NOT_FOUND;
+	}
+	UINT64 imageSize = (UINT64) imageStream.tellg();
+	vector<UINT8> image((size_t) imageSize);
+	imageStream.seekg(0);
+	if (imageSize > 0 && !imageStream.read((char *) &image[0], imageSize))
+	{
+		err = ERR_FILE_ERROR;
+		ERR_PrintError(err, "Error reading file " + imageFile);
+		return err;
+	}
+
+	// the pad value is the one (0x00 or 0xFF, flash erase value) which takes more of the image in long runs
+	vector<INF_Range> padRuns[2] = {INF_FindPadRuns(image, 0x00), INF_FindPadRuns(image, 0xFF)};
+	UINT64 padBytes[2] = {0, 0};
+	for (UINT32 p = 0; p < 2; ++p)
+	{
+		for (vector<INF_Range>::iterator it = padRuns[p].begin(); it != padRuns[p].end(); ++it)
+		{
+			padBytes[p] += it->size;
+		}
+	}
+	UINT32 padIndex = (padBytes[0] > padBytes[1]) ? 0 : 1;
+	UINT8 pad = padIndex ? 0xFF : 0x00;
+
+	vector<INF_Field> fields;
+	vector<INF_Range> claimed = INF_AddTaggedFields(image, fields);
+
+	// the data between the pad runs which is not claimed by a known header
+	vector<INF_Range> regions;
+	UINT64 position = 0;
+	vector<INF_Range> &runs = padRuns[padIndex];
+	for (UINT32 r = 0; r <= runs.size(); ++r)
+	{
+		UINT64 regionEnd = (r < runs.size()) ? runs[r].offset : imageSize;
+		size_t c = 0;
+		while (position < regionEnd)
+		{
+			// skip the claimed ranges
+			while (c < claimed.size() && claimed[c].offset + claimed[c].size <= position)
+			{
+				++c;
+			}
+			if (c < claimed.size() && claimed[c].offset <= position)
+			{
+				position = claimed[c].offset + claimed[c].size;
+				continue;
+			}
+			UINT64 end = (c < claimed.size()) ? MIN(regionEnd, claimed[c].offset) : regionEnd;
+			INF_Range region = {position, end - position};
+			regions.push_back(region);
+			position = end;
+		}
+		if (r < runs.size())
+		{
+			position = MAX(position, runs[r].offset + runs[r].size);
+		}
+	}
+
+	for (UINT32 r = 0; r < regions.size(); ++r)
+	{
+		// a payload may extend over padding, up to the next data
+		UINT64 limit = (r + 1 < regions.size()) ? regions[r + 1].offset : imageSize;
+		for (vector<INF_Range>::iterator it = claimed.begin(); it != claimed.end(); ++it)
+		{
+			if (it->offset >= regions[r].offset + regions[r].size)
+			{
+				limit = MIN(limit, it->offset);
+				break;
+			}
+		}
+		INF_AddDataFields(image, fields, regions[r], limit, r + 1);
+	}
+
+	sort(fields.begin(), fields.end(), [](const INF_Field &a, const INF_Field &b) { return a.offset < b.offset; });
+
+	ofstream xml(outXml.c_str());
+	if (!xml.is_open())
+	{
+		err = ERR_FILE_ERROR;
+		ERR_PrintError(err, "Error creating or opening file " + outXml);
+		return err;
+	}
+	INF_WriteXml(xml, fields, imageFile, imageSize, pad);
+	if (!xml.good())
+	{
+		err = ERR_FILE_ERROR;
+		ERR_PrintError(err, "Error writing to file " + outXml);
+	}
+	xml.close();
+
+	cout << fields.size() << " field(s) inferred, written to " << outXml << endl;
+	return err;
+}
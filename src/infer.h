@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#ifndef INFER_H
+#define INFER_H
+
+#include <string>
+#include "bingo_types.h"
+
+
+// INF=Layout inference
+
+/*
+	Scans an image with no XML for known header tags, padding runs and size words matching the payload
+	that follows them, and writes a Bin_Ecc_Map XML describing it. The contents are taken from the image
+	itself, so building the XML reproduces the image.
+*/
+UINT32 INF_InferLayout(const std::string &imageFile, const std::string &outXml);
+
+#endif // INFER_H
@@ -0,0 +1,883 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <cstring>
+#include <cctype>
+#include "errors.h"
+#include "utilities.h"
+#include "file_maker.h"
+#include "layout.h"
+#include "cache.h"
+
+#ifdef __LINUX_APP__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+
+// images of the layouts built so far, by XML file name (NULL while the layout is being built)
+static map<string, vector<UINT8> *> LayoutImages;
+
+// the layout variables (-D), by name
+static map<string, string> LayoutVariables;
+
+// the streamed XML is read in blocks of this size
+const UINT32 XML_STREAM_BLOCK_SIZE = 0x10000;
+
+/*
+	An XML file read as a stream: the text of the elements already handled is dropped as the file is read
+*/
+typedef struct XML_Stream
+{
+	ifstream		file;
+	vector<char>	buffer;		// text read from the file
+	size_t			position;	// in the buffer, of the first character not handled yet
+	UINT64			consumed;	// file offset of the buffer
+}XML_Stream;
+
+
+//************************************
+// Function:  XML_SubstituteText - replaces the ${NAME} variables in a text by their values
+// Returns:   UINT32 - an undefined variable is reported
+// Parameter: const char * text
+// Parameter: string & substituted
+//************************************
+static UINT32 XML_SubstituteText(const char *text, string &substituted)
+{
+	UINT32 err;
+	const char *start;
+
+	substituted.clear();
+	while ((start = strstr(text, "${")) != NULL)
+	{
+		const char *end = strchr(start + 2, '}');
+		if (end == NULL)
+		{
+			err = ERR_ILLEGAL_VAL;
+			ERR_PrintError(err, string("unterminated variable: ") + start);
+			return err;
+		}
+
+		map<string, string>::iterator found = LayoutVariables.find(string(start + 2, end));
+		if (found == LayoutVariables.end())
+		{
+			err = ERR_ILLEGAL_VAL;
+			ERR_PrintError(err, "undefined variable: " + string(start, end + 1));
+			return err;
+		}
+		substituted.append(text, start);
+		substituted += found->second;
+		text = end + 1;
+	}
+	substituted += text;
+	return STS_OK;
+}
+
+//************************************
+// Function:  XML_SubstituteVariables - replaces the variables in the text and in the attributes of an element
+//								 and of its child elements
+// Returns:   UINT32
+// Parameter: pugi::xml_node node
+//************************************
+static UINT32 XML_SubstituteVariables(pugi::xml_node node)
+{
+	UINT32 err;
+	string substituted;
+
+	for (pugi::xml_attribute attr = node.first_attribute(); attr; attr = attr.next_attribute())
+	{
+		if (strstr(attr.value(), "${") != NULL)
+		{
+			err = XML_SubstituteText(attr.value(), substituted);
+			if (err)
+			{
+				return err;
+			}
+			attr.set_value(substituted.c_str());
+		}
+	}
+
+	for (pugi::xml_node child = node.first_child(); child; child = child.next_sibling())
+	{
+		if (child.type() == pugi::node_element)
+		{
+			err = XML_SubstituteVariables(child);
+		}
+		else if (strstr(child.value(), "${") != NULL)
+		{
+			err = XML_SubstituteText(child.value(), substituted);
+			if (err == STS_OK)
+			{
+				child.set_value(substituted.c_str());
+			}
+		}
+		else
+		{
+			err = STS_OK;
+		}
+		if (err)
+		{
+			return err;
+		}
+	}
+	return STS_OK;
+}
+
+//************************************
+// Function:  XML_HandleElement - parses an element under the root into the image properties or into a new field
+// Returns:   UINT32 - errors are reported
+// Parameter: pugi::xml_node & node
+// Parameter: vector<Field_BinField * > & fields
+// Parameter: Field_ImageProperties & imageConfig
+//************************************
+static UINT32 XML_HandleElement(pugi::xml_node &node, vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig)
+{
+	UINT32 err;
+	INT32 element = FLD_FindKeyword(FLD_keywordElement, node.name());
+
+	// the variables are replaced before any value is parsed
+	err = XML_SubstituteVariables(node);
+	if (err)
+	{
+		ERR_PrintError(ERR_PARSING, string("error at node: ") + node.name());
+		return err;
+	}
+
+	if (element == FLD_elementImageProperties)
+	{	
+		err = imageConfig.handleElememtXML(node);	
+	}
+	else if (element == FLD_elementBinField)
+	{
+		Field_BinField *field = new Field_BinField(&imageConfig);
+		err = field->handleElememtXML(node);
+		fields.push_back(field);
+	} 
+	else
+	{
+		err = ERR_ILLEGAL_FIELD;
+		ERR_PrintError(ERR_ILLEGAL_FIELD, node.name());
+	}
+
+	if (err)
+	{
+		stringstream errStr;
+		errStr << "error at node: " << node.name() << "." << node.first_child().child_value();
+		ERR_PrintError(ERR_PARSING, errStr.str());
+	}
+	return err;
+}
+
+UINT32 XML_InputFileParser(pugi::xml_document &doc, vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig)
+{
+	
+	UINT32 err = 0;
+	// make sure the root element is valid
+	if (doc.first_child().name() != ROOT_DESCRIPTOR)
+	{
+		cout << doc.first_child().name() << " should be " << ROOT_DESCRIPTOR << endl;
+		return ERR_ILLEGAL_VAL;
+	}
+	
+	// avoiding recursion while assuming we now the structure of the xml_tree
+	pugi::xml_node fieldNode;
+	
+	// go on first level elements (i.e. fields)
+	fieldNode = doc.first_child();
+	for (pugi::xml_node_iterator it = fieldNode.begin(); it != fieldNode.end(); ++it)
+	{
+		err = XML_HandleElement(*it, fields, imageConfig);
+		if (err)
+		{
+			return err;
+		}
+	}
+	return STS_OK;
+}
+
+
+pugi::xml_parse_result XML_LoadFile(XML_File &file, const std::string &fileName)
+{
+	file.text = NULL;
+	file.size = 0;
+#ifdef __LINUX_APP__
+	// the file is mapped privately, only the pages the parser writes to are copied. It is not parsed faster than
+	// with load_file, but the text is not read into a heap buffer: the peak memory is lower by about the file size.
+	struct stat fileStat;
+	int fd = open(fileName.c_str(), O_RDONLY);
+	if (fd >= 0 && fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+	{
+		void *mapped = mmap(NULL, (size_t) fileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+		if (mapped != MAP_FAILED)
+		{
+			file.text = mapped;
+			file.size = (size_t) fileStat.st_size;
+		}
+	}
+	if (fd >= 0)
+	{
+		close(fd);
+	}
+	if (file.text)
+	{
+		return file.doc.load_buffer_inplace(file.text, file.size, XML_PARSE_OPTIONS);
+	}
+#endif
+	// read by pugixml into its own buffer, which is parsed in place as well
+	return file.doc.load_file(fileName.c_str(), XML_PARSE_OPTIONS);
+}
+
+void XML_CloseFile(XML_File &file)
+{
+	// the document refers to the text, it goes first
+	file.doc.reset();
+#ifdef __LINUX_APP__
+	if (file.text)
+	{
+		munmap(file.text, file.size);
+	}
+#endif
+	file.text = NULL;
+	file.size = 0;
+}
+
+
+/*
+	Streamed parsing
+*/
+
+//************************************
+// Function:  XML_StreamFill - makes sure the text from the position on holds at least the given number of characters,
+//							  reading more of the file as needed
+// Returns:   bool - false if the file ends first
+// Parameter: XML_Stream & stream
+// Parameter: size_t needed
+//************************************
+static bool XML_StreamFill(XML_Stream &stream, size_t needed)
+{
+	while (stream.buffer.size() - stream.position < needed)
+	{
+		if (stream.file.eof() || !stream.file.good())
+		{
+			return false;
+		}
+		// drop the consumed text before growing the buffer
+		if (stream.position > 0)
+		{
+			stream.buffer.erase(stream.buffer.begin(), stream.buffer.begin() + stream.position);
+			stream.consumed += stream.position;
+			stream.position = 0;
+		}
+		size_t size = stream.buffer.size();
+		stream.buffer.resize(size + XML_STREAM_BLOCK_SIZE);
+		stream.file.read(&stream.buffer[size], XML_STREAM_BLOCK_SIZE);
+		stream.buffer.resize(size + (size_t) stream.file.gcount());
+	}
+	return true;
+}
+
+//************************************
+// Function:  XML_StreamFind - finds a string in the text, reading more of the file as needed
+// Returns:   bool - false if the file ends first
+// Parameter: XML_Stream & stream
+// Parameter: size_t from - index (relative to the position) the search starts at
+// Parameter: const char * str
+// Parameter: size_t & found - index (relative to the position) of the string
+//************************************
+static bool XML_StreamFind(XML_Stream &stream, size_t from, const char *str, size_t &found)
+{
+	size_t length = strlen(str);
+	for (;;)
+	{
+		const char *begin = stream.buffer.data() + stream.position;
+		const char *end = stream.buffer.data() + stream.buffer.size();
+		if ((size_t) (end - begin) >= from + length)
+		{
+			const char *match = begin + from;
+			while ((match = (const char *) memchr(match, str[0], end - match)) != NULL && (size_t) (end - match) >= length)
+			{
+				if (memcmp(match, str, length) == 0)
+				{
+					found = match - begin;
+					return true;
+				}
+				++match;
+			}
+			// the string may start in the part not read yet
+			from = MAX(from, (size_t) (end - begin) - (length - 1));
+		}
+		if (!XML_StreamFill(stream, stream.buffer.size() - stream.position + 1))
+		{
+			return false;
+		}
+	}
+}
+
+// true if the text at the index (relative to the position) starts with the string, reads more of the file as needed
+static bool XML_StreamMatch(XML_Stream &stream, size_t index, const char *str)
+{
+	size_t length = strlen(str);
+	return XML_StreamFill(stream, index + length) && memcmp(&stream.buffer[stream.position + index], str, length) == 0;
+}
+
+//************************************
+// Function:  XML_StreamSkipMarkup - skips a comment, processing instruction, CDATA section or declaration
+// Returns:   bool - false if the text at the index is not such markup, or if it is not terminated
+// Parameter: XML_Stream & stream
+// Parameter: size_t & index - (relative to the position) of the markup, set past its end
+//************************************
+static bool XML_StreamSkipMarkup(XML_Stream &stream, size_t &index)
+{
+	const char *terminator;
+	size_t found;
+
+	if (XML_StreamMatch(stream, index, "<!--"))
+	{
+		terminator = "-->";
+	}
+	else if (XML_StreamMatch(stream, index, "<![CDATA["))
+	{
+		terminator = "]]>";
+	}
+	else if (XML_StreamMatch(stream, index, "<?"))
+	{
+		terminator = "?>";
+	}
+	else if (XML_StreamMatch(stream, index, "<!"))
+	{
+		terminator = ">";
+	}
+	else
+	{
+		return false;
+	}
+	if (!XML_StreamFind(stream, index + 2, terminator, found))
+	{
+		return false;
+	}
+	index = found + strlen(terminator);
+	return true;
+}
+
+//************************************
+// Function:  XML_StreamTagEnd - finds the end of the tag at the index, skipping quoted attribute values
+// Returns:   bool - false if the tag is not terminated
+// Parameter: XML_Stream & stream
+// Parameter: size_t & index - (relative to the position) of the tag, set past its end
+// Parameter: bool & isEmpty - the tag is an empty element tag (<name/>)
+//************************************
+static bool XML_StreamTagEnd(XML_Stream &stream, size_t &index, bool &isEmpty)
+{
+	char quote = 0;
+	size_t i = index + 1;
+	while (XML_StreamFill(stream, i + 1))
+	{
+		// scan the text read so far, then read more
+		const char *text = &stream.buffer[stream.position];
+		size_t available = stream.buffer.size() - stream.position;
+		for (; i < available; ++i)
+		{
+			char c = text[i];
+			if (quote)
+			{
+				quote = (c == quote) ? 0 : quote;
+			}
+			else if (c == '"' || c == '\'')
+			{
+				quote = c;
+			}
+			else if (c == '>')
+			{
+				isEmpty = (text[i - 1] == '/');
+				index = i + 1;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+//************************************
+// Function:  XML_StreamScanTags - scans the tags (and comments) already read, from the index on, counting the depth
+//								  of the elements
+// Returns:   bool - true if the depth got back to 0 (the index is then past the closing tag)
+// Parameter: const char * text - from the position
+// Parameter: size_t available - characters read from the position
+// Parameter: size_t & index - set to the first tag not scanned
+// Parameter: UINT32 & depth
+//************************************
+static bool XML_StreamScanTags(const char *text, size_t available, size_t &index, UINT32 &depth)
+{
+	const char *end = text + available;
+	const char *tag = text + index;
+
+	// most of an element is read in one block, its tags are scanned without the helpers above
+	while ((tag = (const char *) memchr(tag, '<', end - tag)) != NULL && end - tag >= 4)
+	{
+		const char *tagEnd = (const char *) memchr(tag, '>', end - tag);
+		if (tagEnd == NULL)
+		{
+			break;
+		}
+		if (tag[1] == '!' && tag[2] == '-' && tag[3] == '-')
+		{
+			// a comment ends at the first "-->"
+			while (tagEnd && (tagEnd - tag < 6 || tagEnd[-1] != '-' || tagEnd[-2] != '-'))
+			{
+				tagEnd = (const char *) memchr(tagEnd + 1, '>', end - tagEnd - 1);
+			}
+			if (tagEnd == NULL)
+			{
+				break;
+			}
+		}
+		else if (tag[1] == '!' || tag[1] == '?')
+		{
+			break;
+		}
+		else
+		{
+			// a quoted attribute value may hold a '>'
+			char quote = 0;
+			const char *c;
+			for (c = tag + 1; c < end && (quote || *c != '>'); ++c)
+			{
+				quote = quote ? ((*c == quote) ? 0 : quote) : ((*c == '"' || *c == '\'') ? *c : 0);
+			}
+			if (c == end)
+			{
+				break;
+			}
+			tagEnd = c;
+			depth += (tag[1] == '/') ? -1 : (tagEnd[-1] == '/') ? 0 : 1;
+		}
+		tag = tagEnd + 1;
+		if (depth == 0)
+		{
+			index = tag - text;
+			return true;
+		}
+	}
+	index = (tag ? tag : end) - text;
+	return false;
+}
+
+//************************************
+// Function:  XML_StreamElementSize - finds the end of the element starting at the position
+// Returns:   bool - false if the element is not terminated
+// Parameter: XML_Stream & stream
+// Parameter: size_t & size - of the element text, from the position
+//************************************
+static bool XML_StreamElementSize(XML_Stream &stream, size_t &size)
+{
+	UINT32 depth = 0;
+	size_t index = 0;
+	bool isEmpty;
+
+	for (;;)
+	{
+		if (XML_StreamScanTags(&stream.buffer[stream.position], stream.buffer.size() - stream.position, index, depth))
+		{
+			size = index;
+			return true;
+		}
+		if (!XML_StreamFind(stream, index, "<", index) || !XML_StreamFill(stream, index + 2))
+		{
+			return false;
+		}
+		const char *text = &stream.buffer[stream.position];
+		const char *tag = text + index;
+		const char *tagEnd = (const char *) memchr(tag, '>', stream.buffer.size() - stream.position - index);
+		char next = tag[1];
+		if (tagEnd && next != '!' && next != '?' && !memchr(tag, '"', tagEnd - tag) && !memchr(tag, '\'', tagEnd - tag))
+		{
+			// most tags are read already and have no quoted values, the first '>' ends them
+			depth += (next == '/') ? -1 : (tagEnd[-1] == '/') ? 0 : 1;
+			index = tagEnd + 1 - text;
+		}
+		else if (next == '/')
+		{
+			if (!XML_StreamFind(stream, index, ">", index))
+			{
+				return false;
+			}
+			++index;
+			--depth;
+		}
+		else if (next == '!' || next == '?')
+		{
+			if (!XML_StreamSkipMarkup(stream, index))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			if (!XML_StreamTagEnd(stream, index, isEmpty))
+			{
+				return false;
+			}
+			depth += isEmpty ? 0 : 1;
+		}
+		if (depth == 0)
+		{
+			size = index;
+			return true;
+		}
+	}
+}
+
+// the name of the tag at the position
+static string XML_StreamTagName(XML_Stream &stream)
+{
+	size_t end = 1;
+	while (XML_StreamFill(stream, end + 1) && !strchr(" \t\r\n/>", stream.buffer[stream.position + end]))
+	{
+		++end;
+	}
+	return string(&stream.buffer[stream.position + 1], end - 1);
+}
+
+//************************************
+// Function:  XML_StreamNextTag - skips white space, comments and processing instructions up to the next tag
+// Returns:   UINT32 - ERR_PARSING (reported) if the file ends first, or if there is text before the tag
+// Parameter: XML_Stream & stream
+//************************************
+static UINT32 XML_StreamNextTag(XML_Stream &stream)
+{
+	for (;;)
+	{
+		while (XML_StreamFill(stream, 1) && isspace((UINT8) stream.buffer[stream.position]))
+		{
+			++stream.position;
+		}
+		if (!XML_StreamFill(stream, 1))
+		{
+			ERR_PrintError(ERR_PARSING, "the XML ends before the " + ROOT_DESCRIPTOR + " element is closed");
+			return ERR_PARSING;
+		}
+		if (stream.buffer[stream.position] != '<')
+		{
+			stringstream errStr;
+			errStr << "text outside of the fields, at offset " << stream.consumed + stream.position;
+			ERR_PrintError(ERR_PARSING, errStr.str());
+			return ERR_PARSING;
+		}
+		size_t index = 0;
+		if (XML_StreamMatch(stream, 0, "<!--") || XML_StreamMatch(stream, 0, "<?") || XML_StreamMatch(stream, 0, "<!D"))
+		{
+			if (!XML_StreamSkipMarkup(stream, index))
+			{
+				ERR_PrintError(ERR_PARSING, "the XML ends in a comment or declaration");
+				return ERR_PARSING;
+			}
+			stream.position += index;
+			continue;
+		}
+		return STS_OK;
+	}
+}
+
+UINT32 XML_StreamFileParser(const std::string &xmlFileName, std::vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig)
+{
+	UINT32 err;
+	XML_Stream stream;
+	pugi::xml_document doc;
+	size_t size;
+	bool isEmpty;
+
+	stream.file.open(xmlFileName.c_str(), ios::binary);
+	if (!stream.file.is_open())
+	{
+		err = ERR_FILE_NOT_FOUND;
+		ERR_PrintError(err, "Filename: " + xmlFileName);
+		return err;
+	}
+	stream.position = 0;
+	stream.consumed = 0;
+
+	// only UTF-8 is streamed, the byte order mark is skipped
+	if (XML_StreamMatch(stream, 0, "\xEF\xBB\xBF"))
+	{
+		stream.position += 3;
+	}
+	else if (XML_StreamMatch(stream, 0, "\xFE\xFF") || XML_StreamMatch(stream, 0, "\xFF\xFE"))
+	{
+		ERR_PrintError(ERR_PARSING, "a streamed XML must be UTF-8 encoded: " + xmlFileName);
+		return ERR_PARSING;
+	}
+
+	// the root element
+	err = XML_StreamNextTag(stream);
+	if (err)
+	{
+		return err;
+	}
+	if (XML_StreamTagName(stream) != ROOT_DESCRIPTOR)
+	{
+		cout << XML_StreamTagName(stream) << " should be " << ROOT_DESCRIPTOR << endl;
+		return ERR_ILLEGAL_VAL;
+	}
+	size = 0;
+	if (!XML_StreamTagEnd(stream, size, isEmpty))
+	{
+		ERR_PrintError(ERR_PARSING, "the XML ends in the " + ROOT_DESCRIPTOR + " tag");
+		return ERR_PARSING;
+	}
+	stream.position += size;
+
+	// each element under the root is parsed on its own, the text of the elements handled is dropped
+	while (!isEmpty)
+	{
+		err = XML_StreamNextTag(stream);
+		if (err)
+		{
+			return err;
+		}
+		if (XML_StreamMatch(stream, 0, "</"))
+		{
+			break;
+		}
+		if (!XML_StreamElementSize(stream, size))
+		{
+			ERR_PrintError(ERR_PARSING, "the XML ends in the element " + XML_StreamTagName(stream));
+			return ERR_PARSING;
+		}
+
+		pugi::xml_parse_result result = doc.load_buffer_inplace(&stream.buffer[stream.position], size, XML_PARSE_OPTIONS,
+																pugi::encoding_utf8);
+		if (result.status != pugi::status_ok)
+		{
+			stringstream errStr;
+			errStr << "XML file could not be loaded, at offset " << stream.consumed + stream.position + result.offset;
+			cout << "XML Load result: " << result.description() << endl;
+			ERR_PrintError(ERR_PARSING, errStr.str());
+			return ERR_PARSING;
+		}
+		pugi::xml_node node = doc.first_child();
+		err = XML_HandleElement(node, fields, imageConfig);
+		if (err)
+		{
+			return err;
+		}
+		stream.position += size;
+	}
+	return STS_OK;
+}
+
+UINT32 LAYOUT_Load(const string &xmlFileName, bool streamXML, const string &cacheFile, vector<Field_BinField *> &fields,
+				   Field_ImageProperties &imageConfig)
+{
+	UINT32 err;
+
+	// a valid cache holds the fields as parsed and resolved, the XML is not parsed
+	if (!cacheFile.empty() && CACHE_Load(cacheFile, xmlFileName, fields, imageConfig))
+	{
+		return STS_OK;
+	}
+
+	if (streamXML)
+	{
+		if (verbosLevel)
+		{
+			cout << "Parsing XML (" << xmlFileName << ") as a stream..."<< endl;
+		}
+		err = XML_StreamFileParser(xmlFileName, fields, imageConfig);
+		if (err)
+		{
+			return err;
+		}
+	}
+	else
+	{
+		if (verbosLevel)
+		{
+			cout << "Loading XML File " << xmlFileName << "..."<< endl;
+		} 
+
+		XML_File xml;
+		pugi::xml_parse_result result = XML_LoadFile(xml, xmlFileName);
+		if (result.status != pugi::status_ok)
+		{
+			cout << "XML Load result: " << result.description() << endl;
+			ERR_PrintError(ERR_PARSING, "XML file could not be loaded");
+			return ERR_PARSING;
+		}
+
+		if (verbosLevel)
+		{
+			cout << "XML Load result: " << result.description() << endl;
+
+			cout << "Parsing XML (" << xmlFileName << ")..."<< endl;
+		}
+
+		err = XML_InputFileParser(xml.doc, fields, imageConfig);
+		XML_CloseFile(xml);
+		if (err)
+		{
+			return err;
+		}
+	}
+
+	// set values taken from other fields
+	err = FLD_ResolveReferences(fields);
+	if (err)
+	{
+		return err;
+	}
+
+	// a cache which is not written only costs the next run a parse
+	if (!cacheFile.empty())
+	{
+		CACHE_Save(cacheFile, xmlFileName, fields, imageConfig);
+	}
+	return STS_OK;
+}
+
+//************************************
+// Function:  LAYOUT_BuildImage - parses, validates and builds the layout described by an XML file
+//								 into an image in memory
+// Returns:   UINT32
+// Parameter: const string & xmlFileName
+// Parameter: vector<UINT8> & image
+//************************************
+static UINT32 LAYOUT_BuildImage(const string &xmlFileName, vector<UINT8> &image)
+{
+	UINT32 err;
+	vector<Field_BinField *> fields;
+	Field_ImageProperties imageConfig;
+
+	if (verbosLevel)
+	{
+		cout << "Building layout " << xmlFileName << "..." << endl;
+	}
+
+	XML_File xml;
+	pugi::xml_parse_result result = XML_LoadFile(xml, xmlFileName);
+	if (result.status != pugi::status_ok)
+	{
+		XML_CloseFile(xml);
+		cout << "XML Load result: " << result.description() << endl;
+		ERR_PrintError(ERR_PARSING, "XML file could not be loaded: " + xmlFileName);
+		return ERR_PARSING;
+	}
+
+	// the fields keep copies of the values, the document is not needed once they are set
+	err = XML_InputFileParser(xml.doc, fields, imageConfig);
+	XML_CloseFile(xml);
+	if (err == STS_OK)
+	{
+		err = FLD_ResolveReferences(fields);
+	}
+	if (err == STS_OK)
+	{
+		FM_SortFields(fields);
+		err = FM_ValidateFieldVector(fields, imageConfig);
+	}
+	if (err == STS_OK)
+	{
+		err = FM_CreateBinImage(fields, imageConfig, image);
+	}
+
+	LAYOUT_FreeFields(fields);
+
+	if (err)
+	{
+		ERR_PrintError(err, "failed building layout " + xmlFileName);
+	}
+	return err;
+}
+
+UINT32 LAYOUT_GetImage(const string &xmlFileName, const vector<UINT8> *&image)
+{
+	UINT32 err;
+
+	map<string, vector<UINT8> *>::iterator found = LayoutImages.find(xmlFileName);
+	if (found != LayoutImages.end())
+	{
+		if (found->second == NULL)
+		{
+			err = ERR_ILLEGAL_VAL;
+			ERR_PrintError(err, "layout includes itself: " + xmlFileName);
+			return err;
+		}
+		image = found->second;
+		return STS_OK;
+	}
+
+	// mark the layout as being built, in order to detect circular includes
+	LayoutImages[xmlFileName] = NULL;
+
+	vector<UINT8> *newImage = new vector<UINT8>;
+	err = LAYOUT_BuildImage(xmlFileName, *newImage);
+	if (err)
+	{
+		delete newImage;
+		LayoutImages.erase(xmlFileName);
+		return err;
+	}
+
+	LayoutImages[xmlFileName] = newImage;
+	image = newImage;
+	return STS_OK;
+}
+
+UINT32 LAYOUT_DefineVariable(const string &definition)
+{
+	UINT32 err;
+	size_t separator = definition.find('=');
+
+	if (separator == string::npos || separator == 0)
+	{
+		err = ERR_CMD_LINE_ERR;
+		ERR_PrintError(err, "a variable is defined as NAME=value: " + definition);
+		return err;
+	}
+	LayoutVariables[definition.substr(0, separator)] = definition.substr(separator + 1);
+	return STS_OK;
+}
+
+void LAYOUT_ClearVariables()
+{
+	LayoutVariables.clear();
+
+	// the images of the included layouts were built with the variables
+	for (map<string, vector<UINT8> *>::iterator it = LayoutImages.begin(); it != LayoutImages.end(); ++it)
+	{
+		delete it->second;
+	}
+	LayoutImages.clear();
+}
+
+const map<string, string> &LAYOUT_GetVariables()
+{
+	return LayoutVariables;
+}
+
+void LAYOUT_FreeFields(vector<Field_BinField *> &fields)
+{
+	// destruct all binary fields
+	while (!fields.empty())
+	{
+		delete fields.back();
+		fields.pop_back();
+	}
+}
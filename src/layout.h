@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+#include <string>
+#include <vector>
+#include <map>
+#include "pugiXML/pugixml.hpp"
+#include "fields.h"
+
+
+// LAYOUT=Bin_Ecc_Map XML description of an image
+
+/*
+	Options the layout XMLs are parsed with. Processing instructions, comments and the DOCTYPE are skipped
+	(no nodes are made for them); escapes and end of lines are kept, the content formats rely on them.
+*/
+const unsigned int XML_PARSE_OPTIONS = pugi::parse_default;
+
+/*
+	An XML file parsed in place: the document refers to the text of the file, which is kept until XML_CloseFile
+*/
+typedef struct XML_File
+{
+	pugi::xml_document	doc;
+	void				*text;	// the mapped file (NULL - the text is kept by the document)
+	size_t				size;
+}XML_File;
+
+/*
+	Loads the XML file into the document of the file, parsing it in place (on Linux the file is mapped, which saves
+	a copy of the text in memory)
+*/
+pugi::xml_parse_result XML_LoadFile(XML_File &file, const std::string &fileName);
+
+/*
+	Frees the document of the file, and its text
+*/
+void XML_CloseFile(XML_File &file);
+
+/*
+	Parses the XML document into the field vector and the image properties
+*/
+UINT32 XML_InputFileParser(pugi::xml_document &doc, std::vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig);
+
+/*
+	Parses the XML file like XML_InputFileParser, without loading it as a document: the file is read in blocks,
+	and each element under the root is parsed on its own and dropped once its field is set
+*/
+UINT32 XML_StreamFileParser(const std::string &xmlFileName, std::vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig);
+
+/*
+	Loads the fields of the XML, parsed (as a document or as a stream) and resolved. When a cache file is given,
+	the fields are loaded from it if it is still valid, otherwise it is written after the XML is parsed.
+*/
+UINT32 LAYOUT_Load(const std::string &xmlFileName, bool streamXML, const std::string &cacheFile,
+				   std::vector<Field_BinField *> &fields, Field_ImageProperties &imageConfig);
+
+/*
+	Returns the image built from another layout XML (used by format='Layout'/'LayoutSize').
+	Each layout is built once, further references get the same image.
+*/
+UINT32 LAYOUT_GetImage(const std::string &xmlFileName, const std::vector<UINT8> *&image);
+
+/*
+	Defines a variable of the layouts (NAME=value), ${NAME} is replaced by the value in the text
+	and in the attributes of the XML elements. A variable defined again takes the last value.
+*/
+UINT32 LAYOUT_DefineVariable(const std::string &definition);
+
+/*
+	Removes the variables defined so far, along with the images of the included layouts built with them
+*/
+void LAYOUT_ClearVariables();
+
+/*
+	Returns the variables defined so far, by name
+*/
+const std::map<std::string, std::string> &LAYOUT_GetVariables();
+
+/*
+	Deletes the fields of a layout
+*/
+void LAYOUT_FreeFields(std::vector<Field_BinField *> &fields);
+
+#endif // LAYOUT_H
@@ -16,7 +16,6 @@
 //
 
 #include <iostream>
-#include <algorithm>    // std::sort
 #include <vector>
 #include <string>
 #include <sstream>
@@ -29,6 +28,12 @@
 #include "utilities.h"
 #include "bingo_types.h"
 #include "file_maker.h"
+#include "layout.h"
+#include "signer.h"
+#include "diff.h"
+#include "extract.h"
+#include "infer.h"
+#include "matrix.h"
 
 
 #define TERMINATE_APP(STS)		{cout<<endl<<"FAILED"<<endl; exit(STS);}
@@ -45,7 +50,8 @@ typedef enum _EXIT_CODE
 	ES_STATUS_REPORT_ERROR	=	0x03,
 	ES_FILE_GEN_ERR         =	0x04,
 	ES_BUILDING_ERROR		=	0x05,
-	ES_GENERATING_ERROR		=	0x06
+	ES_GENERATING_ERROR		=	0x06,
+	ES_IMAGES_DIFFER		=	0x07
 } EXIT_CODE;
 
 using namespace std;
@@ -56,104 +62,76 @@ Field_ImageProperties ImageConfig;
 
 
 
-UINT32 XML_InputFileParser(pugi::xml_document &doc)
-{
-	
-	UINT32 err = 0;
-	string fieldName;
-	pugi::xml_node errorNode;
-	// make sure the root element is valid
-	if (doc.first_child().name() != ROOT_DESCRIPTOR)
-	{
-		cout << doc.first_child().name() << " should be " << ROOT_DESCRIPTOR << endl;
-		return ERR_ILLEGAL_VAL;
-	}
-	
-	// avoiding recursion while assuming we now the structure of the xml_tree
-	pugi::xml_node fieldNode;
-	
-	// go on first level elements (i.e. fields)
-	fieldNode = doc.first_child();
-	for (pugi::xml_node_iterator it = fieldNode.begin(); it != fieldNode.end(); ++it)
-	{
-		fieldName = it->name();
-		
-		if (fieldName == Field_ImageProperties::descriptor)
-		{	
-			err = ImageConfig.handleElememtXML(*it);	
-		}
-		else if (fieldName == Field_BinField::descriptor)
-		{
-			Field_BinField *field = new Field_BinField();
-			err = field->handleElememtXML(*it);
-			BinFields.push_back(field);
-		} 
-		else
-		{
-			err = ERR_ILLEGAL_FIELD;
-			ERR_PrintError(ERR_ILLEGAL_FIELD, fieldName);
-		}
-
-
-		if (err)
-		{
-			errorNode = (*it);
-			break;
-		}
-	}
-		// treat each element according to field
-
-	
-	if (err)
-	{
-		
-		stringstream errStr;
-		errStr << "error at node: " << errorNode.name() << "." << errorNode.first_child().child_value();
-		ERR_PrintError(ERR_PARSING, errStr.str());
-		return err;
-	}
-	return STS_OK;
-}
-
 int main(int argc, char *argv[])
 {
 	UINT32 status;
-	string	outputFilename = DEFAULT_OUTPUT_FILE_PATH; 
-	string  inputXMLFilename = DEBUG_XML_FILE_PATH;
+	CmdLine_Options options;
+	FM_OutputFiles outputFiles;
+
+	options.inputXML = DEBUG_XML_FILE_PATH;
+	options.outBin = DEFAULT_OUTPUT_FILE_PATH;
+	options.outFormat = OUT_bin;
+	options.maskRequested = false;
+	options.streamXML = false;
+	options.outDir = ".";
+	options.maxMemory = 0;
 
 	cout<< endl << "Bingo - Binary Construction and Generation Tool"<<endl;
 	cout<<"Bingo version "<<VER_MAJ(BingoVersion)<<"."<<VER_MIN(BingoVersion)<<"."<<VER_REV(BingoVersion)<<endl; 
 	
 	// command line parser...
-	status = CmdLineParser(argc, argv, inputXMLFilename, outputFilename);
+	status = CmdLineParser(argc, argv, options);
 	if (status)
 	{
 		TERMINATE_APP(ES_CLI_PARSING_ERROR);
 	}
+
+	// an image with no XML, the XML is the output
+	if (!options.inferImage.empty())
+	{
+		string outXml = (options.outBin == DEFAULT_OUTPUT_FILE_PATH) ? options.inferImage + ".xml" : options.outBin;
+		status = INF_InferLayout(options.inferImage, outXml);
+		if (status)
+		{
+			TERMINATE_APP(ES_GENERATING_ERROR);
+		}
+		cout<<endl<<"SUCCESS"<<endl;
+		return STS_OK;
+	}
 	
 	
-	if (verbosLevel)
+	// the variants are built from the XML with variables and overrides of their own
+	if (!options.matrixFile.empty())
 	{
-		cout << "Loading XML File " << inputXMLFilename << "..."<< endl;
-	} 
-	
-	pugi::xml_document doc;
-	pugi::xml_parse_result result = doc.load_file(inputXMLFilename.c_str());
-	if (result.status != pugi::status_ok)
+		status = MTX_BuildVariants(options);
+		SIGN_CloseSessions();
+		if (status)
+		{
+			TERMINATE_APP(ES_GENERATING_ERROR);
+		}
+		cout<<endl<<"SUCCESS"<<endl;
+		return STS_OK;
+	}
+
+	for (vector<string>::iterator it = options.variables.begin(); it != options.variables.end(); ++it)
 	{
-		cout << "XML Load result: " << result.description() << endl;
-		ERR_PrintError(ERR_PARSING, "XML file could not be loaded");
-		TERMINATE_APP(ES_XML_PARSING_ERROR);
+		status = LAYOUT_DefineVariable(*it);
+		if (status)
+		{
+			TERMINATE_APP(ES_CLI_PARSING_ERROR);
+		}
 	}
-	
-	if (verbosLevel)
+
+	// the XML attributes an override is parsed with are recorded only when there are overrides
+	ImageConfig.keepXmlAttributes = !options.overrides.empty();
+	status = LAYOUT_Load(options.inputXML, options.streamXML, options.cacheFile, BinFields, ImageConfig);
+	if (status)
 	{
-		cout << "XML Load result: " << result.description() << endl;
-	
-		cout << "Parsing XML (" << inputXMLFilename << ")..."<< endl;
+		TERMINATE_APP(ES_XML_PARSING_ERROR);
 	}
 
-	status = XML_InputFileParser(doc);
+	// the overrides are not cached, a variant of a cached layout is not parsed again
+	status = FLD_ApplyOverrides(BinFields, ImageConfig, options.overrides);
 	if (status)
 	{
 		TERMINATE_APP(ES_XML_PARSING_ERROR);
@@ -167,7 +145,7 @@ int main(int argc, char *argv[])
 	}
 	
 	// sort the binField vector
-	std::sort (BinFields.begin(), BinFields.end(), FM_binFieldSortFunctionHandler);
+	FM_SortFields(BinFields);
 
 	// validate binary content fields (size, no overrun)
 	status = FM_ValidateFieldVector(BinFields, ImageConfig);
@@ -177,12 +155,41 @@ int main(int argc, char *argv[])
 	}
 	
 
+	if (!options.diffImages[0].empty())
+	{
+		bool identical;
+		status = DIFF_CompareImages(BinFields, ImageConfig, options.diffImages[0], options.diffImages[1], identical);
+		LAYOUT_FreeFields(BinFields);
+		if (status)
+		{
+			TERMINATE_APP(ES_GENERATING_ERROR);
+		}
+		return identical ? STS_OK : ES_IMAGES_DIFFER;
+	}
+
+	if (!options.extractImage.empty())
+	{
+		status = EXT_ExtractFields(BinFields, options.extractImage, options.outDir);
+		LAYOUT_FreeFields(BinFields);
+		if (status)
+		{
+			TERMINATE_APP(ES_GENERATING_ERROR);
+		}
+		cout<<endl<<"SUCCESS"<<endl;
+		return STS_OK;
+	}
+
 	if (verbosLevel)
 	{
-		cout << "creating output file " << outputFilename << "..." << endl;
+		cout << "creating output file " << options.outBin << "..." << endl;
 	}
-	// create binary file
-	status = FM_CreateBinFile(BinFields, ImageConfig, outputFilename);
+	// the data image, the mask image and the map are all created in one pass
+	outputFiles.imageFile = options.maskRequested ? "" : options.outBin;
+	outputFiles.maskFile = options.maskRequested ? options.outBin : options.outMask;
+	outputFiles.mapFile = options.outMap;
+	outputFiles.format = options.outFormat;
+	outputFiles.maxMemory = options.maxMemory;
+	status = FM_CreateOutputFiles(BinFields, ImageConfig, outputFiles);
 	if (status)
 	{
 		TERMINATE_APP(ES_GENERATING_ERROR);
@@ -190,11 +197,8 @@ int main(int argc, char *argv[])
 	
 
 	// destruct all binary fields
-	while (!BinFields.empty())
-	{
-		delete BinFields.back();
-		BinFields.pop_back();
-	}
+	LAYOUT_FreeFields(BinFields);
+	SIGN_CloseSessions();
 	
 	cout<<endl<<"SUCCESS"<<endl;
 	return STS_OK;
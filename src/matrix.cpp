@@ -0,0 +1,526 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <cstring>
+#include <cctype>
+#include <cstdlib>
+#include "matrix.h"
+#include "errors.h"
+#include "fields.h"
+#include "layout.h"
+#include "file_maker.h"
+#include "checksum.h"
+
+using namespace std;
+
+/*
+	A variant of the image, as listed in the matrix file
+*/
+typedef struct MTX_Variant
+{
+	string				output;		// the image file
+	map<string, string>	variables;	// substituted for ${NAME} in the XML
+	vector<string>		overrides;	// Field.config=value, applied to the parsed fields
+}MTX_Variant;
+
+/*
+	The fields parsed with one set of variables, kept until all the variants are built
+*/
+typedef struct MTX_Layout
+{
+	Field_ImageProperties		imageConfig;
+	vector<Field_BinField *>	fields;
+}MTX_Layout;
+
+/*
+	A variant being built: copies of the parsed fields, pointing at the image properties of the variant.
+	The copies share the buffers of the parsed fields, a buffer the variant changes is allocated from its own arena.
+*/
+typedef struct MTX_Build
+{
+	Field_ImageProperties		imageConfig;
+	vector<Field_BinField *>	fields;
+	UINT32						variant;	// index in the matrix file
+	UINT32						result;
+}MTX_Build;
+
+/*
+	The matrix file, read as JSON
+*/
+typedef struct MTX_Reader
+{
+	string	text;
+	size_t	position;
+}MTX_Reader;
+
+
+static void MTX_SkipSpaces( MTX_Reader &reader )
+{
+	while (reader.position < reader.text.size() && isspace((unsigned char) reader.text[reader.position]))
+	{
+		++reader.position;
+	}
+}
+
+// skips the spaces and the given character, if it is next
+static bool MTX_Match( MTX_Reader &reader, char c )
+{
+	MTX_SkipSpaces(reader);
+	if (reader.position < reader.text.size() && reader.text[reader.position] == c)
+	{
+		++reader.position;
+		return true;
+	}
+	return false;
+}
+
+//************************************
+// Function:  MTX_GetString - reads a JSON string (\uXXXX escapes are supported for ASCII only)
+// Returns:   bool - false for a syntax error
+// Parameter: MTX_Reader & reader
+// Parameter: string & value
+//************************************
+static bool MTX_GetString( MTX_Reader &reader, string &value )
+{
+	if (!MTX_Match(reader, '"'))
+	{
+		return false;
+	}
+
+	value.clear();
+	while (reader.position < reader.text.size())
+	{
+		char c = reader.text[reader.position++];
+		if (c == '"')
+		{
+			return true;
+		}
+		if (c != '\\')
+		{
+			value += c;
+			continue;
+		}
+		if (reader.position >= reader.text.size())
+		{
+			return false;
+		}
+
+		c = reader.text[reader.position++];
+		switch (c)
+		{
+		case '"':
+		case '\\':
+		case '/':
+			value += c;
+			break;
+		case 'b':
+			value += '\b';
+			break;
+		case 'f':
+			value += '\f';
+			break;
+		case 'n':
+			value += '\n';
+			break;
+		case 'r':
+			value += '\r';
+			break;
+		case 't':
+			value += '\t';
+			break;
+		case 'u':
+			{
+				char *end;
+				string digits = reader.text.substr(reader.position, 4);
+				unsigned long code = strtoul(digits.c_str(), &end, 16);
+				if (digits.size() != 4 || *end != '\0' || code > 0x7F)
+				{
+					return false;
+				}
+				value += (char) code;
+				reader.position += 4;
+			}
+			break;
+		default:
+			return false;
+		}
+	}
+	return false;
+}
+
+// a string, or a number (or true/false) taken as its text
+static bool MTX_GetValue( MTX_Reader &reader, string &value )
+{
+	MTX_SkipSpaces(reader);
+	if (reader.position < reader.text.size() && reader.text[reader.position] == '"')
+	{
+		return MTX_GetString(reader, value);
+	}
+
+	size_t start = reader.position;
+	while (reader.position < reader.text.size() && (isalnum((unsigned char) reader.text[reader.position]) ||
+		   strchr("+-.", reader.text[reader.position]) != NULL))
+	{
+		++reader.position;
+	}
+	value = reader.text.substr(start, reader.position - start);
+	return !value.empty();
+}
+
+// an object of names and values: {"name": value, ...}
+static bool MTX_GetPairs( MTX_Reader &reader, vector<pair<string, string> > &pairs )
+{
+	if (!MTX_Match(reader, '{'))
+	{
+		return false;
+	}
+	if (MTX_Match(reader, '}'))
+	{
+		return true;
+	}
+	do
+	{
+		pair<string, string> item;
+		if (!MTX_GetString(reader, item.first) || !MTX_Match(reader, ':') || !MTX_GetValue(reader, item.second))
+		{
+			return false;
+		}
+		pairs.push_back(item);
+	} while (MTX_Match(reader, ','));
+	return MTX_Match(reader, '}');
+}
+
+//************************************
+// Function:  MTX_GetVariant - reads a variant object of the matrix
+// Returns:   bool - false for a syntax error, or for a variant which is not valid
+// Parameter: MTX_Reader & reader
+// Parameter: MTX_Variant & variant
+//************************************
+static bool MTX_GetVariant( MTX_Reader &reader, MTX_Variant &variant )
+{
+	if (!MTX_Match(reader, '{'))
+	{
+		return false;
+	}
+	do
+	{
+		string key;
+		vector<pair<string, string> > pairs;
+		if (!MTX_GetString(reader, key) || !MTX_Match(reader, ':'))
+		{
+			return false;
+		}
+
+		if (key == "output")
+		{
+			if (!MTX_GetString(reader, variant.output))
+			{
+				return false;
+			}
+		}
+		else if (key == "variables" || key == "set")
+		{
+			if (!MTX_GetPairs(reader, pairs))
+			{
+				return false;
+			}
+			for (vector<pair<string, string> >::iterator it = pairs.begin(); it != pairs.end(); ++it)
+			{
+				if (key == "variables")
+				{
+					variant.variables[it->first] = it->second;
+				}
+				else
+				{
+					variant.overrides.push_back(it->first + "=" + it->second);
+				}
+			}
+		}
+		else
+		{
+			cout << "unknown key in the matrix: " << key << endl;
+			return false;
+		}
+	} while (MTX_Match(reader, ','));
+
+	return MTX_Match(reader, '}') && !variant.output.empty();
+}
+
+static UINT32 MTX_ReadVariants( const string &matrixFile, vector<MTX_Variant> &variants )
+{
+	UINT32 err;
+	MTX_Reader reader;
+
+	ifstream file(matrixFile.c_str(), ios::binary);
+	if (!file.is_open())
+	{
+		err = ERR_FILE_NOT_FOUND;
+		ERR_PrintError(err, "Filename: " + matrixFile);
+		return err;
+	}
+	stringstream text;
+	text << file.rdbuf();
+	reader.text = text.str();
+	reader.position = 0;
+
+	bool valid = MTX_Match(reader, '[');
+	if (valid && !MTX_Match(reader, ']'))
+	{
+		do
+		{
+			variants.push_back(MTX_Variant());
+			valid = MTX_GetVariant(reader, variants.back());
+		} while (valid && MTX_Match(reader, ','));
+		valid = valid && MTX_Match(reader, ']');
+	}
+	MTX_SkipSpaces(reader);
+
+	if (!valid || reader.position != reader.text.size())
+	{
+		err = ERR_PARSING;
+		stringstream errStr;
+		errStr << matrixFile << ": not a valid matrix at offset " << reader.position 
+			   << " (a list of {\"output\": file, \"variables\": {...}, \"set\": {...}})";
+		ERR_PrintError(err, errStr.str());
+		return err;
+	}
+	return STS_OK;
+}
+
+//************************************
+// Function:  MTX_CopyFields - sets the fields of a variant build, copies of the parsed fields with the overrides
+//								 of the variant applied
+// Returns:   UINT32
+// Parameter: const vector<Field_BinField * > & fields - the parsed fields
+// Parameter: const Field_ImageProperties & imageConfig - of the parsed fields
+// Parameter: const MTX_Variant & variant
+// Parameter: MTX_Build & build
+//************************************
+static UINT32 MTX_CopyFields( const vector<Field_BinField *> &fields, const Field_ImageProperties &imageConfig,
+							  const MTX_Variant &variant, MTX_Build &build )
+{
+	build.imageConfig.size = imageConfig.size;
+	build.imageConfig.paddingValue = imageConfig.paddingValue;
+	for (vector<Field_BinField *>::const_iterator it = fields.begin(); it != fields.end(); ++it)
+	{
+		Field_BinField *field = new Field_BinField(**it);
+		field->setImageConfig(&build.imageConfig);
+		build.fields.push_back(field);
+
+		// a computed value is written into the field buffer when the image is built
+		if (field->isComputed && field->dataBuffer != nullptr)
+		{
+			field->dataBuffer = build.imageConfig.arena.allocate(field->size);
+			memcpy(field->dataBuffer, (*it)->dataBuffer, (size_t) field->size);
+		}
+	}
+
+	return FLD_ApplyOverrides(build.fields, imageConfig, variant.overrides);
+}
+
+//************************************
+// Function:  MTX_AddBuilds - adds the builds of the variants of the same variables, from the fields parsed with them.
+//								 A variant whose overrides fail is reported and not added.
+// Returns:   UINT32 - the first error
+// Parameter: const MTX_Layout & layout - the parsed fields
+// Parameter: const vector<MTX_Variant> & variants
+// Parameter: const vector<UINT32> & group - indices of the variants to build
+// Parameter: vector<MTX_Build * > & builds
+//************************************
+static UINT32 MTX_AddBuilds( const MTX_Layout &layout, const vector<MTX_Variant> &variants, const vector<UINT32> &group,
+							 vector<MTX_Build *> &builds )
+{
+	UINT32 result = STS_OK;
+
+	// the overrides are applied before the threads start, a build only writes its own files
+	for (UINT32 i = 0; i < group.size(); ++i)
+	{
+		MTX_Build *build = new MTX_Build;
+		build->variant = group[i];
+		build->result = STS_OK;
+		UINT32 err = MTX_CopyFields(layout.fields, layout.imageConfig, variants[group[i]], *build);
+		if (err)
+		{
+			ERR_PrintError(err, "variant " + variants[group[i]].output);
+			result = (result == STS_OK) ? err : result;
+			LAYOUT_FreeFields(build->fields);
+			delete build;
+			continue;
+		}
+		builds.push_back(build);
+	}
+	return result;
+}
+
+//************************************
+// Function:  MTX_RunBuilds - builds the variants of all the parsed layouts together, in parallel
+// Returns:   UINT32 - the first error
+// Parameter: const vector<MTX_Layout * > & layouts
+// Parameter: const vector<MTX_Variant> & variants
+// Parameter: vector<MTX_Build * > & builds - released when built
+// Parameter: const CmdLine_Options & options
+//************************************
+static UINT32 MTX_RunBuilds( const vector<MTX_Layout *> &layouts, const vector<MTX_Variant> &variants,
+							 vector<MTX_Build *> &builds, const CmdLine_Options &options )
+{
+	UINT32 err = STS_OK;
+
+	// the signing sessions are shared, a layout with signatures is built one variant at a time
+	bool isParallel = true;
+	for (vector<MTX_Layout *>::const_iterator layout = layouts.begin(); layout != layouts.end(); ++layout)
+	{
+		for (vector<Field_BinField *>::const_iterator it = (*layout)->fields.begin(); it != (*layout)->fields.end(); ++it)
+		{
+			isParallel = isParallel && !((*it)->isComputed && (*it)->findSide()->computedAttributes.format_id == Field_Attributes::attr_Signature);
+		}
+	}
+	// the CRC tables are built on first use (CRC_TablesReady), which is not thread safe: two builds computing
+	// the same CRC at once would both fill its table while the other reads it. They are built here, once.
+	for (UINT32 type = 0; type < NUM_OF_CRC_TYPES; ++type)
+	{
+		CRC_Init((CRC_Type) type);
+	}
+
+	RunParallel((UINT32) builds.size(), isParallel ? 1 : (UINT32) builds.size(), [&](UINT32 first, UINT32 count)
+	{
+		for (UINT32 i = first; i < first + count; ++i)
+		{
+			MTX_Build &build = *builds[i];
+			FM_OutputFiles outputFiles;
+			outputFiles.imageFile = options.maskRequested ? "" : variants[build.variant].output;
+			outputFiles.maskFile = options.maskRequested ? variants[build.variant].output : "";
+			outputFiles.format = options.outFormat;
+			outputFiles.maxMemory = options.maxMemory;
+
+			FM_SortFields(build.fields);
+			build.result = FM_ValidateFieldVector(build.fields, build.imageConfig);
+			if (build.result == STS_OK)
+			{
+				build.result = FM_CreateOutputFiles(build.fields, build.imageConfig, outputFiles);
+			}
+		}
+	});
+
+	for (vector<MTX_Build *>::iterator it = builds.begin(); it != builds.end(); ++it)
+	{
+		if ((*it)->result)
+		{
+			ERR_PrintError((*it)->result, "Error building variant " + variants[(*it)->variant].output);
+			err = (err == STS_OK) ? (*it)->result : err;
+		}
+		else
+		{
+			cout << variants[(*it)->variant].output << endl;
+		}
+		LAYOUT_FreeFields((*it)->fields);
+		delete *it;
+	}
+	builds.clear();
+	return err;
+}
+
+UINT32 MTX_BuildVariants( const CmdLine_Options &options )
+{
+	UINT32 err;
+	UINT32 result = STS_OK;
+	vector<MTX_Variant> variants;
+	vector<MTX_Layout *> layouts;
+	vector<MTX_Build *> builds;
+
+	err = MTX_ReadVariants(options.matrixFile, variants);
+	if (err)
+	{
+		return err;
+	}
+
+	// the variants of the same variables share a parse, in the order they are listed. The parses are serial
+	// (the variables are global), the files they read are read once for all of them
+	FLD_KeepFileContents(true);
+	vector<bool> isParsed(variants.size(), false);
+	for (UINT32 first = 0; first < variants.size(); ++first)
+	{
+		if (isParsed[first])
+		{
+			continue;
+		}
+		vector<UINT32> group;
+		for (UINT32 i = first; i < variants.size(); ++i)
+		{
+			if (!isParsed[i] && variants[i].variables == variants[first].variables)
+			{
+				group.push_back(i);
+				isParsed[i] = true;
+			}
+		}
+
+		LAYOUT_ClearVariables();
+		vector<string> definitions = options.variables;
+		for (map<string, string>::const_iterator it = variants[first].variables.begin(); it != variants[first].variables.end(); ++it)
+		{
+			definitions.push_back(it->first + "=" + it->second);
+		}
+		for (vector<string>::iterator it = definitions.begin(); it != definitions.end() && err == STS_OK; ++it)
+		{
+			err = LAYOUT_DefineVariable(*it);
+		}
+
+		// the builds share the buffers of the parsed fields
+		MTX_Layout *layout = new MTX_Layout;
+		layouts.push_back(layout);
+		layout->imageConfig.keepXmlAttributes = !options.overrides.empty();
+		for (UINT32 i = 0; i < group.size(); ++i)
+		{
+			layout->imageConfig.keepXmlAttributes = layout->imageConfig.keepXmlAttributes || !variants[group[i]].overrides.empty();
+		}
+		if (err == STS_OK)
+		{
+			err = LAYOUT_Load(options.inputXML, options.streamXML, options.cacheFile, layout->fields, layout->imageConfig);
+		}
+		if (err == STS_OK)
+		{
+			err = FLD_ApplyOverrides(layout->fields, layout->imageConfig, options.overrides);
+		}
+		if (err == STS_OK)
+		{
+			err = MTX_AddBuilds(*layout, variants, group, builds);
+		}
+
+		// a failing variant does not stop the others
+		result = (result == STS_OK) ? err : result;
+		err = STS_OK;
+	}
+	FLD_KeepFileContents(false);
+
+	// the variants of all the variables are built together, a field they share is encoded once
+	FM_KeepEncodedFields(true);
+	err = MTX_RunBuilds(layouts, variants, builds, options);
+	result = (result == STS_OK) ? err : result;
+	FM_KeepEncodedFields(false);
+
+	for (vector<MTX_Layout *>::iterator it = layouts.begin(); it != layouts.end(); ++it)
+	{
+		LAYOUT_FreeFields((*it)->fields);
+		delete *it;
+	}
+
+	if (result == STS_OK)
+	{
+		cout << variants.size() << " variant(s) built" << endl;
+	}
+	return result;
+}
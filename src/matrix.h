@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <string>
+#include "utilities.h"
+#include "bingo_types.h"
+
+
+// MTX=Matrix of image variants built from one layout
+
+/*
+	Builds every variant listed in options.matrixFile (JSON) from options.inputXML:
+	[
+		{"output": "<image file>", "variables": {"NAME": "value", ...}, "set": {"Field.config": "value", ...}},
+		...
+	]
+	The variants of the same variables share a single parse of the XML, the parses share the files they read
+	and the contents they compress. The variants of all the parses are then built together, in parallel, from
+	copies of the parsed fields; an ECC encoded or encrypted field of the same content is encoded once. The -D
+	variables and the --set overrides of the command line apply to every variant, the ones of the variant take
+	precedence.
+*/
+UINT32 MTX_BuildVariants(const CmdLine_Options &options);
+
+#endif // MATRIX_H
@@ -0,0 +1,894 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#include <fstream>
+#include <iomanip>
+#include <cctype>
+#include <cstdio>
+#include "output.h"
+#include "errors.h"
+#include "utilities.h"
+
+#ifdef __LINUX_APP__
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+const std::string OUT_FormatNames[OUT_NUM_OF_FORMATS] = {"bin", "ihex", "srec", "carray"};
+
+// text is written to the file in chunks of this size
+const UINT32 OUT_FLUSH_SIZE = 0x100000;
+
+// data bytes per ihex/srec record, and per carray line
+const UINT32 OUT_BYTES_PER_RECORD = 16;
+const UINT32 OUT_BYTES_PER_LINE = 16;
+
+
+/*
+	Hex encoding, each byte is looked up instead of formatted
+*/
+
+typedef struct OUT_HexTable
+{
+	char	digits[256][2];
+}OUT_HexTable;
+
+static OUT_HexTable OUT_BuildHexTable(void)
+{
+	static const char hexDigits[] = "0123456789ABCDEF";
+	OUT_HexTable table;
+	for (UINT32 i = 0; i < 256; ++i)
+	{
+		table.digits[i][0] = hexDigits[i >> 4];
+		table.digits[i][1] = hexDigits[i & 0xF];
+	}
+	return table;
+}
+
+static const OUT_HexTable OUT_Hex = OUT_BuildHexTable();
+
+static void OUT_AppendHex(string &text, UINT8 value)
+{
+	text.append(OUT_Hex.digits[value], 2);
+}
+
+static UINT32 OUT_Flush(ofstream &file, string &text, bool force)
+{
+	if (text.size() >= OUT_FLUSH_SIZE || (force && !text.empty()))
+	{
+		file.write(text.data(), text.size());
+		text.clear();
+		if (!file.good())
+		{
+			return ERR_FILE_ERROR;
+		}
+	}
+	return STS_OK;
+}
+
+
+/*
+	Map digests (see OUT_Digester)
+*/
+
+// finalizes the entries which end at the current position
+static void OUT_DigestSettle( OUT_Digester &digester )
+{
+	vector<OUT_MapEntry> &entries = digester.map->entries;
+	while (digester.entry < entries.size() &&
+		   entries[digester.entry].offset + entries[digester.entry].eccSize <= digester.position)
+	{
+		SHA256_Final(digester.entryCtx, entries[digester.entry].digest);
+		SHA256_Init(digester.entryCtx);
+		++digester.entry;
+	}
+}
+
+static void OUT_DigestInit( OUT_Digester &digester, OUT_Map *map )
+{
+	digester.map = map;
+	digester.position = 0;
+	digester.entry = 0;
+	if (map)
+	{
+		SHA256_Init(digester.imageCtx);
+		SHA256_Init(digester.entryCtx);
+		OUT_DigestSettle(digester);
+	}
+}
+
+// digests the next size bytes of the image, which start at the current position
+static void OUT_DigestData( OUT_Digester &digester, const UINT8 *data, UINT64 size )
+{
+	if (!digester.map)
+	{
+		return;
+	}
+
+	vector<OUT_MapEntry> &entries = digester.map->entries;
+	UINT64 end = digester.position + size;
+	while (digester.position < end)
+	{
+		UINT64 entryEnd = (digester.entry < entries.size()) ?
+						  entries[digester.entry].offset + entries[digester.entry].eccSize : end;
+		UINT32 count = (UINT32) MIN(MIN(end, entryEnd) - digester.position, (UINT64) OUT_FLUSH_SIZE);
+
+		SHA256_Update(digester.imageCtx, data, count);
+		if (digester.entry < entries.size())
+		{
+			SHA256_Update(digester.entryCtx, data, count);
+		}
+		data += count;
+		digester.position += count;
+		OUT_DigestSettle(digester);
+	}
+}
+
+static void OUT_DigestUpTo( OUT_Digester &digester, const vector<UINT8> &image, UINT64 end )
+{
+	if (digester.map && digester.position < end)
+	{
+		OUT_DigestData(digester, &image[digester.position], end - digester.position);
+	}
+}
+
+static void OUT_DigestFinal( OUT_Digester &digester, const vector<UINT8> &image )
+{
+	if (digester.map)
+	{
+		OUT_DigestUpTo(digester, image, image.size());
+		SHA256_Final(digester.imageCtx, digester.map->imageDigest);
+	}
+}
+
+
+/*
+	Writers
+*/
+
+static UINT32 OUT_WriteBin( ofstream &file, const vector<UINT8> &image, OUT_Digester &digester )
+{
+	for (UINT64 offset = 0; offset < image.size(); offset += OUT_FLUSH_SIZE)
+	{
+		UINT32 size = (UINT32) MIN((UINT64) OUT_FLUSH_SIZE, image.size() - offset);
+		file.write((const char *)&image[offset], size);
+		if (!file.good())
+		{
+			return ERR_FILE_ERROR;
+		}
+		OUT_DigestUpTo(digester, image, offset + size);
+	}
+	return STS_OK;
+}
+
+static void OUT_AppendIhexRecord( string &text, UINT8 type, UINT16 address, const UINT8 *data, UINT32 size )
+{
+	UINT8 checksum = (UINT8) (size + (address >> 8) + address + type);
+
+	text += ':';
+	OUT_AppendHex(text, (UINT8) size);
+	OUT_AppendHex(text, (UINT8) (address >> 8));
+	OUT_AppendHex(text, (UINT8) address);
+	OUT_AppendHex(text, type);
+	for (UINT32 i = 0; i < size; ++i)
+	{
+		OUT_AppendHex(text, data[i]);
+		checksum += data[i];
+	}
+	OUT_AppendHex(text, (UINT8) -checksum);
+	text += '\n';
+}
+
+static UINT32 OUT_WriteIhex( ofstream &file, const vector<UINT8> &image, const vector<OUT_Extent> &extents, OUT_Digester &digester )
+{
+	UINT32 err;
+	string text;
+	UINT64 upperAddress = 0;
+
+	text.reserve(OUT_FLUSH_SIZE + 64);
+	for (vector<OUT_Extent>::const_iterator it = extents.begin(); it != extents.end(); ++it)
+	{
+		// an image of 4GB ends at 0x100000000, out of 32 bit
+		UINT64 address = it->offset;
+		UINT64 end = it->offset + it->size;
+		while (address < end)
+		{
+			// records do not cross a 64KB boundary, the upper address is set by an extended linear address record
+			if ((address >> 16) != upperAddress)
+			{
+				upperAddress = address >> 16;
+				UINT8 upper[2] = {(UINT8) (upperAddress >> 8), (UINT8) upperAddress};
+				OUT_AppendIhexRecord(text, 0x04, 0, upper, 2);
+			}
+			UINT32 size = (UINT32) MIN(MIN((UINT64) OUT_BYTES_PER_RECORD, end - address), 0x10000 - (address & 0xFFFF));
+			OUT_AppendIhexRecord(text, 0x00, (UINT16) address, &image[address], size);
+			address += size;
+			OUT_DigestUpTo(digester, image, address);
+
+			err = OUT_Flush(file, text, false);
+			if (err)
+			{
+				return err;
+			}
+		}
+	}
+	OUT_AppendIhexRecord(text, 0x01, 0, NULL, 0);
+	return OUT_Flush(file, text, true);
+}
+
+static void OUT_AppendSrecRecord( string &text, char type, UINT32 address, UINT32 addressSize, const UINT8 *data, UINT32 size )
+{
+	UINT8 count = (UINT8) (addressSize + size + 1);
+	UINT8 checksum = count;
+
+	text += 'S';
+	text += type;
+	OUT_AppendHex(text, count);
+	for (int i = addressSize - 1; i >= 0; --i)
+	{
+		OUT_AppendHex(text, (UINT8) (address >> (8 * i)));
+		checksum += (UINT8) (address >> (8 * i));
+	}
+	for (UINT32 i = 0; i < size; ++i)
+	{
+		OUT_AppendHex(text, data[i]);
+		checksum += data[i];
+	}
+	OUT_AppendHex(text, (UINT8) ~checksum);
+	text += '\n';
+}
+
+static UINT32 OUT_WriteSrec( ofstream &file, const vector<UINT8> &image, const vector<OUT_Extent> &extents, const string &fileName,
+							 OUT_Digester &digester )
+{
+	UINT32 err;
+	string text;
+	UINT32 numRecords = 0;
+
+	// the shortest address which covers the image: S1/S9 (16 bit), S2/S8 (24 bit) or S3/S7 (32 bit)
+	UINT32 addressSize = (image.size() <= 0x10000) ? 2 : (image.size() <= 0x1000000) ? 3 : 4;
+	char dataType = (char) ('1' + addressSize - 2);
+	char endType = (char) ('9' - addressSize + 2);
+
+	text.reserve(OUT_FLUSH_SIZE + 64);
+	string header = fileName.substr(0, 64);
+	OUT_AppendSrecRecord(text, '0', 0, 2, (const UINT8 *)header.data(), (UINT32) header.size());
+
+	for (vector<OUT_Extent>::const_iterator it = extents.begin(); it != extents.end(); ++it)
+	{
+		for (UINT64 address = it->offset; address < it->offset + it->size; address += OUT_BYTES_PER_RECORD)
+		{
+			UINT32 size = (UINT32) MIN((UINT64) OUT_BYTES_PER_RECORD, it->offset + it->size - address);
+			OUT_AppendSrecRecord(text, dataType, (UINT32) address, addressSize, &image[address], size);
+			++numRecords;
+			OUT_DigestUpTo(digester, image, address + size);
+
+			err = OUT_Flush(file, text, false);
+			if (err)
+			{
+				return err;
+			}
+		}
+	}
+
+	// record count: S5 (16 bit) or S6 (24 bit)
+	if (numRecords <= 0xFFFF)
+	{
+		OUT_AppendSrecRecord(text, '5', numRecords, 2, NULL, 0);
+	}
+	else if (numRecords <= 0xFFFFFF)
+	{
+		OUT_AppendSrecRecord(text, '6', numRecords, 3, NULL, 0);
+	}
+	OUT_AppendSrecRecord(text, endType, 0, addressSize, NULL, 0);
+	return OUT_Flush(file, text, true);
+}
+
+static UINT32 OUT_WriteCarray( ofstream &file, const vector<UINT8> &image, const string &fileName, OUT_Digester &digester )
+{
+	UINT32 err;
+	string text;
+
+	// the array is named after the output file
+	size_t nameStart = fileName.find_last_of("/\\");
+	string name = fileName.substr(nameStart == string::npos ? 0 : nameStart + 1);
+	name = name.substr(0, name.find('.'));
+	for (string::iterator c = name.begin(); c != name.end(); ++c)
+	{
+		if (!isalnum((unsigned char) *c))
+		{
+			*c = '_';
+		}
+	}
+	if (name.empty() || isdigit((unsigned char) name[0]))
+	{
+		name = "_" + name;
+	}
+	string guard = name;
+	for (string::iterator c = guard.begin(); c != guard.end(); ++c)
+	{
+		*c = (char) toupper((unsigned char) *c);
+	}
+
+	text.reserve(OUT_FLUSH_SIZE + 128);
+	stringstream header;
+	header << "/* generated by bingo */" << endl << endl
+		   << "#ifndef " << guard << "_H" << endl << "#define " << guard << "_H" << endl << endl
+		   << "#define " << guard << "_SIZE " << image.size() << endl << endl
+		   << "static const unsigned char " << name << "[" << MAX(image.size(), (size_t) 1) << "] =" << endl << "{" << endl;
+	text += header.str();
+
+	for (UINT64 i = 0; i < image.size(); ++i)
+	{
+		if (i % OUT_BYTES_PER_LINE == 0)
+		{
+			text += '\t';
+		}
+		text += "0x";
+		OUT_AppendHex(text, image[i]);
+		if (i + 1 < image.size())
+		{
+			text += (i % OUT_BYTES_PER_LINE == OUT_BYTES_PER_LINE - 1) ? ",\n" : ", ";
+		}
+		if (i % OUT_BYTES_PER_LINE == OUT_BYTES_PER_LINE - 1)
+		{
+			OUT_DigestUpTo(digester, image, i + 1);
+		}
+
+		err = OUT_Flush(file, text, false);
+		if (err)
+		{
+			return err;
+		}
+	}
+
+	if (image.empty())
+	{
+		text += "\t0";
+	}
+	text += "\n};\n\n#endif /* " + guard + "_H */\n";
+	return OUT_Flush(file, text, true);
+}
+
+
+UINT32 OUT_GetFormat( const std::string &name, OUT_Format &format )
+{
+	for (UINT32 i = 0; i < OUT_NUM_OF_FORMATS; ++i)
+	{
+		if (name == OUT_FormatNames[i])
+		{
+			format = (OUT_Format) i;
+			return STS_OK;
+		}
+	}
+	ERR_PrintError(ERR_CMD_LINE_ERR, "unknown output format " + name);
+	return ERR_CMD_LINE_ERR;
+}
+
+UINT32 OUT_WriteImage( OUT_Format format, const std::vector<UINT8> &image, const std::vector<OUT_Extent> &extents,
+					   const std::string &fileName, OUT_Map *map )
+{
+	UINT32 err;
+	OUT_Digester digester;
+
+	// ihex and srec addresses are 32 bit
+	if ((format == OUT_ihex || format == OUT_srec) && (UINT64) image.size() > 0x100000000ULL)
+	{
+		err = ERR_BAD_IMAGE_SIZE;
+		ERR_PrintError(err, "an " + OUT_FormatNames[format] + " image can not exceed 4GB: " + fileName);
+		return err;
+	}
+
+	// open the output file for writing
+	ofstream outFile(fileName.c_str(), ofstream::binary);
+	if (!outFile.is_open())
+	{
+		err = ERR_FILE_ERROR;
+		string errStr = "Error creating or opening file " + fileName;
+		ERR_PrintError(err, errStr);
+		return err;
+	}
+
+	OUT_DigestInit(digester, map);
+	switch (format)
+	{
+	case OUT_ihex:
+		err = OUT_WriteIhex(outFile, image, extents, digester);
+		break;
+	case OUT_srec:
+		err = OUT_WriteSrec(outFile, image, extents, fileName, digester);
+		break;
+	case OUT_carray:
+		err = OUT_WriteCarray(outFile, image, fileName, digester);
+		break;
+	default:
+		err = OUT_WriteBin(outFile, image, digester);
+		break;
+	}
+	if (err)
+	{
+		string errStr = "Error writing to file " + fileName;
+		ERR_PrintError(err, errStr);
+	}
+	else
+	{
+		// ihex and srec skip the gaps, they are digested here
+		OUT_DigestFinal(digester, image);
+	}
+
+	outFile.close();
+	return err;
+}
+
+UINT32 OUT_StreamOpen( OUT_Stream &stream, const std::string &fileName, OUT_Map *map )
+{
+	UINT32 err;
+
+	stream.fileName = fileName;
+	stream.size = 0;
+	OUT_DigestInit(stream.digester, map);
+#ifdef __LINUX_APP__
+	stream.fd = -1;
+#endif
+	if (fileName.empty())
+	{
+		return STS_OK;
+	}
+
+	stream.file.open(fileName.c_str(), ofstream::binary);
+	if (!stream.file.is_open())
+	{
+		err = ERR_FILE_ERROR;
+		string errStr = "Error creating or opening file " + fileName;
+		ERR_PrintError(err, errStr);
+		return err;
+	}
+#ifdef __LINUX_APP__
+	// if not opened, the copied ranges are read and written instead
+	stream.fd = open(fileName.c_str(), O_WRONLY);
+#endif
+	return STS_OK;
+}
+
+UINT32 OUT_StreamWrite( OUT_Stream &stream, const UINT8 *data, UINT64 size )
+{
+	UINT32 err;
+
+	if (!stream.fileName.empty())
+	{
+		stream.file.write((const char *)data, size);
+		if (!stream.file.good())
+		{
+			err = ERR_FILE_ERROR;
+			string errStr = "Error writing to file " + stream.fileName;
+			ERR_PrintError(err, errStr);
+			return err;
+		}
+	}
+	OUT_DigestData(stream.digester, data, size);
+	stream.size += size;
+	return STS_OK;
+}
+
+#ifdef __LINUX_APP__
+//************************************
+// Function:  OUT_StreamVectorWrite - writes count copies of the data to the end of the stream in one
+//									  vectored write (pwritev), every iovec points to the same buffer
+// Returns:   UINT64 - the bytes written, the rest (if any) is left for the caller
+// Parameter: OUT_Stream & stream
+// Parameter: const UINT8 * data
+// Parameter: UINT64 size
+// Parameter: UINT32 count
+//************************************
+static UINT64 OUT_StreamVectorWrite( OUT_Stream &stream, const UINT8 *data, UINT64 size, UINT32 count )
+{
+	vector<struct iovec> copies(count);
+	UINT64 total = size * count;
+	UINT64 written = 0;
+
+	for (UINT32 copy = 0; copy < count; ++copy)
+	{
+		copies[copy].iov_base = (void *) data;
+		copies[copy].iov_len = (size_t) size;
+	}
+
+	// the buffered data is written first, the copies are placed after it
+	stream.file.flush();
+	while (written < total && stream.file.good())
+	{
+		// a partial write resumes from the copy (and the byte in it) it stopped at
+		UINT32 first = (UINT32) (written / size);
+		copies[first].iov_base = (void *) (data + written % size);
+		copies[first].iov_len = (size_t) (size - written % size);
+
+		ssize_t bytes = pwritev(stream.fd, &copies[first], (int) MIN(copies.size() - first, (size_t) IOV_MAX),
+								(off_t) (stream.size + written));
+		if (bytes <= 0)
+		{
+			break;
+		}
+		written += (UINT64) bytes;
+	}
+
+	if (written > 0)
+	{
+		stream.file.seekp(written, ios::cur);
+		stream.size += written;
+	}
+	return written;
+}
+#endif
+
+UINT32 OUT_StreamRepeat( OUT_Stream &stream, const UINT8 *data, UINT64 size, UINT32 count )
+{
+	UINT32 err = STS_OK;
+	UINT32 copy = 0;
+
+#ifdef __LINUX_APP__
+	// large copies are written in one system call, small ones are gathered in the stream buffer
+	if (stream.fd >= 0 && size > 0 && size * count >= OUT_FLUSH_SIZE)
+	{
+		UINT64 written = OUT_StreamVectorWrite(stream, data, size, count);
+		for (; copy < written / size; ++copy)
+		{
+			OUT_DigestData(stream.digester, data, size);
+		}
+		if (written % size != 0)
+		{
+			// the rest of a partly written copy
+			OUT_DigestData(stream.digester, data, written % size);
+			err = OUT_StreamWrite(stream, data + written % size, size - written % size);
+			++copy;
+		}
+	}
+#endif
+
+	// each (remaining) copy is written from the same buffer
+	for (; copy < count && err == STS_OK; ++copy)
+	{
+		err = OUT_StreamWrite(stream, data, size);
+	}
+	return err;
+}
+
+#ifdef __LINUX_APP__
+//************************************
+// Function:  OUT_StreamKernelCopy - copies a range of a file to the end of the stream in the kernel
+//									 (copy_file_range), the data does not pass through user space
+// Returns:   UINT64 - the bytes copied, the rest (if any) is left for the caller
+// Parameter: OUT_Stream & stream
+// Parameter: int sourceFd
+// Parameter: UINT64 sourceOffset
+// Parameter: UINT64 size
+//************************************
+static UINT64 OUT_StreamKernelCopy( OUT_Stream &stream, int sourceFd, UINT64 sourceOffset, UINT64 size )
+{
+	loff_t inOffset = sourceOffset;
+	loff_t outOffset = stream.size;
+	UINT64 copied = 0;
+
+	// the buffered data is written first, the copy is placed after it
+	stream.file.flush();
+	while (copied < size && stream.file.good())
+	{
+		ssize_t count = copy_file_range(sourceFd, &inOffset, stream.fd, &outOffset, size - copied, 0);
+		if (count <= 0)
+		{
+			break; // not supported between these files
+		}
+		copied += (UINT64) count;
+	}
+
+	if (copied > 0)
+	{
+		stream.file.seekp(copied, ios::cur);
+		stream.size += copied;
+	}
+	return copied;
+}
+#endif
+
+//************************************
+// Function:  OUT_StreamCopy - writes a range of a file to the stream, count times in a row.
+//							   On Linux it is copied by the kernel (the range is read only when
+//							   map digests are computed), otherwise (or if not supported) it is
+//							   read and written in chunks.
+// Returns:   UINT32
+// Parameter: OUT_Stream & stream
+// Parameter: const std::string & sourceFile
+// Parameter: UINT64 sourceOffset
+// Parameter: UINT64 size
+// Parameter: UINT32 count
+//************************************
+UINT32 OUT_StreamCopy( OUT_Stream &stream, const std::string &sourceFile, UINT64 sourceOffset, UINT64 size, UINT32 count )
+{
+	UINT32 err = STS_OK;
+	vector<UINT8> buffer((size_t) MIN(size, (UINT64) OUT_FLUSH_SIZE));
+
+	ifstream source(sourceFile.c_str(), ios::binary);
+	if (!source.is_open())
+	{
+		err = ERR_FILE_NOT_FOUND;
+		string errStr = "Filename: " + sourceFile;
+		ERR_PrintError(err, errStr);
+		return err;
+	}
+#ifdef __LINUX_APP__
+	int sourceFd = (stream.fd < 0) ? -1 : open(sourceFile.c_str(), O_RDONLY);
+#endif
+
+	for (UINT32 copy = 0; copy < count && err == STS_OK; ++copy)
+	{
+		UINT64 done = 0;
+#ifdef __LINUX_APP__
+		if (sourceFd >= 0)
+		{
+			done = OUT_StreamKernelCopy(stream, sourceFd, sourceOffset, size);
+		}
+#endif
+		source.clear();
+		source.seekg(sourceOffset);
+		for (UINT64 digested = 0; digested < done && stream.digester.map; )
+		{
+			// the kernel copied range is read only for the map digests
+			UINT64 chunk = MIN(done - digested, (UINT64) buffer.size());
+			source.read((char *) &buffer[0], chunk);
+			if ((UINT64) source.gcount() != chunk)
+			{
+				err = ERR_FILE_ERROR;
+				ERR_PrintError(err, "reached end of file prematurely: " + sourceFile);
+				break;
+			}
+			OUT_DigestData(stream.digester, &buffer[0], chunk);
+			digested += chunk;
+		}
+		source.clear();
+		source.seekg(sourceOffset + done);
+		while (done < size && err == STS_OK)
+		{
+			UINT64 chunk = MIN(size - done, (UINT64) buffer.size());
+			source.read((char *) &buffer[0], chunk);
+			if ((UINT64) source.gcount() != chunk)
+			{
+				err = ERR_FILE_ERROR;
+				ERR_PrintError(err, "reached end of file prematurely: " + sourceFile);
+				break;
+			}
+			err = OUT_StreamWrite(stream, &buffer[0], chunk);
+			done += chunk;
+		}
+	}
+
+#ifdef __LINUX_APP__
+	if (sourceFd >= 0)
+	{
+		close(sourceFd);
+	}
+#endif
+	return err;
+}
+
+UINT32 OUT_StreamFill( OUT_Stream &stream, UINT8 value, UINT64 size )
+{
+	UINT32 err = STS_OK;
+	vector<UINT8> buffer((size_t) MIN(size, (UINT64) OUT_FLUSH_SIZE), value);
+
+	while (size > 0 && err == STS_OK)
+	{
+		UINT64 chunk = MIN(size, (UINT64) buffer.size());
+		err = OUT_StreamWrite(stream, &buffer[0], chunk);
+		size -= chunk;
+	}
+	return err;
+}
+
+UINT32 OUT_StreamClose( OUT_Stream &stream )
+{
+	UINT32 err = STS_OK;
+
+	if (stream.digester.map)
+	{
+		SHA256_Final(stream.digester.imageCtx, stream.digester.map->imageDigest);
+	}
+	if (!stream.fileName.empty())
+	{
+		stream.file.close();
+		if (stream.file.fail())
+		{
+			err = ERR_FILE_ERROR;
+			string errStr = "Error writing to file " + stream.fileName;
+			ERR_PrintError(err, errStr);
+		}
+	}
+#ifdef __LINUX_APP__
+	if (stream.fd >= 0)
+	{
+		close(stream.fd);
+		stream.fd = -1;
+	}
+#endif
+	return err;
+}
+
+void OUT_StreamAbort( OUT_Stream &stream )
+{
+	if (stream.fileName.empty())
+	{
+		return;
+	}
+	stream.file.close();
+#ifdef __LINUX_APP__
+	if (stream.fd >= 0)
+	{
+		close(stream.fd);
+		stream.fd = -1;
+	}
+#endif
+	// a partial image is not left behind
+	remove(stream.fileName.c_str());
+}
+
+void OUT_DigestImage( const std::vector<UINT8> &image, OUT_Map &map )
+{
+	OUT_Digester digester;
+
+	OUT_DigestInit(digester, &map);
+	OUT_DigestFinal(digester, image);
+}
+
+
+/*
+	Layout map
+*/
+
+static string OUT_DigestString( const UINT8 digest[SHA256_DIGEST_SIZE] )
+{
+	string text;
+	for (UINT32 i = 0; i < SHA256_DIGEST_SIZE; ++i)
+	{
+		OUT_AppendHex(text, digest[i]);
+	}
+	for (string::iterator c = text.begin(); c != text.end(); ++c)
+	{
+		*c = (char) tolower((unsigned char) *c);
+	}
+	return text;
+}
+
+static string OUT_JsonString( const string &str )
+{
+	string text = "\"";
+	for (string::const_iterator c = str.begin(); c != str.end(); ++c)
+	{
+		if (*c == '"' || *c == '\\')
+		{
+			text += '\\';
+			text += *c;
+		}
+		else if ((unsigned char) *c < 0x20)
+		{
+			text += "\\u00";
+			OUT_AppendHex(text, (UINT8) *c);
+		}
+		else
+		{
+			text += *c;
+		}
+	}
+	return text + "\"";
+}
+
+static void OUT_WriteMapText( ofstream &mapFile, const OUT_Map &map )
+{
+	mapFile << "Bingo layout map" << endl
+			<< "Image size: 0x" << hex << setfill('0') << setw(8) << map.imageSize << dec << " (" << map.imageSize << ")" << endl
+			<< "Image SHA-256: " << OUT_DigestString(map.imageDigest) << endl << endl;
+	mapFile << left << setfill(' ') << setw(12) << "Offset" << setw(12) << "End" << setw(12) << "Size" << setw(12) << "ECC size"
+			<< setw(18) << "ECC" << setw(66) << "SHA-256" << "Name" << endl;
+
+	for (vector<OUT_MapEntry>::const_iterator it = map.entries.begin(); it != map.entries.end(); ++it)
+	{
+		mapFile << right << hex << setfill('0')
+				<< "0x" << setw(8) << it->offset << "  "
+				<< "0x" << setw(8) << it->offset + it->eccSize << "  "
+				<< "0x" << setw(8) << it->size << "  "
+				<< "0x" << setw(8) << it->eccSize << "  "
+				<< left << setfill(' ') << setw(18) << (it->isGap ? "-" : it->ecc)
+				<< OUT_DigestString(it->digest) << "  " << (it->isGap ? "(gap)" : it->name);
+		if (!it->sourceFile.empty())
+		{
+			mapFile << "  [" << it->sourceFile << " @ 0x" << it->sourceOffset << "]";
+		}
+		mapFile << dec << endl;
+	}
+}
+
+static void OUT_WriteMapJson( ofstream &mapFile, const OUT_Map &map )
+{
+	mapFile << "{" << endl
+			<< "\t\"image\": {\"size\": " << map.imageSize << ", \"sha256\": \"" << OUT_DigestString(map.imageDigest) << "\"}," << endl;
+
+	// fields first, then gaps
+	for (int gaps = 0; gaps <= 1; ++gaps)
+	{
+		bool first = true;
+		mapFile << "\t\"" << (gaps ? "gaps" : "fields") << "\": [";
+		for (vector<OUT_MapEntry>::const_iterator it = map.entries.begin(); it != map.entries.end(); ++it)
+		{
+			if (it->isGap != (gaps == 1))
+			{
+				continue;
+			}
+			mapFile << (first ? "" : ",") << endl << "\t\t{";
+			if (!it->isGap)
+			{
+				mapFile << "\"name\": " << OUT_JsonString(it->name) << ", ";
+			}
+			mapFile << "\"offset\": " << it->offset << ", \"end\": " << it->offset + it->eccSize;
+			if (!it->isGap)
+			{
+				mapFile << ", \"size\": " << it->size << ", \"ecc_size\": " << it->eccSize << ", \"ecc\": " << OUT_JsonString(it->ecc);
+				if (!it->sourceFile.empty())
+				{
+					mapFile << ", \"source\": {\"file\": " << OUT_JsonString(it->sourceFile) << ", \"offset\": " << it->sourceOffset << "}";
+				}
+			}
+			else
+			{
+				mapFile << ", \"size\": " << it->eccSize;
+			}
+			mapFile << ", \"sha256\": \"" << OUT_DigestString(it->digest) << "\"}";
+			first = false;
+		}
+		mapFile << endl << "\t]" << (gaps ? "" : ",") << endl;
+	}
+	mapFile << "}" << endl;
+}
+
+UINT32 OUT_WriteMap( const OUT_Map &map, const std::string &fileName )
+{
+	UINT32 err = STS_OK;
+
+	ofstream mapFile(fileName.c_str());
+	if (!mapFile.is_open())
+	{
+		err = ERR_FILE_ERROR;
+		string errStr = "Error creating or opening file " + fileName;
+		ERR_PrintError(err, errStr);
+		return err;
+	}
+
+	string extension = fileName.substr(MIN(fileName.size(), fileName.find_last_of('.')));
+	if (extension == ".json" || extension == ".JSON")
+	{
+		OUT_WriteMapJson(mapFile, map);
+	}
+	else
+	{
+		OUT_WriteMapText(mapFile, map);
+	}
+
+	if (!mapFile.good())
+	{
+		err = ERR_FILE_ERROR;
+		ERR_PrintError(err, "Error writing to file " + fileName);
+	}
+	mapFile.close();
+	return err;
+}
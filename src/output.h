@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include "bingo_types.h"
+#include "sha2.h"
+
+
+// OUT=Output file writers
+
+typedef enum OUT_Format
+{
+	OUT_bin,		// raw binary image
+	OUT_ihex,		// Intel HEX
+	OUT_srec,		// Motorola S-record
+	OUT_carray,		// C header holding the image as an array
+	OUT_NUM_OF_FORMATS
+}OUT_Format;
+
+extern const std::string OUT_FormatNames[OUT_NUM_OF_FORMATS];
+
+/*
+	A range of the image which holds field data, the rest of the image is padding
+*/
+typedef struct OUT_Extent
+{
+	UINT64	offset;
+	UINT64	size;
+}OUT_Extent;
+
+/*
+	A field, or a gap between fields, as listed in the layout map
+*/
+typedef struct OUT_MapEntry
+{
+	bool		isGap;
+	std::string	name;
+	UINT64		offset;
+	UINT64		size;			// before ECC
+	UINT64		eccSize;		// taken in the image
+	std::string	ecc;
+	std::string	sourceFile;		// FileContent/Layout source, empty for other contents
+	UINT64		sourceOffset;	// offset the content was taken from in sourceFile
+	UINT8		digest[SHA256_DIGEST_SIZE];	// of the eccSize bytes in the image
+}OUT_MapEntry;
+
+/*
+	The layout map. The entries are sorted by offset and cover the whole image,
+	the digests are set while the image is written (or by OUT_DigestImage)
+*/
+typedef struct OUT_Map
+{
+	std::vector<OUT_MapEntry>	entries;
+	UINT64						imageSize;
+	UINT8						imageDigest[SHA256_DIGEST_SIZE];
+}OUT_Map;
+
+/*
+	Map digests, computed while the image is written: the writers report how far they got,
+	and the bytes up to there are hashed while they are still in the cache
+*/
+typedef struct OUT_Digester
+{
+	OUT_Map			*map;		// NULL - no digests are needed
+	SHA256_Context	imageCtx;
+	SHA256_Context	entryCtx;
+	UINT64			position;	// the image is digested up to here
+	size_t			entry;		// the map entry which holds position
+}OUT_Digester;
+
+/*
+	A bin image written from start to end, part by part, so it is never held in memory as a whole
+*/
+typedef struct OUT_Stream
+{
+	std::string		fileName;	// empty - nothing is written, only the map digests are computed
+	std::ofstream	file;
+	OUT_Digester	digester;
+	UINT64			size;		// written so far
+#ifdef __LINUX_APP__
+	int				fd;			// the file, for ranges the kernel copies into it (copy_file_range)
+#endif
+}OUT_Stream;
+
+/*
+	Gets the format by its command line name
+*/
+UINT32 OUT_GetFormat(const std::string &name, OUT_Format &format);
+
+/*
+	Writes the image in the given format. ihex and srec write the extents only,
+	bin and carray write the whole image.
+	The extents are sorted by offset and do not overlap.
+	If a map is given, its digests are computed over the image as it is written.
+*/
+UINT32 OUT_WriteImage(OUT_Format format, const std::vector<UINT8> &image, const std::vector<OUT_Extent> &extents,
+					  const std::string &fileName, OUT_Map *map);
+
+/*
+	Streamed bin image: opened, written by parts (data, or a run of one value) and closed.
+	If a map is given, its digests are computed over the parts as they are written.
+	A part may repeat: the same data (or range of a file) written count times in a row, e.g. the three
+	copies of a majority rule field, without being copied for each of them.
+	An aborted stream removes the partial file.
+*/
+UINT32 OUT_StreamOpen(OUT_Stream &stream, const std::string &fileName, OUT_Map *map);
+UINT32 OUT_StreamWrite(OUT_Stream &stream, const UINT8 *data, UINT64 size);
+UINT32 OUT_StreamRepeat(OUT_Stream &stream, const UINT8 *data, UINT64 size, UINT32 count);
+UINT32 OUT_StreamCopy(OUT_Stream &stream, const std::string &sourceFile, UINT64 sourceOffset, UINT64 size, UINT32 count);
+UINT32 OUT_StreamFill(OUT_Stream &stream, UINT8 value, UINT64 size);
+UINT32 OUT_StreamClose(OUT_Stream &stream);
+void OUT_StreamAbort(OUT_Stream &stream);
+
+/*
+	Computes the map digests, for an image which is not written
+*/
+void OUT_DigestImage(const std::vector<UINT8> &image, OUT_Map &map);
+
+/*
+	Writes the layout map, as JSON if the file name ends with .json, otherwise as text
+*/
+UINT32 OUT_WriteMap(const OUT_Map &map, const std::string &fileName);
+
+#endif // OUTPUT_H
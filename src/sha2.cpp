@@ -0,0 +1,362 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#include <cstring>
+#include "sha2.h"
+
+// the SHA extensions path is built with GCC/clang on x86, and selected at runtime
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA_X86_EXTENSIONS
+#include <immintrin.h>
+#include <cpuid.h>
+#endif
+
+
+#define ROTR32(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+#define ROTR64(x, n)	(((x) >> (n)) | ((x) << (64 - (n))))
+
+static const UINT32 SHA256_K[64] =
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const UINT64 SHA512_K[80] =
+{
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+	0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+	0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+	0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+	0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+	0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+
+/*
+	SHA-256 block processing
+*/
+
+static void SHA256_ProcessBlocksPortable(UINT32 state[8], const UINT8 *data, UINT32 numBlocks)
+{
+	UINT32 w[64];
+
+	while (numBlocks--)
+	{
+		for (int i = 0; i < 16; ++i)
+		{
+			w[i] = ((UINT32)data[4 * i] << 24) | ((UINT32)data[4 * i + 1] << 16) | ((UINT32)data[4 * i + 2] << 8) | data[4 * i + 3];
+		}
+		for (int i = 16; i < 64; ++i)
+		{
+			UINT32 s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+			UINT32 s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+
+		UINT32 a = state[0], b = state[1], c = state[2], d = state[3];
+		UINT32 e = state[4], f = state[5], g = state[6], h = state[7];
+		for (int i = 0; i < 64; ++i)
+		{
+			UINT32 t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+			UINT32 t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+			h = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+
+		data += 64;
+	}
+}
+
+#ifdef SHA_X86_EXTENSIONS
+__attribute__((target("sha,sse4.1,ssse3")))
+static void SHA256_ProcessBlocksShaNi(UINT32 state[8], const UINT8 *data, UINT32 numBlocks)
+{
+	const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i msg[16];
+	__m128i tmp, state0, state1, abefSave, cdghSave;
+
+	// state words are kept as ABEF/CDGH, as required by the sha256rnds2 instruction
+	tmp = _mm_loadu_si128((const __m128i *)&state[0]);
+	state1 = _mm_loadu_si128((const __m128i *)&state[4]);
+	tmp = _mm_shuffle_epi32(tmp, 0xB1);				// CDAB
+	state1 = _mm_shuffle_epi32(state1, 0x1B);		// EFGH
+	state0 = _mm_alignr_epi8(tmp, state1, 8);		// ABEF
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);	// CDGH
+
+	while (numBlocks--)
+	{
+		abefSave = state0;
+		cdghSave = state1;
+
+		for (int i = 0; i < 16; ++i)
+		{
+			if (i < 4)
+			{
+				msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * i)), byteSwap);
+			}
+			else
+			{
+				tmp = _mm_add_epi32(_mm_sha256msg1_epu32(msg[i - 4], msg[i - 3]), _mm_alignr_epi8(msg[i - 1], msg[i - 2], 4));
+				msg[i] = _mm_sha256msg2_epu32(tmp, msg[i - 1]);
+			}
+
+			tmp = _mm_add_epi32(msg[i], _mm_loadu_si128((const __m128i *)&SHA256_K[4 * i]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, tmp);
+			tmp = _mm_shuffle_epi32(tmp, 0x0E);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, tmp);
+		}
+
+		state0 = _mm_add_epi32(state0, abefSave);
+		state1 = _mm_add_epi32(state1, cdghSave);
+		data += 64;
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B);			// FEBA
+	state1 = _mm_shuffle_epi32(state1, 0xB1);		// DCHG
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);	// DCBA
+	state1 = _mm_alignr_epi8(state1, tmp, 8);		// HGFE
+	_mm_storeu_si128((__m128i *)&state[0], state0);
+	_mm_storeu_si128((__m128i *)&state[4], state1);
+}
+
+static bool SHA_CpuHasShaNi(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	// SSSE3 and SSE4.1
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & (1 << 9)) || !(ecx & (1 << 19)))
+	{
+		return false;
+	}
+	// SHA
+	if (__get_cpuid_max(0, NULL) < 7)
+	{
+		return false;
+	}
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return (ebx & (1 << 29)) != 0;
+}
+#endif
+
+typedef void (*SHA256_BlockFunction)(UINT32 state[8], const UINT8 *data, UINT32 numBlocks);
+
+static SHA256_BlockFunction SHA256_SelectBlockFunction(void)
+{
+#ifdef SHA_X86_EXTENSIONS
+	if (SHA_CpuHasShaNi())
+	{
+		return SHA256_ProcessBlocksShaNi;
+	}
+#endif
+	return SHA256_ProcessBlocksPortable;
+}
+
+static const SHA256_BlockFunction SHA256_ProcessBlocks = SHA256_SelectBlockFunction();
+
+
+void SHA256_Init(SHA256_Context &ctx)
+{
+	static const UINT32 initialState[8] =
+	{
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+	memcpy(ctx.state, initialState, sizeof(ctx.state));
+	ctx.length = 0;
+}
+
+void SHA256_Update(SHA256_Context &ctx, const UINT8 *data, UINT32 size)
+{
+	UINT32 used = (UINT32)(ctx.length % 64);
+	ctx.length += size;
+
+	// complete a partial block first
+	if (used)
+	{
+		UINT32 fill = 64 - used;
+		if (size < fill)
+		{
+			memcpy(ctx.buffer + used, data, size);
+			return;
+		}
+		memcpy(ctx.buffer + used, data, fill);
+		SHA256_ProcessBlocks(ctx.state, ctx.buffer, 1);
+		data += fill;
+		size -= fill;
+	}
+
+	// whole blocks are hashed directly from the input
+	if (size >= 64)
+	{
+		SHA256_ProcessBlocks(ctx.state, data, size / 64);
+		data += size & ~63;
+		size &= 63;
+	}
+
+	memcpy(ctx.buffer, data, size);
+}
+
+void SHA256_Final(SHA256_Context &ctx, UINT8 digest[SHA256_DIGEST_SIZE])
+{
+	UINT64 bitLength = ctx.length * 8;
+	UINT8 padding[64 + 8];
+	UINT32 used = (UINT32)(ctx.length % 64);
+	UINT32 padSize = (used < 56) ? (56 - used) : (120 - used);
+
+	memset(padding, 0, sizeof(padding));
+	padding[0] = 0x80;
+	for (int i = 0; i < 8; ++i)
+	{
+		padding[padSize + i] = (UINT8)(bitLength >> (56 - 8 * i));
+	}
+	SHA256_Update(ctx, padding, padSize + 8);
+
+	for (int i = 0; i < 8; ++i)
+	{
+		digest[4 * i]     = (UINT8)(ctx.state[i] >> 24);
+		digest[4 * i + 1] = (UINT8)(ctx.state[i] >> 16);
+		digest[4 * i + 2] = (UINT8)(ctx.state[i] >> 8);
+		digest[4 * i + 3] = (UINT8)(ctx.state[i]);
+	}
+}
+
+
+/*
+	SHA-512 block processing
+*/
+
+static void SHA512_ProcessBlocks(UINT64 state[8], const UINT8 *data, UINT32 numBlocks)
+{
+	UINT64 w[80];
+
+	while (numBlocks--)
+	{
+		for (int i = 0; i < 16; ++i)
+		{
+			w[i] = 0;
+			for (int j = 0; j < 8; ++j)
+			{
+				w[i] = (w[i] << 8) | data[8 * i + j];
+			}
+		}
+		for (int i = 16; i < 80; ++i)
+		{
+			UINT64 s0 = ROTR64(w[i - 15], 1) ^ ROTR64(w[i - 15], 8) ^ (w[i - 15] >> 7);
+			UINT64 s1 = ROTR64(w[i - 2], 19) ^ ROTR64(w[i - 2], 61) ^ (w[i - 2] >> 6);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+
+		UINT64 a = state[0], b = state[1], c = state[2], d = state[3];
+		UINT64 e = state[4], f = state[5], g = state[6], h = state[7];
+		for (int i = 0; i < 80; ++i)
+		{
+			UINT64 t1 = h + (ROTR64(e, 14) ^ ROTR64(e, 18) ^ ROTR64(e, 41)) + ((e & f) ^ (~e & g)) + SHA512_K[i] + w[i];
+			UINT64 t2 = (ROTR64(a, 28) ^ ROTR64(a, 34) ^ ROTR64(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+			h = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+		state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+		state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+
+		data += 128;
+	}
+}
+
+void SHA512_Init(SHA512_Context &ctx)
+{
+	static const UINT64 initialState[8] =
+	{
+		0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+		0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+	};
+	memcpy(ctx.state, initialState, sizeof(ctx.state));
+	ctx.length = 0;
+}
+
+void SHA512_Update(SHA512_Context &ctx, const UINT8 *data, UINT32 size)
+{
+	UINT32 used = (UINT32)(ctx.length % 128);
+	ctx.length += size;
+
+	// complete a partial block first
+	if (used)
+	{
+		UINT32 fill = 128 - used;
+		if (size < fill)
+		{
+			memcpy(ctx.buffer + used, data, size);
+			return;
+		}
+		memcpy(ctx.buffer + used, data, fill);
+		SHA512_ProcessBlocks(ctx.state, ctx.buffer, 1);
+		data += fill;
+		size -= fill;
+	}
+
+	// whole blocks are hashed directly from the input
+	if (size >= 128)
+	{
+		SHA512_ProcessBlocks(ctx.state, data, size / 128);
+		data += size & ~127;
+		size &= 127;
+	}
+
+	memcpy(ctx.buffer, data, size);
+}
+
+void SHA512_Final(SHA512_Context &ctx, UINT8 digest[SHA512_DIGEST_SIZE])
+{
+	UINT64 bitLength = ctx.length * 8;
+	UINT8 padding[128 + 16];
+	UINT32 used = (UINT32)(ctx.length % 128);
+	UINT32 padSize = (used < 112) ? (112 - used) : (240 - used);
+
+	// the length is a 128 bit value, images are far below 2^64 bits
+	memset(padding, 0, sizeof(padding));
+	padding[0] = 0x80;
+	for (int i = 0; i < 8; ++i)
+	{
+		padding[padSize + 8 + i] = (UINT8)(bitLength >> (56 - 8 * i));
+	}
+	SHA512_Update(ctx, padding, padSize + 16);
+
+	for (int i = 0; i < 8; ++i)
+	{
+		for (int j = 0; j < 8; ++j)
+		{
+			digest[8 * i + j] = (UINT8)(ctx.state[i] >> (56 - 8 * j));
+		}
+	}
+}
@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#ifndef SHA2_H
+#define SHA2_H
+
+#include "bingo_types.h"
+
+
+// SHA=Secure Hash Algorithm 2 (FIPS 180-4)
+const UINT32 SHA256_DIGEST_SIZE = 32;
+const UINT32 SHA512_DIGEST_SIZE = 64;
+
+typedef struct SHA256_Context
+{
+	UINT32	state[8];
+	UINT64	length;			// total bytes hashed
+	UINT8	buffer[64];		// partial block
+}SHA256_Context;
+
+typedef struct SHA512_Context
+{
+	UINT64	state[8];
+	UINT64	length;			// total bytes hashed
+	UINT8	buffer[128];	// partial block
+}SHA512_Context;
+
+/*
+	SHA-256, uses the x86 SHA extensions when the CPU supports them
+*/
+void SHA256_Init(SHA256_Context &ctx);
+void SHA256_Update(SHA256_Context &ctx, const UINT8 *data, UINT32 size);
+void SHA256_Final(SHA256_Context &ctx, UINT8 digest[SHA256_DIGEST_SIZE]);
+
+/*
+	SHA-512
+*/
+void SHA512_Init(SHA512_Context &ctx);
+void SHA512_Update(SHA512_Context &ctx, const UINT8 *data, UINT32 size);
+void SHA512_Final(SHA512_Context &ctx, UINT8 digest[SHA512_DIGEST_SIZE]);
+
+#endif // SHA2_H
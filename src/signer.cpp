@@ -0,0 +1,312 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include "signer.h"
+#include "errors.h"
+
+#ifdef __LINUX_APP__
+#include <dlfcn.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#else
+#include <windows.h>
+#endif
+
+using namespace std;
+
+
+typedef int (*SIGN_LibraryFunction)(const char *hash, const unsigned char *digest, unsigned int digestSize,
+									unsigned char *signature, unsigned int *signatureSize);
+
+/*
+	An open signer, shared by all the requests of the run
+*/
+typedef struct SIGN_Session
+{
+	void					*library;		// library handle
+	SIGN_LibraryFunction	sign;
+	FILE					*toHelper;		// helper stdin
+	FILE					*fromHelper;	// helper stdout
+	int						helperPid;
+}SIGN_Session;
+
+static map<string, SIGN_Session> SIGN_Sessions;
+
+
+static UINT32 SIGN_OpenLibrary( const string &path, SIGN_Session &session )
+{
+	UINT32 err = ERR_FILE_ERROR;
+
+#ifdef __LINUX_APP__
+	session.library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if (session.library)
+	{
+		session.sign = (SIGN_LibraryFunction) dlsym(session.library, SIGN_LIBRARY_FUNCTION.c_str());
+	}
+#else
+	session.library = LoadLibraryA(path.c_str());
+	if (session.library)
+	{
+		session.sign = (SIGN_LibraryFunction) GetProcAddress((HMODULE) session.library, SIGN_LIBRARY_FUNCTION.c_str());
+	}
+#endif
+
+	if (!session.library)
+	{
+		err = ERR_FILE_NOT_FOUND;
+		ERR_PrintError(err, "Signer library: " + path);
+		return err;
+	}
+	if (!session.sign)
+	{
+		ERR_PrintError(err, path + " does not export " + SIGN_LIBRARY_FUNCTION);
+		return err;
+	}
+	return STS_OK;
+}
+
+static UINT32 SIGN_StartHelper( const string &command, SIGN_Session &session )
+{
+	UINT32 err = ERR_FILE_ERROR;
+
+#ifdef __LINUX_APP__
+	int toChild[2];
+	int fromChild[2];
+
+	if (pipe(toChild) != 0)
+	{
+		ERR_PrintError(err, "could not create a pipe to " + command);
+		return err;
+	}
+	if (pipe(fromChild) != 0)
+	{
+		close(toChild[0]);
+		close(toChild[1]);
+		ERR_PrintError(err, "could not create a pipe from " + command);
+		return err;
+	}
+
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		close(toChild[0]);
+		close(toChild[1]);
+		close(fromChild[0]);
+		close(fromChild[1]);
+		ERR_PrintError(err, "could not start " + command);
+		return err;
+	}
+	if (pid == 0)
+	{
+		dup2(toChild[0], STDIN_FILENO);
+		dup2(fromChild[1], STDOUT_FILENO);
+		close(toChild[0]);
+		close(toChild[1]);
+		close(fromChild[0]);
+		close(fromChild[1]);
+		execl("/bin/sh", "sh", "-c", command.c_str(), (char *) NULL);
+		_exit(127);
+	}
+
+	close(toChild[0]);
+	close(fromChild[1]);
+	// a helper which exits early is reported as a failed request, not by a signal
+	signal(SIGPIPE, SIG_IGN);
+	session.toHelper = fdopen(toChild[1], "w");
+	session.fromHelper = fdopen(fromChild[0], "r");
+	session.helperPid = pid;
+	return STS_OK;
+#else
+	err = ERR_NOT_IMPLEMENTED;
+	ERR_PrintError(err, "signer helper processes are supported on linux only, use a signer library: " + command);
+	return err;
+#endif
+}
+
+static UINT32 SIGN_GetSession( const SIGN_Request &request, SIGN_Session *&session )
+{
+	UINT32 err;
+	string key = (request.isLibrary ? "lib:" : "cmd:") + request.signer;
+	map<string, SIGN_Session>::iterator found = SIGN_Sessions.find(key);
+
+	if (found != SIGN_Sessions.end())
+	{
+		session = &found->second;
+		return STS_OK;
+	}
+
+	SIGN_Session newSession;
+	memset(&newSession, 0, sizeof(newSession));
+	err = request.isLibrary ? SIGN_OpenLibrary(request.signer, newSession) : SIGN_StartHelper(request.signer, newSession);
+	if (err)
+	{
+		return err;
+	}
+	session = &(SIGN_Sessions[key] = newSession);
+	return STS_OK;
+}
+
+static UINT32 SIGN_LibrarySign( SIGN_Session &session, SIGN_Request &request )
+{
+	unsigned int signatureSize = request.maxSize;
+
+	request.signature.resize(request.maxSize ? request.maxSize : 1);
+	if (session.sign(request.hash.c_str(), &request.digest[0], (unsigned int) request.digest.size(),
+					 &request.signature[0], &signatureSize) != 0 || signatureSize > request.maxSize)
+	{
+		ERR_PrintError(ERR_ILLEGAL_VAL, "signer library failed: " + request.signer);
+		return ERR_ILLEGAL_VAL;
+	}
+	request.signature.resize(signatureSize);
+	return STS_OK;
+}
+
+// requests sent to a helper before reading its replies, kept small enough so the replies fit the pipe
+const UINT32 SIGN_HELPER_WINDOW = 32;
+
+//************************************
+// Function:  SIGN_HelperSign - sends the requests of a helper a window at a time, and then reads
+//								 the replies, so the helper is not waited for on each request
+// Returns:   UINT32
+// Parameter: SIGN_Session & session
+// Parameter: std::vector<SIGN_Request * > & requests
+//************************************
+static UINT32 SIGN_HelperSign( SIGN_Session &session, vector<SIGN_Request *> &requests )
+{
+	UINT32 err = ERR_ILLEGAL_VAL;
+	const string signer = requests[0]->signer;
+
+	for (UINT32 windowStart = 0; windowStart < requests.size(); windowStart += SIGN_HELPER_WINDOW)
+	{
+		UINT32 windowEnd = windowStart + SIGN_HELPER_WINDOW < requests.size() ? windowStart + SIGN_HELPER_WINDOW : (UINT32) requests.size();
+
+		for (UINT32 i = windowStart; i < windowEnd; ++i)
+		{
+			fprintf(session.toHelper, "%s ", requests[i]->hash.c_str());
+			for (vector<UINT8>::iterator byte = requests[i]->digest.begin(); byte != requests[i]->digest.end(); ++byte)
+			{
+				fprintf(session.toHelper, "%02x", *byte);
+			}
+			fprintf(session.toHelper, "\n");
+		}
+		if (fflush(session.toHelper) != 0)
+		{
+			ERR_PrintError(err, "could not send the digests to the signer: " + signer);
+			return err;
+		}
+
+		for (UINT32 i = windowStart; i < windowEnd; ++i)
+		{
+			string line;
+			int c;
+			while ((c = fgetc(session.fromHelper)) != EOF && c != '\n')
+			{
+				if (c != '\r')
+				{
+					line += (char) c;
+				}
+			}
+			if (c == EOF && line.empty())
+			{
+				ERR_PrintError(err, "the signer ended before replying: " + signer);
+				return err;
+			}
+
+			if (line.empty() || line.size() % 2 != 0 || line.size() / 2 > requests[i]->maxSize ||
+				line.find_first_not_of("0123456789abcdefABCDEF") != string::npos)
+			{
+				ERR_PrintError(err, "bad signature from " + signer + ": " + line);
+				return err;
+			}
+			requests[i]->signature.clear();
+			for (UINT32 j = 0; j < line.size(); j += 2)
+			{
+				requests[i]->signature.push_back((UINT8) stoul(line.substr(j, 2), 0, 16));
+			}
+		}
+	}
+	return STS_OK;
+}
+
+UINT32 SIGN_SignBatch( std::vector<SIGN_Request> &requests )
+{
+	UINT32 err;
+	map<SIGN_Session *, vector<SIGN_Request *> > helperRequests;
+
+	for (vector<SIGN_Request>::iterator it = requests.begin(); it != requests.end(); ++it)
+	{
+		SIGN_Session *session;
+		err = SIGN_GetSession(*it, session);
+		if (err)
+		{
+			return err;
+		}
+
+		if (it->isLibrary)
+		{
+			err = SIGN_LibrarySign(*session, *it);
+			if (err)
+			{
+				return err;
+			}
+		}
+		else
+		{
+			helperRequests[session].push_back(&(*it));
+		}
+	}
+
+	for (map<SIGN_Session *, vector<SIGN_Request *> >::iterator it = helperRequests.begin(); it != helperRequests.end(); ++it)
+	{
+		err = SIGN_HelperSign(*it->first, it->second);
+		if (err)
+		{
+			return err;
+		}
+	}
+
+	return STS_OK;
+}
+
+void SIGN_CloseSessions( void )
+{
+	for (map<string, SIGN_Session>::iterator it = SIGN_Sessions.begin(); it != SIGN_Sessions.end(); ++it)
+	{
+		SIGN_Session &session = it->second;
+#ifdef __LINUX_APP__
+		if (session.library)
+		{
+			dlclose(session.library);
+		}
+		if (session.toHelper)
+		{
+			// end of input tells the helper to exit
+			fclose(session.toHelper);
+			fclose(session.fromHelper);
+			waitpid(session.helperPid, NULL, 0);
+		}
+#else
+		if (session.library)
+		{
+			FreeLibrary((HMODULE) session.library);
+		}
+#endif
+	}
+	SIGN_Sessions.clear();
+}
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton NPCM7xx Binary Image Generator:   Bingo
+ *
+ * This tool is a general purpose header builder
+ * It is used to create a header descibed in an external
+ * xml file. 
+ * To add changes to the header: update the external xml only.
+ * Bingo can also be used to build an binary image from multiple sources
+ * of data: binary files, arrays and const data.
+ * 
+ * Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+ */
+
+#ifndef SIGNER_H
+#define SIGNER_H
+
+#include <string>
+#include <vector>
+#include "bingo_types.h"
+
+
+// SIGN=Signature, the digest of a range is signed by an external signer
+
+/*
+	A signer is either a shared library exporting SIGN_LIBRARY_FUNCTION:
+		int bingo_sign(const char *hash, const unsigned char *digest, unsigned int digestSize,
+					   unsigned char *signature, unsigned int *signatureSize);
+	(signatureSize holds the buffer size, and is set to the signature size; returns 0 on success)
+	or a helper command, started once and kept running. For each request the helper reads a line
+	"<hash> <digest hex>" from its stdin, and writes a line "<signature hex>" to its stdout.
+*/
+const std::string SIGN_LIBRARY_FUNCTION = "bingo_sign";
+
+typedef struct SIGN_Request
+{
+	std::string			signer;			// library path or helper command
+	bool				isLibrary;
+	std::string			hash;			// name of the digest algorithm (Sha256...)
+	std::vector<UINT8>	digest;
+	UINT32				maxSize;		// room for the signature
+	std::vector<UINT8>	signature;		// set by SIGN_SignBatch
+}SIGN_Request;
+
+/*
+	Signs all the requests. The requests of each signer are sent together, and the signer
+	session is kept open for the following batches.
+*/
+UINT32 SIGN_SignBatch(std::vector<SIGN_Request> &requests);
+
+/*
+	Ends the signer sessions (unloads the libraries, waits for the helpers to exit)
+*/
+void SIGN_CloseSessions(void);
+
+#endif // SIGNER_H
@@ -13,11 +13,11 @@
  */
 
 #include <iostream>
+#include <cstdlib>
 #include "utilities.h"
 #include "errors.h"
 
 UINT32 verbosLevel = 0;
-extern int isMaskRequested;
 /*
 	Utilities
 */
@@ -89,7 +89,7 @@ UINT32 GetIntegerFromString(std::string str, UINT8 &val)
 */
 
 
-UINT32 getFileSize(const char* filename, UINT32 &size)
+UINT32 getFileSize(const char* filename, UINT64 &size)
 {
 	UINT32 err = 0;
 	std::ifstream in(filename, std::ifstream::ate | std::ifstream::binary);
@@ -100,7 +100,7 @@ UINT32 getFileSize(const char* filename, UINT32 &size)
 		size = 0;
 		return err;
 	}
-	size = (UINT32) in.tellg(); 
+	size = (UINT64) in.tellg(); 
 	in.close();
 	return STS_OK;
 }
@@ -110,9 +110,66 @@ void CmdLine_printUsage(string programName)
 	cout << "usage: " << endl;
 	cout << "\t" << programName << " <xml_config_file> [-o <binary_output_file>]" << endl;
 	cout << "\t" << programName << " -i <xml_config_file> [-o <binary_output_file>]" << endl;
+	cout << "\t-f <format>: output format, one of:";
+	for (UINT32 i = 0; i < OUT_NUM_OF_FORMATS; ++i)
+	{
+		cout << " " << OUT_FormatNames[i];
+	}
+	cout << " (default - " << OUT_FormatNames[OUT_bin] << ")" << endl;
+	cout << "\t-mask: output the mask image instead of the data image" << endl;
+	cout << "\t--mask-out <file>: output the mask image as well, in the same run" << endl;
+	cout << "\t--map <file>: output a map of the image layout" << endl;
+	cout << "\t--stream-xml: parse the XML one element at a time, less memory for very large layouts (not faster)" << endl;
+	cout << "\t--cache <file>: keep the parsed XML in a cache file, later runs load it instead of parsing the XML" << endl;
+	cout << "\t-D <name>=<value>: a variable of the XML, ${name} is replaced by the value" << endl;
+	cout << "\t--set <field>.<config|content|mask>=<value>: override a value of a field of the XML" << endl;
+	cout << "\t--max-mem <size>: bound the memory used for building the image, e.g. 64M (suffixes: K, M, G)" << endl;
+	cout << "\t" << programName << " --matrix <variants.json> -i <xml_config_file>" << endl;
+	cout << "\t\tbuilds the image variants listed in the JSON file, each of its variables, overrides and output file" << endl;
+	cout << "\t" << programName << " --diff <image_a> <image_b> -i <xml_config_file>" << endl;
+	cout << "\t\tcompares two images built from the XML, and reports the differences by field" << endl;
+	cout << "\t" << programName << " --extract <image> -i <xml_config_file> [-d <directory>]" << endl;
+	cout << "\t\twrites the decoded content of each field of the image to its own file (default directory - .)" << endl;
+	cout << "\t" << programName << " --infer <image> [-o <xml_output_file>]" << endl;
+	cout << "\t\twrites a starting XML describing an image (default output - <image>.xml)" << endl;
+}
+
+//************************************
+// Function:  CmdLine_GetMemorySize - parses a memory size: a number, optionally followed by K, M or G
+// Returns:   UINT32 status according to errors.h
+// Parameter: const string & str
+// Parameter: UINT64 & size
+//************************************
+static UINT32 CmdLine_GetMemorySize(const string &str, UINT64 &size)
+{
+	char *end;
+	size = strtoull(str.c_str(), &end, 0);
+	string suffix = end;
+
+	if (end == str.c_str() || suffix.size() > 1)
+	{
+		return ERR_CMD_LINE_ERR;
+	}
+	if (suffix == "K" || suffix == "k")
+	{
+		size <<= 10;
+	}
+	else if (suffix == "M" || suffix == "m")
+	{
+		size <<= 20;
+	}
+	else if (suffix == "G" || suffix == "g")
+	{
+		size <<= 30;
+	}
+	else if (!suffix.empty())
+	{
+		return ERR_CMD_LINE_ERR;
+	}
+	return STS_OK;
 }
 
-UINT32 CmdLineParser(int argc, char *argv[], string &inputXML, string &outBin)
+UINT32 CmdLineParser(int argc, char *argv[], CmdLine_Options &options)
 {
 	bool foundFile = false;
 	if (argc < 2)
@@ -130,17 +187,113 @@ UINT32 CmdLineParser(int argc, char *argv[], string &inputXML, string &outBin)
 		{
 			if (arg == "-mask")
 			{
-				isMaskRequested = 1;
-
+				options.maskRequested = true;
 			}
 			else if (arg == "-i") // handle input file
 			{
-				inputXML = argv[i+1];
+				options.inputXML = argv[i+1];
 				++i;
 			}
 			else if (arg == "-o") // handle output file
 			{
-				outBin = argv[i+1];
+				options.outBin = argv[i+1];
+				++i;
+			}
+			else if (arg == "--mask-out" || arg == "--map") // handle additional output files
+			{
+				if (i + 1 >= argc)
+				{
+					CmdLine_printUsage(argv[0]);
+					return ERR_CMD_LINE_ERR;
+				}
+				(arg == "--map" ? options.outMap : options.outMask) = argv[i+1];
+				++i;
+			}
+			else if (arg == "--stream-xml") // parse without loading the whole document
+			{
+				options.streamXML = true;
+			}
+			else if (arg == "--cache") // parsed layout cache
+			{
+				if (i + 1 >= argc)
+				{
+					CmdLine_printUsage(argv[0]);
+					return ERR_CMD_LINE_ERR;
+				}
+				options.cacheFile = argv[i+1];
+				++i;
+			}
+			else if (arg == "-D" || arg == "--set") // layout variables and field overrides
+			{
+				if (i + 1 >= argc)
+				{
+					CmdLine_printUsage(argv[0]);
+					return ERR_CMD_LINE_ERR;
+				}
+				(arg == "-D" ? options.variables : options.overrides).push_back(argv[i+1]);
+				++i;
+			}
+			else if (arg == "--matrix") // image variants
+			{
+				if (i + 1 >= argc)
+				{
+					CmdLine_printUsage(argv[0]);
+					return ERR_CMD_LINE_ERR;
+				}
+				options.matrixFile = argv[i+1];
+				++i;
+			}
+			else if (arg.compare(0, 2, "-D") == 0) // -DNAME=value
+			{
+				options.variables.push_back(arg.substr(2));
+			}
+			else if (arg == "--diff") // compare two images
+			{
+				if (i + 2 >= argc)
+				{
+					CmdLine_printUsage(argv[0]);
+					return ERR_CMD_LINE_ERR;
+				}
+				options.diffImages[0] = argv[i+1];
+				options.diffImages[1] = argv[i+2];
+				i += 2;
+			}
+			else if (arg == "--infer") // infer the XML of an image
+			{
+				if (i + 1 >= argc)
+				{
+					CmdLine_printUsage(argv[0]);
+					return ERR_CMD_LINE_ERR;
+				}
+				options.inferImage = argv[i+1];
+				++i;
+			}
+			else if (arg == "--extract" || arg == "-d") // split an image into field files
+			{
+				if (i + 1 >= argc)
+				{
+					CmdLine_printUsage(argv[0]);
+					return ERR_CMD_LINE_ERR;
+				}
+				(arg == "-d" ? options.outDir : options.extractImage) = argv[i+1];
+				++i;
+			}
+			else if (arg == "--max-mem") // bound the memory of the image build
+			{
+				if (i + 1 >= argc || CmdLine_GetMemorySize(argv[i+1], options.maxMemory))
+				{
+					CmdLine_printUsage(argv[0]);
+					return ERR_CMD_LINE_ERR;
+				}
+				++i;
+			}
+			else if (arg == "-f") // handle output format
+			{
+				if (i + 1 >= argc || OUT_GetFormat(argv[i+1], options.outFormat))
+				{
+					CmdLine_printUsage(argv[0]);
+					return ERR_CMD_LINE_ERR;
+				}
 				++i;
 			}
 			else if (arg[1] == 'v') // handle verbosity level
@@ -169,18 +322,18 @@ UINT32 CmdLineParser(int argc, char *argv[], string &inputXML, string &outBin)
 		{
 			if (!foundFile)
 			{
-				inputXML = arg;
+				options.inputXML = arg;
 				foundFile = true;
 			}
 			else
 			{
-				cout << "more than one XML input files: " << inputXML << "," << arg <<endl;
+				cout << "more than one XML input files: " << options.inputXML << "," << arg <<endl;
 				CmdLine_printUsage(argv[0]);
 				return ERR_CMD_LINE_ERR;
 			}
 		}
 
 	}
-	cout << "Input XML path: " << inputXML << "\t Output Bin path: " << outBin << endl;
+	cout << "Input XML path: " << options.inputXML << "\t Output Bin path: " << options.outBin << endl;
 	return STS_OK;
 }
\ No newline at end of file
@@ -20,7 +20,9 @@
 #include <sstream>
 #include <vector>
 #include <fstream>
+#include <thread>
 #include "bingo_types.h"
+#include "output.h"
 
 extern UINT32 verbosLevel;
 
@@ -41,8 +43,68 @@ extern UINT32 verbosLevel;
 /*---------------------------------------------------------------------------------------------------------*/
 #define MIN(a, b)               ((a)<(b) ? (a) : (b))
 
+/*---------------------------------------------------------------------------------------------------------*/
+/* runs work(first unit, number of units) over consecutive ranges of units, split between the CPU threads */
+/* each thread gets at least minUnitsPerThread units, the calling thread takes the last range              */
+/*---------------------------------------------------------------------------------------------------------*/
+template <typename Function>
+void RunParallel(UINT32 numUnits, UINT32 minUnitsPerThread, Function work)
+{
+	UINT32 numThreads = std::thread::hardware_concurrency();
+
+	numThreads = MIN(numThreads, numUnits / MAX(minUnitsPerThread, 1));
+	if (numThreads <= 1)
+	{
+		work(0, numUnits);
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	UINT32 first = 0;
+	for (UINT32 i = 0; i < numThreads; ++i)
+	{
+		UINT32 count = numUnits / numThreads + (i < numUnits % numThreads ? 1 : 0);
+		if (i == numThreads - 1)
+		{
+			work(first, count);
+		}
+		else
+		{
+			threads.push_back(std::thread(work, first, count));
+		}
+		first += count;
+	}
+	for (UINT32 i = 0; i < threads.size(); ++i)
+	{
+		threads[i].join();
+	}
+}
+
+/*
+	Options collected from the command line
+*/
+typedef struct CmdLine_Options
+{
+	std::string	inputXML;
+	std::string	outBin;
+	OUT_Format	outFormat;
+	bool		maskRequested;	// -mask: the output file is the mask image
+	std::string	outMask;		// --mask-out: mask image written along with the data image
+	std::string	outMap;			// --map: layout map
+	std::string	diffImages[2];	// --diff: images compared instead of building one
+	std::string	extractImage;	// --extract: image split into field files instead of building one
+	std::string	outDir;			// -d: directory of the extracted fields
+	std::string	inferImage;		// --infer: image an XML is inferred from, no XML is parsed
+	UINT64		maxMemory;		// --max-mem: memory an image is built in (0 - no limit)
+	std::string	cacheFile;		// --cache: parsed layout, loaded instead of parsing the XML when still valid
+	bool		streamXML;		// --stream-xml: the XML is parsed element by element, not loaded as a document
+	std::vector<std::string>	variables;	// -D: NAME=value, substituted for ${NAME} in the XML
+	std::vector<std::string>	overrides;	// --set: Field.config=value, applied to the parsed fields
+	std::string	matrixFile;		// --matrix: variants built from the XML instead of one image
+}CmdLine_Options;
+
 std::vector<std::string> &split(const std::string &s, char delim, std::vector<std::string> &elems);
 std::vector<std::string> split(const std::string &s, char delim);
-UINT32 getFileSize(const char* filename, UINT32 &size);
-UINT32 CmdLineParser(int argc, char *argv[], std::string &inputXML, std::string &outBin);
+UINT32 getFileSize(const char* filename, UINT64 &size);
+UINT32 CmdLineParser(int argc, char *argv[], CmdLine_Options &options);
 #endif // UTILITIES_H
@@ -0,0 +1,276 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Nuvoton NPCM7xx Binary Image Generator:   Bingo
+#
+# Regression check of bingo (make check):
+# - known-answer vectors of the CRC, SHA, AES (XTS and CTR) and LZ4 code, through computed and encrypted fields
+# - the ihex and srec output
+# - the round trip of a SPI image: extracted and rebuilt, inferred and rebuilt
+# - the run modes which must build the same image: --stream-xml, --cache (cold and warm) and --matrix
+#
+# usage: regress.sh [<bingo>]   (default: deliverables/linux/Release/bingo)
+# The exit code is the number of failed checks.
+#
+# Copyright (C) 2018 Nuvoton Technologies, All Rights Reserved
+
+BINGO=${1:-$(dirname "$0")/../deliverables/linux/Release/bingo}
+if [ ! -x "$BINGO" ]; then
+	echo "bingo not found: $BINGO (build it first)"
+	exit 1
+fi
+BINGO=$(cd "$(dirname "$BINGO")" && pwd)/$(basename "$BINGO")
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+cd "$WORK" || exit 1
+FAILED=0
+
+
+#----------------------------------------------------------------------------
+# Helpers
+#----------------------------------------------------------------------------
+
+# check <name> <expected> <actual>
+check()
+{
+	if [ "$2" == "$3" ]; then
+		echo "PASS  $1"
+	else
+		echo "FAIL  $1"
+		echo "      expected: $2"
+		echo "      actual:   $3"
+		FAILED=$((FAILED + 1))
+	fi
+}
+
+# check_files <name> <expected file> <actual file>
+check_files()
+{
+	if cmp -s "$2" "$3"; then
+		echo "PASS  $1"
+	else
+		echo "FAIL  $1 ($3 differs from $2)"
+		FAILED=$((FAILED + 1))
+	fi
+}
+
+# run <log> <bingo arguments...> - the output is kept in the log, and shown if bingo fails
+run()
+{
+	local log=$1
+	shift
+	if ! "$BINGO" "$@" > "$log" 2>&1; then
+		echo "FAIL  bingo $*"
+		sed 's/^/      /' "$log"
+		FAILED=$((FAILED + 1))
+	fi
+}
+
+# hex_of <file> <offset> <size> - the bytes as contiguous hex digits
+hex_of()
+{
+	od -An -tx1 -v -j "$2" -N "$3" "$1" 2> /dev/null | tr -d ' \n'
+}
+
+# unhex <hex digits> <file>
+unhex()
+{
+	printf "$(echo "$1" | sed 's/../\\x&/g')" > "$2"
+}
+
+# pattern <file> <size> <multiplier> <add> - deterministic, non-padding bytes
+pattern()
+{
+	LC_ALL=C awk -v size="$2" -v mul="$3" -v add="$4" 'BEGIN { for (i = 0; i < size; i++) printf "%c", (i * mul + add) % 251 + 1 }' > "$1"
+}
+
+
+#----------------------------------------------------------------------------
+# CRC and SHA: the check values of "123456789" and the FIPS 180 vectors of "abc"
+#----------------------------------------------------------------------------
+
+cat > digest.xml <<'EOF'
+<Bin_Ecc_Map>
+	<ImageProperties><BinSize>0x100</BinSize><PadValue>0xFF</PadValue></ImageProperties>
+	<BinField><name>Check</name><config><offset>0</offset><size>9</size></config><content format='hex'>313233343536373839</content></BinField>
+	<BinField><name>Abc</name><config><offset>0x10</offset><size>3</size></config><content format='hex'>616263</content></BinField>
+	<BinField><name>Crc32</name><config><offset>0x20</offset><size>4</size></config><content format='Crc32'>Check</content></BinField>
+	<BinField><name>Crc16</name><config><offset>0x24</offset><size>2</size></config><content format='Crc16'>Check</content></BinField>
+	<BinField><name>CrcCcitt</name><config><offset>0x26</offset><size>2</size></config><content format='CrcCcitt'>Check</content></BinField>
+	<BinField><name>CrcDnp</name><config><offset>0x28</offset><size>2</size></config><content format='CrcDnp'>Check</content></BinField>
+	<BinField><name>Crc32Be</name><config><offset>0x2C</offset><size>4</size></config><content format='Crc32' reverse='true'>Check</content></BinField>
+	<BinField><name>Sha256</name><config><offset>0x40</offset><size>32</size></config><content format='Sha256'>Abc</content></BinField>
+	<BinField><name>Sha512</name><config><offset>0x80</offset><size>64</size></config><content format='Sha512'>Abc</content></BinField>
+</Bin_Ecc_Map>
+EOF
+run digest.log digest.xml -o digest.bin
+check "CRC-32"              "2639f4cb" "$(hex_of digest.bin 0x20 4)"
+check "CRC-16/ARC"          "3dbb"     "$(hex_of digest.bin 0x24 2)"
+check "CRC-16/CCITT-FALSE"  "b129"     "$(hex_of digest.bin 0x26 2)"
+check "CRC-16/DNP"          "82ea"     "$(hex_of digest.bin 0x28 2)"
+check "CRC-32 big endian"   "cbf43926" "$(hex_of digest.bin 0x2C 4)"
+check "SHA-256" "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" "$(hex_of digest.bin 0x40 32)"
+check "SHA-512" "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f" \
+	"$(hex_of digest.bin 0x80 64)"
+
+
+#----------------------------------------------------------------------------
+# AES: IEEE 1619 XTS-AES-128 vector 2, NIST SP 800-38A F.5.1 CTR-AES128 (the counter carries into the 14th byte)
+#----------------------------------------------------------------------------
+
+unhex 1111111111111111111111111111111122222222222222222222222222222222 xts.key
+unhex 2b7e151628aed2a6abf7158809cf4f3c ctr.key
+cat > aes.xml <<'EOF'
+<Bin_Ecc_Map>
+	<ImageProperties><BinSize>0x80</BinSize><PadValue>0xFF</PadValue></ImageProperties>
+	<BinField><name>Xts</name><config><offset>0</offset><size>32</size></config>
+		<content format='hex'>4444444444444444444444444444444444444444444444444444444444444444</content>
+		<encrypt alg='aes-xts' key='xts.key' iv='0x33333333330000000000000000000000'/></BinField>
+	<BinField><name>Ctr</name><config><offset>0x40</offset><size>32</size></config>
+		<content format='hex'>6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51</content>
+		<encrypt alg='aes-ctr' key='ctr.key' iv='0xf0f1f2f3f4f5f6f7f8f9fafbfcfdfeff'/></BinField>
+</Bin_Ecc_Map>
+EOF
+run aes.log aes.xml -o aes.bin
+check "AES-XTS" "c454185e6a16936e39334038acef838bfb186fff7480adc4289382ecd6d394f0" "$(hex_of aes.bin 0 32)"
+check "AES-CTR" "874d6191b620e3261bef6864990db6ce9806f66b7970fdff8617187bb9fffdff" "$(hex_of aes.bin 0x40 32)"
+
+
+#----------------------------------------------------------------------------
+# LZ4: the frame of a fixed input (checked once with the reference lz4 decoder, and again when lz4 is installed)
+#----------------------------------------------------------------------------
+
+printf 'bingo lz4 test, bingo lz4 test, bingo lz4 test, bingo lz4 test.\n' > lz4.in
+cat > lz4.xml <<'EOF'
+<Bin_Ecc_Map>
+	<ImageProperties><BinSize>0</BinSize><PadValue>0xFF</PadValue></ImageProperties>
+	<BinField><name>Lz4</name><config><offset>0</offset></config><content format='FileContent' compress='lz4'>lz4.in</content></BinField>
+</Bin_Ecc_Map>
+EOF
+run lz4.log lz4.xml -o lz4.bin
+check "LZ4 frame" "04224d186c404000000000000000da1b000000ff0162696e676f206c7a3420746573742c20100018506573742e0a0000000029334fda" \
+	"$(hex_of lz4.bin 0 64)"
+if command -v lz4 > /dev/null; then
+	lz4 -d -q -c lz4.bin > lz4.out 2> /dev/null
+	check_files "LZ4 frame decoded by lz4" lz4.in lz4.out
+fi
+
+
+#----------------------------------------------------------------------------
+# ihex and srec: records across a 64KB boundary (ihex extended linear address, srec 24 bit addresses)
+#----------------------------------------------------------------------------
+
+cat > records.xml <<'EOF'
+<Bin_Ecc_Map>
+	<ImageProperties><BinSize>0x10010</BinSize><PadValue>0xFF</PadValue></ImageProperties>
+	<BinField><name>A</name><config><offset>0</offset><size>20</size></config><content format='hex'>000102030405060708090A0B0C0D0E0F10111213</content></BinField>
+	<BinField><name>B</name><config><offset>0xFFFC</offset><size>8</size></config><content format='hex'>DEADBEEFCAFEF00D</content></BinField>
+</Bin_Ecc_Map>
+EOF
+cat > expected.hex <<'EOF'
+:10000000000102030405060708090A0B0C0D0E0F78
+:0400100010111213A6
+:04FFFC00DEADBEEFC9
+:020000040001F9
+:04000000CAFEF00D37
+:00000001FF
+EOF
+cat > expected.srec <<'EOF'
+S00B00006865782E73726563D4
+S214000000000102030405060708090A0B0C0D0E0F73
+S20800001010111213A1
+S20C00FFFCDEADBEEFCAFEF00DFB
+S5030003F9
+S804000000FB
+EOF
+run ihex.log records.xml -f ihex -o hex.hex
+run srec.log records.xml -f srec -o hex.srec
+check_files "ihex output" expected.hex <(tr -d '\r' 2> /dev/null < hex.hex)
+check_files "srec output" expected.srec <(tr -d '\r' 2> /dev/null < hex.srec)
+
+
+#----------------------------------------------------------------------------
+# SPI image: a BootBlock header and its code, a sized payload, SECDED and nibble parity fields
+#----------------------------------------------------------------------------
+
+pattern Code.bin 768 7 3
+pattern Blob.bin 256 13 5
+pattern Sec.bin 61 29 11
+pattern Nib.bin 16 31 17
+pattern Nib2.bin 16 37 19
+cat > spi.xml <<'EOF'
+<Bin_Ecc_Map>
+	<ImageProperties><BinSize>0x4000</BinSize><PadValue>0xFF</PadValue></ImageProperties>
+	<BinField><name>Tag</name><config><offset>0</offset><size>8</size></config><content format='FileContent'>Tag.bin</content></BinField>
+	<BinField><name>CodeSize</name><config><offset>0x144</offset><size>4</size></config><content format='FieldSize'>Code</content></BinField>
+	<BinField><name>Code</name><config><offset>0x200</offset><size format='FileSize'>Code.bin</size></config><content format='FileContent'>Code.bin</content></BinField>
+	<BinField><name>BlobSize</name><config><offset>0x1000</offset><size>4</size></config><content format='FieldSize'>Blob</content></BinField>
+	<BinField><name>Blob</name><config><offset>0x1010</offset><size format='FileSize'>Blob.bin</size></config><content format='FileContent'>Blob.bin</content></BinField>
+	<BinField><name>Sec</name><config><offset>0x2000</offset><size>61</size><ecc>secded</ecc></config><content format='FileContent'>Sec.bin</content></BinField>
+	<BinField><name>Nib</name><config><offset>0x2100</offset><size>16</size><ecc>nibble</ecc></config><content format='FileContent'>Nib.bin</content></BinField>
+</Bin_Ecc_Map>
+EOF
+unhex 500755aa544f4f42 Tag.bin
+run spi.log spi.xml -o spi.bin
+
+# the ECC encodings are pinned by the digest of the whole image, as built by bingo 0.0.6
+check "SPI image" "8286564aedfd01c32b9188614f05d77f7207caf17bff88a621fd81201af13a8e" "$(sha256sum spi.bin 2> /dev/null | cut -d' ' -f1)"
+
+# extracted: the decoded contents, which build the same image again
+mkdir extracted
+run extract.log --extract spi.bin -i spi.xml -d extracted
+for name in Tag Code Blob Sec Nib; do
+	check_files "SPI extract $name" $name.bin extracted/$name.bin
+done
+cp spi.xml extracted/
+(cd extracted && "$BINGO" spi.xml -o rebuilt.bin > rebuilt.log 2>&1)
+check_files "SPI extract, rebuilt" spi.bin extracted/rebuilt.bin
+
+# inferred: an XML of the image, which builds it again
+run infer.log --infer spi.bin -o inferred.xml
+run inferred.log inferred.xml -o inferred.bin
+check_files "SPI infer, rebuilt" spi.bin inferred.bin
+check "SPI infer, BootBlock code" "1" "$(grep -c '<name>BootBlock1_Code</name>' inferred.xml 2> /dev/null)"
+
+
+#----------------------------------------------------------------------------
+# Run modes which build the same image
+#----------------------------------------------------------------------------
+
+run stream.log spi.xml --stream-xml -o stream.bin
+check_files "--stream-xml" spi.bin stream.bin
+
+run cold.log spi.xml --cache spi.cache -o cold.bin
+run warm.log spi.xml --cache spi.cache -o warm.bin -v
+check_files "--cache, cold" spi.bin cold.bin
+check_files "--cache, warm" spi.bin warm.bin
+check "--cache, loaded" "1" "$(grep -c 'Layout loaded from cache' warm.log 2> /dev/null)"
+check "--cache, owner only" "600" "$(stat -c %a spi.cache 2> /dev/null)"
+
+# the size word of the payload takes the variable, the variants share the encoded fields
+sed 's|<content format=.FieldSize.>Blob</content>|<content format="32bit">${BLOB_SIZE}</content>|' spi.xml > variant.xml
+cat > matrix.json <<'EOF'
+[
+	{"output": "variant_a.bin", "variables": {"BLOB_SIZE": "0x100"}},
+	{"output": "variant_b.bin", "variables": {"BLOB_SIZE": "0x80"}},
+	{"output": "variant_c.bin", "variables": {"BLOB_SIZE": "0x100"}, "set": {"Nib.content": "Nib2.bin"}}
+]
+EOF
+run matrix.log --matrix matrix.json -i variant.xml
+run single_a.log variant.xml -D BLOB_SIZE=0x100 -o single_a.bin
+run single_b.log variant.xml -D BLOB_SIZE=0x80 -o single_b.bin
+run single_c.log variant.xml -D BLOB_SIZE=0x100 --set Nib.content=Nib2.bin -o single_c.bin
+for variant in a b c; do
+	check_files "--matrix variant $variant" single_$variant.bin variant_$variant.bin
+done
+check_files "--matrix, same image as the layout" spi.bin variant_a.bin
+
+
+echo
+if [ $FAILED -eq 0 ]; then
+	echo "all checks passed"
+else
+	echo "$FAILED check(s) failed"
+fi
+exit $FAILED